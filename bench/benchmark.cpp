@@ -0,0 +1,151 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <stdexcept>
+
+#include "benchmark.h"
+
+namespace bench {
+
+struct Entry {
+	std::string name;
+	Function function;
+};
+
+static std::vector<Entry>& registry() {
+	static std::vector<Entry> entries;
+	return entries;
+}
+
+void add(const std::string& name, Function function) {
+	registry().push_back({name, std::move(function)});
+}
+
+static double time_run(const Function& function, State& state) {
+	auto start = std::chrono::steady_clock::now();
+	function(state);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Result run_one(const Entry& entry, const Options& options) {
+	Result result;
+	result.name = entry.name;
+
+	// warms caches and finds the iteration count that fills min_time
+	State state;
+	double seconds = time_run(entry.function, state);
+	while (state.skip_reason.empty() && seconds < options.min_time && state.iterations < (1ull << 40)) {
+		double scale = seconds > 0.0 ? options.min_time / seconds : 16.0;
+		state.iterations = std::max<uint64_t>(state.iterations * 2, static_cast<uint64_t>(state.iterations * std::min(scale * 1.2, 16.0)));
+		seconds = time_run(entry.function, state);
+	}
+	if (!state.skip_reason.empty()) {
+		result.skip_reason = state.skip_reason;
+		return result;
+	}
+
+	std::vector<double> samples;
+	for (uint32_t i = 0; i < std::max(options.repetitions, 1u); ++i) {
+		samples.push_back(time_run(entry.function, state) * 1e9 / state.iterations);
+	}
+	std::sort(samples.begin(), samples.end());
+
+	result.iterations = state.iterations;
+	result.median_ns = samples[samples.size() / 2];
+	result.min_ns = samples.front();
+	result.max_ns = samples.back();
+	if (state.bytes_per_iteration != 0) {
+		result.bytes_per_second = state.bytes_per_iteration * 1e9 / result.median_ns;
+	}
+	if (state.items_per_iteration != 0) {
+		result.items_per_second = state.items_per_iteration * 1e9 / result.median_ns;
+	}
+	return result;
+}
+
+std::vector<Result> run(const Options& options) {
+	std::vector<Result> results;
+	std::cout << std::left << std::setw(32) << "benchmark" << std::right
+		<< std::setw(14) << "median ns" << std::setw(14) << "min ns" << std::setw(14) << "iterations" << "  throughput" << std::endl;
+
+	for (const auto& entry : registry()) {
+		if (!options.filter.empty() && entry.name.find(options.filter) == std::string::npos) {
+			continue;
+		}
+
+		auto result = run_one(entry, options);
+		std::cout << std::left << std::setw(32) << result.name << std::right;
+		if (!result.skip_reason.empty()) {
+			std::cout << "  skipped: " << result.skip_reason << std::endl;
+		} else {
+			std::cout << std::fixed << std::setprecision(1)
+				<< std::setw(14) << result.median_ns << std::setw(14) << result.min_ns << std::setw(14) << result.iterations;
+			if (result.bytes_per_second != 0.0) {
+				std::cout << "  " << result.bytes_per_second / (1 << 20) << " MiB/s";
+			}
+			if (result.items_per_second != 0.0) {
+				std::cout << "  " << result.items_per_second / 1e6 << " M items/s";
+			}
+			std::cout << std::defaultfloat << std::endl;
+		}
+		results.push_back(result);
+	}
+
+	if (!options.json_path.empty()) {
+		write_json(options.json_path, results);
+	}
+	return results;
+}
+
+static std::string escape(const std::string& text) {
+	std::string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+void write_json(const std::string& path, const std::vector<Result>& results) {
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open " + path + "!");
+	}
+
+	std::time_t now = std::time(nullptr);
+	char date[32];
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+	file << std::setprecision(17);
+	file << "{\n";
+	file << "  \"context\": {\"date\": \"" << date << "\", \"hardware_threads\": " << std::thread::hardware_concurrency() << "},\n";
+	file << "  \"benchmarks\": [";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const auto& result = results[i];
+		file << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << escape(result.name) << "\"";
+		if (!result.skip_reason.empty()) {
+			file << ", \"skipped\": \"" << escape(result.skip_reason) << "\"}";
+			continue;
+		}
+		file << ", \"iterations\": " << result.iterations
+			<< ", \"median_ns\": " << result.median_ns
+			<< ", \"min_ns\": " << result.min_ns
+			<< ", \"max_ns\": " << result.max_ns;
+		if (result.bytes_per_second != 0.0) {
+			file << ", \"bytes_per_second\": " << result.bytes_per_second;
+		}
+		if (result.items_per_second != 0.0) {
+			file << ", \"items_per_second\": " << result.items_per_second;
+		}
+		file << "}";
+	}
+	file << "\n  ]\n}\n";
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+// A small benchmark harness. Every benchmark runs its body state.iterations times;
+// the harness doubles the iterations until one run takes min_time, then repeats
+// that run and reports the median, so a single preempted run does not skew the result.
+namespace bench {
+
+struct State {
+	uint64_t iterations = 1;
+	// per iteration, turned into throughput in the report when set
+	uint64_t bytes_per_iteration = 0;
+	uint64_t items_per_iteration = 0;
+	// set by the body when it can not run, e.g. without its input file
+	std::string skip_reason;
+};
+
+using Function = std::function<void(State&)>;
+
+struct Result {
+	std::string name;
+	uint64_t iterations = 0;
+	double median_ns = 0.0;
+	double min_ns = 0.0;
+	double max_ns = 0.0;
+	double bytes_per_second = 0.0;
+	double items_per_second = 0.0;
+	std::string skip_reason;
+};
+
+struct Options {
+	// substring of the names to run, all when empty
+	std::string filter;
+	double min_time = 0.5;
+	uint32_t repetitions = 5;
+	// machine readable results for tracking across commits, none when empty
+	std::string json_path;
+};
+
+void add(const std::string& name, Function function);
+std::vector<Result> run(const Options& options);
+void write_json(const std::string& path, const std::vector<Result>& results);
+
+// keeps the compiler from removing a computation whose result is unused
+template <class T>
+inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static volatile const void* sink;
+	sink = &value;
+#endif
+}
+
+}
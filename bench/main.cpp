@@ -0,0 +1,461 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <random>
+#include <cstdlib>
+#include <cmath>
+#include <thread>
+#include <deque>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+#include <stb_image.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "benchmark.h"
+#include "application.h"
+#include "model_loader.h"
+#include "blob_cache.h"
+#include "job_system.h"
+#include "scene_graph.h"
+#include "obj_parser.h"
+
+// the assets the application loads, relative to the build directory like there
+static const std::string MODEL_PATH = "assets/models/viking_room.obj";
+static const std::string TEXTURE_PATH = "assets/textures/viking_room.png";
+
+// a model sized vertex stream where most vertices repeat, as in an indexed mesh
+static std::vector<Vertex> make_vertex_stream(size_t count, size_t distinct) {
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<Vertex> pool(distinct);
+	for (auto& vertex : pool) {
+		vertex.pos = {unit(random), unit(random), unit(random)};
+		vertex.color = {1.0f, 1.0f, 1.0f};
+		vertex.texCoord = {unit(random), unit(random)};
+	}
+
+	std::uniform_int_distribution<size_t> pick(0, distinct - 1);
+	std::vector<Vertex> stream(count);
+	for (auto& vertex : stream) {
+		vertex = pool[pick(random)];
+	}
+	return stream;
+}
+
+// 1, 2, 4, ... up to every hardware thread, which is always included
+static std::vector<size_t> scaling_thread_counts() {
+	size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+	std::vector<size_t> counts;
+	for (size_t count = 1; count < hardware; count *= 2) {
+		counts.push_back(count);
+	}
+	counts.push_back(hardware);
+	return counts;
+}
+
+// a compute bound job that touches no shared memory
+static float synthetic_work(size_t seed) {
+	float value = static_cast<float>(seed);
+	for (int i = 0; i < 2000; ++i) {
+		value = std::sin(value) * 0.5f + 1.0f;
+	}
+	return value;
+}
+
+// vertex_dedup split over the workers: vertices are partitioned by hash, so each
+// partition deduplicates on its own, then the partitions' vertices are numbered in turn
+static void parallel_dedup(JobSystem& jobs, const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	const size_t partitions = jobs.thread_count() * 4;
+	std::vector<uint8_t> owner(vertices.size());
+	std::vector<std::unordered_map<Vertex, uint32_t>> maps(partitions);
+	std::vector<uint32_t> local(vertices.size());
+	std::vector<uint32_t> base(partitions + 1, 0);
+
+	std::hash<Vertex> hasher;
+	jobs.parallel_for(vertices.size(), 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			owner[i] = static_cast<uint8_t>(hasher(vertices[i]) % partitions);
+		}
+	});
+	jobs.parallel_for(partitions, 1, [&](size_t begin, size_t end) {
+		for (size_t partition = begin; partition < end; ++partition) {
+			auto& map = maps[partition];
+			for (size_t i = 0; i < vertices.size(); ++i) {
+				if (owner[i] == partition) {
+					local[i] = map.emplace(vertices[i], static_cast<uint32_t>(map.size())).first->second;
+				}
+			}
+		}
+	});
+	for (size_t partition = 0; partition < partitions; ++partition) {
+		base[partition + 1] = base[partition] + static_cast<uint32_t>(maps[partition].size());
+	}
+	jobs.parallel_for(vertices.size(), 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			indices[i] = base[owner[i]] + local[i];
+		}
+	});
+}
+
+// an RGBA8 mip chain by 2x2 box filter; the row jobs of a level wait on the previous level's counter
+static void generate_mips(JobSystem& jobs, std::vector<std::vector<uint8_t>>& levels, uint32_t size) {
+	const uint32_t ROWS_PER_JOB = 16;
+
+	std::deque<JobCounter> counters(levels.size());
+	for (size_t level = 1; level < levels.size(); ++level) {
+		uint32_t width = std::max(1u, size >> level);
+		uint32_t sourceWidth = std::max(1u, size >> (level - 1));
+		const uint8_t* source = levels[level - 1].data();
+		uint8_t* target = levels[level].data();
+		JobCounter* dependency = level > 1 ? &counters[level - 1] : nullptr;
+
+		for (uint32_t row = 0; row < width; row += ROWS_PER_JOB) {
+			jobs.submit([=]() {
+				uint32_t end = std::min(width, row + ROWS_PER_JOB);
+				for (uint32_t y = row; y < end; ++y) {
+					for (uint32_t x = 0; x < width; ++x) {
+						for (uint32_t channel = 0; channel < 4; ++channel) {
+							auto texel = [&](uint32_t sx, uint32_t sy) {
+								return static_cast<uint32_t>(source[(sy * sourceWidth + sx) * 4 + channel]);
+							};
+							uint32_t sum = texel(2 * x, 2 * y) + texel(2 * x + 1, 2 * y)
+								+ texel(2 * x, 2 * y + 1) + texel(2 * x + 1, 2 * y + 1);
+							target[(y * width + x) * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+						}
+					}
+				}
+			}, &counters[level], dependency);
+		}
+	}
+	jobs.wait(counters.back());
+}
+
+static void register_scaling_benchmarks() {
+	// inputs are built once here, each run times only the work
+	auto vertices = std::make_shared<std::vector<Vertex>>(make_vertex_stream(1 << 18, 1 << 16));
+
+	const uint32_t MIP_SIZE = 2048;
+	uint32_t levelCount = static_cast<uint32_t>(std::floor(std::log2(MIP_SIZE))) + 1;
+	auto levels = std::make_shared<std::vector<std::vector<uint8_t>>>(levelCount);
+	for (uint32_t level = 0; level < levelCount; ++level) {
+		uint32_t width = std::max(1u, MIP_SIZE >> level);
+		(*levels)[level].resize(static_cast<size_t>(width) * width * 4);
+	}
+	std::mt19937 random(42);
+	for (auto& texel : (*levels)[0]) {
+		texel = static_cast<uint8_t>(random());
+	}
+
+	for (size_t threads : scaling_thread_counts()) {
+		std::string suffix = "/" + std::to_string(threads);
+
+		bench::add("jobs_synthetic" + suffix, [threads](bench::State& state) {
+			const size_t JOB_COUNT = 1024;
+			JobSystem jobs(threads);
+			std::vector<float> results(JOB_COUNT);
+			state.items_per_iteration = JOB_COUNT;
+			for (uint64_t i = 0; i < state.iterations; ++i) {
+				JobCounter counter;
+				for (size_t job = 0; job < JOB_COUNT; ++job) {
+					jobs.submit([&results, job]() { results[job] = synthetic_work(job); }, &counter);
+				}
+				jobs.wait(counter);
+				bench::do_not_optimize(results.data());
+			}
+		});
+
+		bench::add("jobs_mesh_dedup" + suffix, [threads, vertices](bench::State& state) {
+			JobSystem jobs(threads);
+			std::vector<uint32_t> indices(vertices->size());
+			state.items_per_iteration = vertices->size();
+			for (uint64_t i = 0; i < state.iterations; ++i) {
+				parallel_dedup(jobs, *vertices, indices);
+				bench::do_not_optimize(indices.data());
+			}
+		});
+
+		bench::add("jobs_mip_generation" + suffix, [threads, levels](bench::State& state) {
+			JobSystem jobs(threads);
+			state.bytes_per_iteration = (*levels)[0].size();
+			for (uint64_t i = 0; i < state.iterations; ++i) {
+				generate_mips(jobs, *levels, MIP_SIZE);
+				bench::do_not_optimize(levels->back().data());
+			}
+		});
+	}
+}
+
+// a million nodes, four children each, with a little offset and turn per level
+static std::shared_ptr<SceneGraph> make_scene(size_t node_count) {
+	auto scene = std::make_shared<SceneGraph>();
+	auto local = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.1f, 0.0f, 0.0f)), 0.01f, glm::vec3(0.0f, 0.0f, 1.0f));
+	scene->add_node();
+	for (size_t i = 1; i < node_count; ++i) {
+		scene->add_node(static_cast<SceneNode>((i - 1) / 4), local);
+	}
+	scene->update();
+	return scene;
+}
+
+static void register_scene_benchmarks() {
+	const size_t NODE_COUNT = 1 << 20;
+	// one scene for all of them, built by the first run, which only sizes the iteration count
+	auto shared = std::make_shared<std::shared_ptr<SceneGraph>>();
+	auto get_scene = [shared, NODE_COUNT]() {
+		if (!*shared) {
+			*shared = make_scene(NODE_COUNT);
+		}
+		return *shared;
+	};
+
+	// world matrix updates per second: the root moves, so the whole hierarchy is dirty
+	for (bool parallel : {false, true}) {
+		bench::add(parallel ? "scene_update_all_parallel/1M" : "scene_update_all/1M", [parallel, get_scene](bench::State& state) {
+			auto scene = get_scene();
+			std::unique_ptr<JobSystem> jobs = parallel ? std::make_unique<JobSystem>() : nullptr;
+			state.items_per_iteration = scene->size();
+			for (uint64_t i = 0; i < state.iterations; ++i) {
+				scene->set_local(0, glm::rotate(glm::mat4(1.0f), i * 1e-3f, glm::vec3(0.0f, 0.0f, 1.0f)));
+				scene->update(jobs.get());
+				bench::do_not_optimize(scene->world_matrices().data());
+			}
+		});
+	}
+
+	// a few hundred small subtrees move, the rest of the hierarchy is skipped
+	bench::add("scene_update_subtrees/1M", [get_scene](bench::State& state) {
+		auto scene = get_scene();
+		std::mt19937 random(42);
+		// nodes three levels above the leaves, with subtrees of about a hundred nodes
+		std::uniform_int_distribution<SceneNode> pick(NODE_COUNT / 64, NODE_COUNT / 48);
+		uint64_t updated = 0;
+		for (uint64_t i = 0; i < state.iterations; ++i) {
+			for (int moved = 0; moved < 256; ++moved) {
+				auto node = pick(random);
+				scene->set_local(node, glm::translate(scene->local(node), glm::vec3(1e-3f, 0.0f, 0.0f)));
+			}
+			scene->update();
+			updated += scene->updated_count();
+			bench::do_not_optimize(scene->world_matrices().data());
+		}
+		state.items_per_iteration = state.iterations > 0 ? updated / state.iterations : 0;
+	});
+}
+
+// a textured grid of grid_size squared vertices, two triangles per cell, written like exporters do
+static std::string make_grid_obj(uint32_t grid_size) {
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> height(0.0f, 1.0f);
+	std::ostringstream obj;
+	obj << std::fixed << std::setprecision(6);
+	for (uint32_t y = 0; y < grid_size; ++y) {
+		for (uint32_t x = 0; x < grid_size; ++x) {
+			obj << "v " << x * 0.01f << " " << y * 0.01f << " " << height(random) << "\n";
+			obj << "vt " << x / float(grid_size - 1) << " " << y / float(grid_size - 1) << "\n";
+		}
+	}
+	for (uint32_t y = 0; y + 1 < grid_size; ++y) {
+		for (uint32_t x = 0; x + 1 < grid_size; ++x) {
+			uint32_t a = y * grid_size + x + 1, b = a + 1, c = a + grid_size, d = c + 1;
+			obj << "f " << a << "/" << a << " " << b << "/" << b << " " << d << "/" << d << "\n";
+			obj << "f " << a << "/" << a << " " << d << "/" << d << " " << c << "/" << c << "\n";
+		}
+	}
+	return obj.str();
+}
+
+static void register_obj_benchmarks() {
+	// a large OBJ for all of them, about 35 MB, written by the first run
+	auto shared = std::make_shared<std::shared_ptr<std::string>>();
+	auto get_obj = [shared]() {
+		if (!*shared) {
+			*shared = std::make_shared<std::string>(make_grid_obj(512));
+		}
+		return *shared;
+	};
+
+	// MB/s of a whole load, parsing to the deduplicated model
+	bench::add("load_obj_tinyobj/grid", [get_obj](bench::State& state) {
+		auto obj = get_obj();
+		state.bytes_per_iteration = obj->size();
+		for (uint64_t i = 0; i < state.iterations; ++i) {
+			auto model = load_obj_model(std::span<const char>(obj->data(), obj->size()), "");
+			bench::do_not_optimize(model.indices.data());
+		}
+	});
+
+	for (size_t threads : scaling_thread_counts()) {
+		std::string suffix = "/" + std::to_string(threads);
+
+		bench::add("load_obj_parallel/grid" + suffix, [threads, get_obj](bench::State& state) {
+			auto obj = get_obj();
+			JobSystem jobs(threads);
+			state.bytes_per_iteration = obj->size();
+			for (uint64_t i = 0; i < state.iterations; ++i) {
+				auto model = load_obj_model(std::span<const char>(obj->data(), obj->size()), "", jobs);
+				bench::do_not_optimize(model.indices.data());
+			}
+		});
+
+		// the text alone, without grouping and deduplication
+		bench::add("parse_obj/grid" + suffix, [threads, get_obj](bench::State& state) {
+			auto obj = get_obj();
+			JobSystem jobs(threads);
+			state.bytes_per_iteration = obj->size();
+			for (uint64_t i = 0; i < state.iterations; ++i) {
+				ObjGeometry geometry;
+				parse_obj(std::span<const char>(obj->data(), obj->size()), "", jobs, geometry);
+				bench::do_not_optimize(geometry.position_indices.data());
+			}
+		});
+	}
+}
+
+static void register_benchmarks() {
+	bench::add("load_obj_model", [](bench::State& state) {
+		if (!std::filesystem::exists(MODEL_PATH)) {
+			state.skip_reason = MODEL_PATH + " not found";
+			return;
+		}
+		state.bytes_per_iteration = std::filesystem::file_size(MODEL_PATH);
+		for (uint64_t i = 0; i < state.iterations; ++i) {
+			auto model = load_obj_model(MODEL_PATH);
+			bench::do_not_optimize(model.indices.data());
+		}
+	});
+
+	auto vertices = std::make_shared<std::vector<Vertex>>(make_vertex_stream(1 << 16, 1 << 14));
+
+	bench::add("vertex_hash", [vertices](bench::State& state) {
+		state.items_per_iteration = vertices->size();
+		std::hash<Vertex> hasher;
+		for (uint64_t i = 0; i < state.iterations; ++i) {
+			size_t combined = 0;
+			for (const auto& vertex : *vertices) {
+				combined ^= hasher(vertex);
+			}
+			bench::do_not_optimize(combined);
+		}
+	});
+
+	// the deduplication load_obj_model does, without the parsing
+	bench::add("vertex_dedup", [vertices](bench::State& state) {
+		state.items_per_iteration = vertices->size();
+		for (uint64_t i = 0; i < state.iterations; ++i) {
+			std::unordered_map<Vertex, uint32_t> uniqueVertices;
+			std::vector<uint32_t> indices;
+			indices.reserve(vertices->size());
+			for (const auto& vertex : *vertices) {
+				auto inserted = uniqueVertices.emplace(vertex, static_cast<uint32_t>(uniqueVertices.size()));
+				indices.push_back(inserted.first->second);
+			}
+			bench::do_not_optimize(indices.data());
+		}
+	});
+
+	bench::add("camera_uniforms", [](bench::State& state) {
+		state.items_per_iteration = 1;
+		glm::vec3 eye{2.0f, 2.0f, 2.0f};
+		for (uint64_t i = 0; i < state.iterations; ++i) {
+			// a moving camera, so the matrices are not hoisted out of the loop
+			eye.x += 1e-6f;
+			auto ubo = Application::camera_uniforms(eye, glm::vec3(0.0f), VkExtent2D{800, 600});
+			bench::do_not_optimize(ubo);
+		}
+	});
+
+	bench::add("read_file", [](bench::State& state) {
+		if (!std::filesystem::exists(TEXTURE_PATH)) {
+			state.skip_reason = TEXTURE_PATH + " not found";
+			return;
+		}
+		state.bytes_per_iteration = std::filesystem::file_size(TEXTURE_PATH);
+		for (uint64_t i = 0; i < state.iterations; ++i) {
+			auto buffer = Application::read_file(TEXTURE_PATH);
+			bench::do_not_optimize(buffer.data());
+		}
+	});
+
+	// what the loaders use in place of read_file: map the file and touch every page
+	bench::add("map_file", [](bench::State& state) {
+		if (!std::filesystem::exists(TEXTURE_PATH)) {
+			state.skip_reason = TEXTURE_PATH + " not found";
+			return;
+		}
+		state.bytes_per_iteration = std::filesystem::file_size(TEXTURE_PATH);
+		for (uint64_t i = 0; i < state.iterations; ++i) {
+			FileBlob blob(TEXTURE_PATH);
+			size_t sum = 0;
+			for (size_t offset = 0; offset < blob.size(); offset += 4096) {
+				sum += static_cast<unsigned char>(blob.data()[offset]);
+			}
+			bench::do_not_optimize(sum);
+		}
+	});
+
+	bench::add("blob_cache_hit", [](bench::State& state) {
+		if (!std::filesystem::exists(TEXTURE_PATH)) {
+			state.skip_reason = TEXTURE_PATH + " not found";
+			return;
+		}
+		BlobCache cache;
+		auto held = cache.load(TEXTURE_PATH);
+		for (uint64_t i = 0; i < state.iterations; ++i) {
+			auto blob = cache.load(TEXTURE_PATH);
+			bench::do_not_optimize(blob->data());
+		}
+	});
+
+	bench::add("texture_decode", [](bench::State& state) {
+		if (!std::filesystem::exists(TEXTURE_PATH)) {
+			state.skip_reason = TEXTURE_PATH + " not found";
+			return;
+		}
+		// decoding only, the file is read once
+		auto encoded = Application::read_file(TEXTURE_PATH);
+		state.bytes_per_iteration = encoded.size();
+		for (uint64_t i = 0; i < state.iterations; ++i) {
+			int width, height, channels;
+			stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(encoded.data()), static_cast<int>(encoded.size()),
+				&width, &height, &channels, STBI_rgb_alpha);
+			if (pixels == nullptr) {
+				state.skip_reason = "failed to decode " + TEXTURE_PATH;
+				return;
+			}
+			bench::do_not_optimize(pixels);
+			stbi_image_free(pixels);
+		}
+	});
+}
+
+int main(int argc, char** argv) {
+	bench::Options options;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--filter" && i + 1 < argc) {
+			options.filter = argv[++i];
+		} else if (arg == "--min-time" && i + 1 < argc) {
+			options.min_time = std::stod(argv[++i]);
+		} else if (arg == "--repetitions" && i + 1 < argc) {
+			options.repetitions = static_cast<uint32_t>(std::stoul(argv[++i]));
+		} else if (arg == "--json" && i + 1 < argc) {
+			options.json_path = argv[++i];
+		}
+	}
+
+	try {
+		register_benchmarks();
+		register_scaling_benchmarks();
+		register_scene_benchmarks();
+		register_obj_benchmarks();
+		bench::run(options);
+	} catch (std::exception& e) {
+		std::cout << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -5,6 +5,10 @@
 #include <fstream>
 #include <set>
 #include <unordered_map>
+#include <filesystem>
+#include <thread>
+#include <exception>
+#include <tuple>
 
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_FORCE_RADIANS
@@ -14,9 +18,6 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-
 #include <chrono>
 
 #include "application.h"
@@ -26,6 +27,9 @@ static const uint32_t HEIGHT = 600;
 
 static const std::string MODEL_PATH = "assets/models/viking_room.obj";
 static const std::string TEXTURE_PATH = "assets/textures/viking_room.png";
+static const std::string PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+// mounted when it exists, built next to the binary by the assets_pak target
+static const std::string ASSET_ARCHIVE_PATH = "assets.pak";
 
 static const std::vector<const char*> validation_layers = {
     "VK_LAYER_KHRONOS_validation"
@@ -35,6 +39,42 @@ const std::vector<const char*> used_device_extensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// upper bound of the bindless texture table, clamped to the device limits
+static const uint32_t MAX_BINDLESS_TEXTURES = 16384;
+
+static const size_t MAX_FRAMES_IN_FLIGHT = 2;
+
+// longest the main loop blocks for events when rendering on demand, in seconds
+static const double ON_DEMAND_IDLE_TIMEOUT = 0.5;
+
+// initial capacity of the culling buffers: world matrices of the whole scene graph, and
+// draws; both double when a scene needs more. Powers of two of at least this many matrices
+// keep the draws that follow them at a storage buffer aligned offset.
+static const uint32_t MIN_CULL_NODES = 1024;
+static const uint32_t MIN_CULL_INSTANCES = 4096;
+
+// the frame capture copies into RGBA8 of the same color encoding as the swap chain
+static VkFormat capture_format(VkFormat swap_chain_format) {
+	bool srgb = swap_chain_format == VK_FORMAT_B8G8R8A8_SRGB || swap_chain_format == VK_FORMAT_R8G8B8A8_SRGB;
+	return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+// presets cycled through at runtime, cheapest first
+static const std::vector<std::string> anti_aliasing_presets = {
+	"off", "fxaa", "msaa2", "msaa4", "msaa4+ss", "msaa8+ss"
+};
+
+// shaders the graphics pipeline is built from, rebuilt when any of them is recompiled
+static const std::vector<std::string> pipeline_shaders = {
+	"depth_only.vert",
+	"default.vert",
+	"default.frag"
+};
+
+#ifndef SHADER_SOURCE_DIR
+#define SHADER_SOURCE_DIR "src/shaders"
+#endif
+
 #ifdef NDEBUG
     static const bool enable_validation_layers = false;
 #else
@@ -46,10 +86,26 @@ static void framebufferResizeCallback(GLFWwindow* window, int width, int height)
     app->set_framebuffer_resized();
 }
 
+static void windowRefreshCallback(GLFWwindow* window) {
+	auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+	app->on_window_refresh();
+}
+
+static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+	app->on_key(key, action);
+}
+
 void Application::run() {
-	init_window();
+	if (!headless()) {
+		init_window();
+	}
 	init_vulkan();
-	main_loop();
+	if (headless()) {
+		batch_loop();
+	} else {
+		main_loop();
+	}
 	cleanup();
 }
 
@@ -61,52 +117,473 @@ void Application::init_window() {
     _window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
     glfwSetWindowUserPointer(_window, this);
     glfwSetFramebufferSizeCallback(_window, framebufferResizeCallback);
+    glfwSetKeyCallback(_window, keyCallback);
+    glfwSetWindowRefreshCallback(_window, windowRefreshCallback);
+
+    int width, height;
+    glfwGetFramebufferSize(_window, &width, &height);
+    _framebuffer_extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+}
+
+std::optional<AntiAliasingPolicy> AntiAliasingPolicy::parse(const std::string& name) {
+	AntiAliasingPolicy policy{};
+	std::string base = name;
+
+	auto plus = name.find('+');
+	if (plus != std::string::npos) {
+		if (name.substr(plus) != "+ss") {
+			return std::nullopt;
+		}
+		policy.sample_shading = true;
+		base = name.substr(0, plus);
+	}
+
+	if (base == "off") {
+		policy.samples = VK_SAMPLE_COUNT_1_BIT;
+	} else if (base == "fxaa") {
+		policy.samples = VK_SAMPLE_COUNT_1_BIT;
+		policy.fxaa = true;
+	} else if (base == "msaa2") {
+		policy.samples = VK_SAMPLE_COUNT_2_BIT;
+	} else if (base == "msaa4") {
+		policy.samples = VK_SAMPLE_COUNT_4_BIT;
+	} else if (base == "msaa8") {
+		policy.samples = VK_SAMPLE_COUNT_8_BIT;
+	} else {
+		return std::nullopt;
+	}
+
+	return policy;
+}
+
+std::string AntiAliasingPolicy::name() const {
+	std::string name;
+	if (samples == VK_SAMPLE_COUNT_1_BIT) {
+		name = fxaa ? "fxaa" : "off";
+	} else {
+		name = "msaa" + std::to_string(static_cast<uint32_t>(samples));
+	}
+	if (sample_shading && samples != VK_SAMPLE_COUNT_1_BIT) {
+		name += "+ss";
+	}
+	return name;
+}
+
+void Application::set_anti_aliasing(const AntiAliasingPolicy& policy) {
+	_anti_aliasing = policy;
+	// before init_vulkan the policy is simply picked up by pick_physical_device
+	if (_device != VK_NULL_HANDLE) {
+		_render_graph_dirty = true;
+	}
+}
+
+void Application::on_key(int key, int action) {
+	if (action != GLFW_PRESS) {
+		return;
+	}
+
+	// the rotation is simulation state, the rest belongs to the render stage
+	if (key == GLFW_KEY_R) {
+		_animating = !_animating;
+	} else {
+		_pressed_keys.push_back(key);
+	}
+	invalidate(FrameInvalidation::SETTINGS);
+}
+
+void Application::handle_key(int key) {
+	if (key == GLFW_KEY_M) {
+		auto it = std::find(anti_aliasing_presets.begin(), anti_aliasing_presets.end(), _anti_aliasing.name());
+		auto next = (it == anti_aliasing_presets.end() || it + 1 == anti_aliasing_presets.end()) ? anti_aliasing_presets.begin() : it + 1;
+		set_anti_aliasing(AntiAliasingPolicy::parse(*next).value());
+		std::cout << "anti-aliasing " << *next << std::endl;
+	}
+
+	if (key == GLFW_KEY_P && !_prepass_benchmark) {
+		_depth_prepass = !_depth_prepass;
+		_render_graph_dirty = true;
+		std::cout << "depth pre-pass " << (_depth_prepass ? "on" : "off") << std::endl;
+	}
 }
 
 void Application::init_vulkan() {
+	mount_asset_archive();
+
+	// parsing the model needs no device, it overlaps with everything up to the vertex buffer
+	JobCounter modelLoaded;
+	std::exception_ptr modelError;
+	_jobs.submit([this, &modelError]() {
+		try {
+			load_model();
+		} catch (...) {
+			modelError = std::current_exception();
+		}
+	}, &modelLoaded);
+
 	create_instance();
 	setup_debug_messenger();
 	create_surface();
 	pick_physical_device();
 	create_logic_device();
-	create_swap_chain();
-	create_image_views();
-	create_render_pass();
+	// compiles take long enough to stall the frame's parallel_for if they ran as jobs, so
+	// they keep their own threads, sized against the job system so loading does not
+	// oversubscribe the cores
+	_pipeline_compiler.init(_device, _pipeline_cache_path.empty() ? PIPELINE_CACHE_PATH : _pipeline_cache_path,
+		std::max<size_t>(1, _jobs.thread_count() / 2));
+	create_descriptor_allocators();
+	if (headless()) {
+		create_offscreen_targets();
+	} else {
+		create_swap_chain();
+		create_image_views();
+	}
+	_render_graph.init(_physical_device, _device);
+	if (_cmd_begin_rendering != nullptr && _cmd_end_rendering != nullptr) {
+		_render_graph.set_dynamic_rendering(_cmd_begin_rendering, _cmd_end_rendering);
+	}
+	// before the graph, which only adds the capture passes while a stream is open
+	open_capture();
+	build_render_graph();
 	create_descriptor_layout();
-	create_pipeline();
+	create_texture_descriptor_layout();
+	create_pipeline_layout();
+	create_post_process_resources();
+	create_capture_resources();
+	create_cull_resources();
+	// only the fallback blocks startup, the model draws with it until its own variants are ready
+	create_pipelines(required_pipeline_keys());
     create_command_pool();
-    create_color_resources();
-	create_depth_resources();
-	create_framebuffers();
-	create_texture_image();
-	create_texture_image_view();
 	create_texture_sampler();
-	load_model();
+	create_texture_descriptor_set();
+	// slot 0, for untextured materials drawn with the fallback
+	static const uint8_t WHITE[4] = {255, 255, 255, 255};
+	create_texture(WHITE, 1, 1);
+	_jobs.wait(modelLoaded);
+	if (modelError) {
+		std::rethrow_exception(modelError);
+	}
+	create_materials();
+	request_model_pipelines();
+	build_scene();
 	create_vertex_buffer();
+	create_position_buffer();
 	create_index_buffer();
 	create_uniform_buffers();
-	create_descriptor_pool();
-	create_descriptor_sets();
 	create_command_buffers();
 	create_sync_objects();
+	create_statistics_query_pool();
+	create_timestamp_query_pool();
+
+	// a batch renders with the shaders it started with
+	if (!headless()) {
+		_shader_manager = std::make_unique<ShaderManager>(SHADER_SOURCE_DIR, ".");
+		_shader_manager->set_recompiled_callback([this]() {
+			invalidate(FrameInvalidation::SETTINGS);
+		});
+		_shader_manager->start();
+	}
 }
 
 void Application::main_loop() {
+	_last_sample = std::chrono::steady_clock::now();
+	_frame_input_times.assign(MAX_FRAMES_IN_FLIGHT, std::nullopt);
+	_frame_stats.start();
+	configure_frame_limiter();
+
+	// the benchmark counts consecutive frames
+	if (_prepass_benchmark) {
+		_on_demand = false;
+	}
+	_animating = !_on_demand;
+
+	if (_frame_pipelining) {
+		pipelined_main_loop();
+	} else {
+		while (!glfwWindowShouldClose(_window)) {
+			wait_for_frame();
+			_jobs.run_main_thread_jobs();
+			if (frame_needed()) {
+				render_frame(sample_input());
+			}
+		}
+	}
+
+	vkDeviceWaitIdle(_device);
+	record_frame_latencies();
+	std::cout << _frame_stats.summary(_frame_pipelining ? "pipelined" : "serial") << std::endl;
+}
+
+void Application::pipelined_main_loop() {
+	// one frame queued: the next frame is simulated while the render thread records
+	// and submits this one, and the GPU still works on the one before
+	FrameInputQueue queue(1);
+	std::exception_ptr renderError;
+
+	std::thread renderThread([this, &queue, &renderError]() {
+		try {
+			FrameInput input;
+			while (queue.pop(input)) {
+				render_frame(input);
+			}
+		} catch (...) {
+			renderError = std::current_exception();
+			queue.close();
+			glfwSetWindowShouldClose(_window, GLFW_TRUE);
+			glfwPostEmptyEvent();
+		}
+	});
+
 	while (!glfwWindowShouldClose(_window)) {
-        glfwPollEvents();
-        draw_frame();
-    }
+		if (!queue.wait_for_space()) {
+			break;
+		}
+		wait_for_frame();
+		_jobs.run_main_thread_jobs();
+		if (frame_needed()) {
+			queue.push(sample_input());
+		}
+	}
+
+	queue.close();
+	renderThread.join();
+	if (renderError) {
+		std::rethrow_exception(renderError);
+	}
+}
+
+void Application::wait_for_frame() {
+	if (_on_demand) {
+		if (_animating) {
+			_invalidation.invalidate(FrameInvalidation::SCENE);
+		}
+		if (_camera_eye != _sampled_camera_eye || _camera_target != _sampled_camera_target) {
+			_invalidation.invalidate(FrameInvalidation::CAMERA);
+		}
+
+		// every invalidation from another thread posts an empty event, the timeout is a safety net
+		if (!_invalidation.pending()) {
+			_idled = true;
+			glfwWaitEventsTimeout(ON_DEMAND_IDLE_TIMEOUT);
+			return;
+		}
+	}
+
+	_frame_limiter.wait();
+	glfwPollEvents();
+}
+
+bool Application::frame_needed() {
+	return !_on_demand || _invalidation.take() != 0;
+}
+
+void Application::invalidate(uint32_t reasons) {
+	_invalidation.invalidate(reasons);
+	if (_on_demand && _window != nullptr) {
+		glfwPostEmptyEvent();
+	}
+}
+
+FrameInput Application::sample_input() {
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(_window, &width, &height);
+	// minimized; there is nothing to render into until the window comes back
+	while ((width == 0 || height == 0) && !glfwWindowShouldClose(_window)) {
+		glfwWaitEvents();
+		glfwGetFramebufferSize(_window, &width, &height);
+	}
+
+	FrameInput input;
+	input.number = _input_count++;
+	input.sampled = std::chrono::steady_clock::now();
+	if (_animating) {
+		_scene_time += std::chrono::duration<float>(input.sampled - _last_sample).count();
+	}
+	_last_sample = input.sampled;
+	input.time = _scene_time;
+	input.camera_eye = _sampled_camera_eye = _camera_eye;
+	input.camera_target = _sampled_camera_target = _camera_target;
+	input.pressed_keys.swap(_pressed_keys);
+	input.framebuffer_extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+	input.framebuffer_resized = _framebuffer_resized;
+	_framebuffer_resized = false;
+	input.after_idle = _idled;
+	_idled = false;
+	return input;
+}
+
+void Application::render_frame(const FrameInput& input) {
+	for (int key : input.pressed_keys) {
+		handle_key(key);
+	}
+	_framebuffer_extent = input.framebuffer_extent;
+
+	reload_shaders();
+	if (_render_graph_dirty) {
+		rebuild_render_graph();
+	}
+	draw_frame(input);
+	if (_prepass_benchmark) {
+		step_prepass_benchmark();
+	}
+
+	// the fallback pipeline stood in, draw again once the real one is there
+	if (!_pending_pipelines.empty()) {
+		invalidate(FrameInvalidation::SETTINGS);
+	}
+}
+
+void Application::record_frame_latencies() {
+	auto now = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < _frame_input_times.size(); ++i) {
+		if (_frame_input_times[i] && vkGetFenceStatus(_device, _in_flight_fences[i]) == VK_SUCCESS) {
+			_frame_stats.record_latency(*_frame_input_times[i], now);
+			_frame_input_times[i].reset();
+		}
+	}
+}
+
+void Application::reload_shaders() {
+	auto changed = _shader_manager->take_recompiled();
+	// the recompiled SPIR-V is on disk, newer than what the archive holds
+	for (const auto& name : changed) {
+		_blob_cache.reload_from_disk(name + ".spv");
+	}
+
+	if (std::find(changed.begin(), changed.end(), "fxaa.comp") != changed.end()) {
+		try {
+			auto old_pipeline = _fxaa_pipeline;
+			_fxaa_pipeline = create_fxaa_pipeline();
+			defer_destroy([this, old_pipeline]() {
+				vkDestroyPipeline(_device, old_pipeline, nullptr);
+			});
+		} catch (std::exception& e) {
+			std::cerr << "shader reload failed: " << e.what() << std::endl;
+		}
+	}
+
+	if (std::find(changed.begin(), changed.end(), "cull.comp") != changed.end()) {
+		try {
+			auto old_pipeline = _cull_pipeline;
+			_cull_pipeline = create_cull_pipeline();
+			defer_destroy([this, old_pipeline]() {
+				vkDestroyPipeline(_device, old_pipeline, nullptr);
+			});
+		} catch (std::exception& e) {
+			std::cerr << "shader reload failed: " << e.what() << std::endl;
+		}
+	}
+
+	if (_capture_pipeline != VK_NULL_HANDLE && std::find(changed.begin(), changed.end(), "capture_yuv.comp") != changed.end()) {
+		try {
+			auto old_pipeline = _capture_pipeline;
+			_capture_pipeline = create_capture_pipeline();
+			defer_destroy([this, old_pipeline]() {
+				vkDestroyPipeline(_device, old_pipeline, nullptr);
+			});
+		} catch (std::exception& e) {
+			std::cerr << "shader reload failed: " << e.what() << std::endl;
+		}
+	}
+
+	bool affected = std::any_of(changed.begin(), changed.end(), [](const std::string& name) {
+		return std::find(pipeline_shaders.begin(), pipeline_shaders.end(), name) != pipeline_shaders.end();
+	});
+	if (!affected) {
+		return;
+	}
+
+	// variants still compiling were built from the old shaders
+	finish_pending_pipelines();
+
+	auto keys = _pipelines.keys();
+	std::vector<std::shared_future<VkPipeline>> futures;
+	for (auto key : keys) {
+		futures.push_back(_pipeline_compiler.compile([this, key](VkPipelineCache cache) {
+			return build_pipeline(key, cache);
+		}));
+	}
+
+	// all or nothing, so a broken shader never leaves a mix of old and new variants
+	std::vector<VkPipeline> pipelines;
+	bool failed = false;
+	for (auto& future : futures) {
+		try {
+			pipelines.push_back(future.get());
+		} catch (std::exception& e) {
+			std::cerr << "shader reload failed: " << e.what() << std::endl;
+			failed = true;
+		}
+	}
+	if (failed) {
+		for (auto pipeline : pipelines) {
+			vkDestroyPipeline(_device, pipeline, nullptr);
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < keys.size(); ++i) {
+		// frames in flight may still use the old pipeline, so it is destroyed once they retire
+		auto old_pipeline = _pipelines.insert(keys[i], pipelines[i]);
+		defer_destroy([this, old_pipeline]() {
+			vkDestroyPipeline(_device, old_pipeline, nullptr);
+		});
+	}
+}
+
+void Application::mount_asset_archive() {
+	auto path = _asset_archive_path;
+	if (path.empty()) {
+		// loose files only, unless the default archive was built
+		if (!std::filesystem::exists(ASSET_ARCHIVE_PATH)) {
+			return;
+		}
+		path = ASSET_ARCHIVE_PATH;
+	}
+
+	// chunks decompress on the engine's workers rather than threads of their own
+	auto archive = AssetArchive::open(path, &_jobs);
+	std::cout << "assets from " << path << ", " << archive->size() << " entries" << std::endl;
+	_blob_cache.mount(std::move(archive));
+}
 
-    vkDeviceWaitIdle(_device);
+void Application::defer_destroy(std::function<void()>&& destroy) {
+	_deferred_destroys.push_back({_frame_count, std::move(destroy)});
 }
 
-void Application::draw_frame() {
+void Application::flush_deferred_destroys(bool all) {
+	auto it = _deferred_destroys.begin();
+	for (; it != _deferred_destroys.end(); ++it) {
+		if (!all && it->first + MAX_FRAMES_IN_FLIGHT > _frame_count) {
+			break;
+		}
+		it->second();
+	}
+	_deferred_destroys.erase(_deferred_destroys.begin(), it);
+}
+
+void Application::draw_frame(const FrameInput& input) {
+	// before the wait, so frames finished while this one was recorded count from their own fence;
+	// frames that finished while the loop idled have no latency to speak of
+	if (input.after_idle) {
+		_frame_input_times.assign(MAX_FRAMES_IN_FLIGHT, std::nullopt);
+	}
+	record_frame_latencies();
 	vkWaitForFences(_device, 1, &_in_flight_fences[_current_frame], VK_TRUE, UINT64_MAX);
+	record_frame_latencies();
+	// before the fence is reset; captured frames whose fence signalled go to the writer
+	_frame_capture.poll();
+	flush_deferred_destroys(false);
+	collect_pipeline_statistics(_current_frame);
+	collect_gpu_time(_current_frame);
+
+	// the last present found the swap chain no longer matching the surface
+	if (_swap_chain_stale) {
+		recreate_swap_chain();
+	}
 
 	uint32_t imageIndex;
     auto result = vkAcquireNextImageKHR(_device, _swap_chain, UINT64_MAX, _image_available_semaphores[_current_frame], VK_NULL_HANDLE, &imageIndex);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || _framebuffer_resized) {
-    	_framebuffer_resized = false;
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || input.framebuffer_resized) {
     	recreate_swap_chain();
     	return;
     } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
@@ -118,18 +595,31 @@ void Application::draw_frame() {
     }
     _in_flight_image_fences[imageIndex] = _in_flight_fences[_current_frame];
 
-    update_uniform_buffer(imageIndex);
+    // the fence above guarantees the GPU is done with everything this frame slot allocated
+    _frame_descriptor_allocators[_current_frame].reset();
+
+    update_uniform_buffer(_current_frame, input);
+    schedule_culling();
+
+    vkResetCommandBuffer(_command_buffers[_current_frame], 0);
+    record_command_buffer(_command_buffers[_current_frame], imageIndex);
 
     VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	VkSemaphore waitSemaphores[] = {_image_available_semaphores[_current_frame]};
-	VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
+	// plus the compute submit of this frame when it went to the async compute queue
+	std::vector<VkSemaphore> waitSemaphores = {_image_available_semaphores[_current_frame]};
+	// the backbuffer's first write is a blit on the FXAA and capture paths
+	std::vector<VkPipelineStageFlags> waitStages = {_render_graph.first_stages(_backbuffer)};
+	const auto& computeSemaphores = _compute_scheduler.wait_semaphores();
+	const auto& computeStages = _compute_scheduler.wait_stages();
+	waitSemaphores.insert(waitSemaphores.end(), computeSemaphores.begin(), computeSemaphores.end());
+	waitStages.insert(waitStages.end(), computeStages.begin(), computeStages.end());
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &_command_buffers[imageIndex];
+	submitInfo.pCommandBuffers = &_command_buffers[_current_frame];
 	VkSemaphore signalSemaphores[] = {_render_finished_semaphores[_current_frame]};
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
@@ -138,6 +628,7 @@ void Application::draw_frame() {
 	if (vkQueueSubmit(_graphics_queue, 1, &submitInfo, _in_flight_fences[_current_frame]) != VK_SUCCESS) {
  	   throw std::runtime_error("failed to submit draw command buffer!");
 	}
+	_frame_limiter.record_cpu_time(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - input.sampled).count());
 
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -151,20 +642,240 @@ void Application::draw_frame() {
 	presentInfo.pImageIndices = &imageIndex;
 
 	presentInfo.pResults = nullptr; // Optional
-	vkQueuePresentKHR(_present_queue, &presentInfo);
+	result = vkQueuePresentKHR(_present_queue, &presentInfo);
+	// recreated before the next acquire, which only happens if something asks for a frame
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+		_swap_chain_stale = true;
+		invalidate(FrameInvalidation::SWAP_CHAIN);
+	}
+
+	_frame_input_times[_current_frame] = input.sampled;
+	_frame_stats.record_frame();
+
+	_current_frame = (_current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+	++_frame_count;
+}
+
+void Application::batch_loop() {
+	_pending_readbacks.assign(MAX_FRAMES_IN_FLIGHT, PendingReadback());
+
+	auto start = std::chrono::steady_clock::now();
+	uint64_t rendered = 0;
+
+	BatchView view;
+	while (_batch_queue->pop(view)) {
+		// a new size rebuilds the targets, the pipelines are kept
+		if (view.width != _offscreen_extent.width || view.height != _offscreen_extent.height) {
+			for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+				finish_readback(i);
+			}
+			_offscreen_extent = {view.width, view.height};
+			recreate_swap_chain();
+		}
+
+		render_batch_view(view);
+		++rendered;
+	}
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		finish_readback(i);
+	}
+	vkDeviceWaitIdle(_device);
+
+	auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "rendered " << rendered << " images in " << seconds << " s, "
+		<< rendered / seconds << " images/s" << std::endl;
+}
+
+void Application::render_batch_view(const BatchView& view) {
+	vkWaitForFences(_device, 1, &_in_flight_fences[_current_frame], VK_TRUE, UINT64_MAX);
+	// the image this slot rendered two views ago is complete, it goes to the encoders
+	// while the GPU works on the other slot
+	finish_readback(_current_frame);
+	flush_deferred_destroys(false);
+	collect_pipeline_statistics(_current_frame);
+
+	_frame_descriptor_allocators[_current_frame].reset();
+
+	// batch images show the model at rest, the same for every run
+	FrameInput input;
+	input.camera_eye = view.eye;
+	input.camera_target = view.target;
+	update_uniform_buffer(_current_frame, input);
+	schedule_culling();
+
+	// offscreen targets are per frame slot, so the slot is the image index
+	vkResetCommandBuffer(_command_buffers[_current_frame], 0);
+	record_command_buffer(_command_buffers[_current_frame], _current_frame);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	const auto& waitSemaphores = _compute_scheduler.wait_semaphores();
+	const auto& waitStages = _compute_scheduler.wait_stages();
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &_command_buffers[_current_frame];
+
+	vkResetFences(_device, 1, &_in_flight_fences[_current_frame]);
+	if (vkQueueSubmit(_graphics_queue, 1, &submitInfo, _in_flight_fences[_current_frame]) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit draw command buffer!");
+	}
+
+	auto& readback = _pending_readbacks[_current_frame];
+	readback.pending = true;
+	readback.output = view.output;
+	readback.extent = _swap_chain_extent;
+
+	_current_frame = (_current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+	++_frame_count;
+}
+
+void Application::finish_readback(size_t frame) {
+	auto& readback = _pending_readbacks[frame];
+	if (!readback.pending) {
+		return;
+	}
+	vkWaitForFences(_device, 1, &_in_flight_fences[frame], VK_TRUE, UINT64_MAX);
+
+	// the memory may be cached without being coherent
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = _readback_buffers_memory[frame];
+	range.offset = 0;
+	range.size = VK_WHOLE_SIZE;
+	vkInvalidateMappedMemoryRanges(_device, 1, &range);
+
+	// copied out so the slot can render again while the encoders work
+	auto size = static_cast<size_t>(readback.extent.width) * readback.extent.height * 4;
+	auto pixels = static_cast<const uint8_t*>(_readback_buffers_mapped[frame]);
+	_image_writer->write_png(readback.output, readback.extent.width, readback.extent.height, std::vector<uint8_t>(pixels, pixels + size));
+
+	readback.pending = false;
+}
+
+void Application::create_offscreen_targets() {
+	// RGBA8 so the read back pixels go to the encoder as they are
+	_swap_chain_format = VK_FORMAT_R8G8B8A8_SRGB;
+	_swap_chain_extent = _offscreen_extent;
+	_swap_chain_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+	_swap_chain_images.resize(MAX_FRAMES_IN_FLIGHT);
+	_swap_chain_image_views.resize(MAX_FRAMES_IN_FLIGHT);
+	_offscreen_image_memory.resize(MAX_FRAMES_IN_FLIGHT);
+	_readback_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+	_readback_buffers_memory.resize(MAX_FRAMES_IN_FLIGHT);
+	_readback_buffers_mapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+	VkDeviceSize size = static_cast<VkDeviceSize>(_swap_chain_extent.width) * _swap_chain_extent.height * 4;
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		create_image(_swap_chain_extent.width, _swap_chain_extent.height, 1, VK_SAMPLE_COUNT_1_BIT, _swap_chain_format,
+			VK_IMAGE_TILING_OPTIMAL, _swap_chain_usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			_swap_chain_images[i], _offscreen_image_memory[i]);
+		_swap_chain_image_views[i] = create_image_view(_swap_chain_images[i], _swap_chain_format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+		// the CPU reads every byte, cached memory makes that several times faster
+		create_buffer(size,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			_readback_buffers[i],
+			_readback_buffers_memory[i],
+			{},
+			VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+		vkMapMemory(_device, _readback_buffers_memory[i], 0, size, 0, &_readback_buffers_mapped[i]);
+	}
+}
+
+void Application::record_readback(VkCommandBuffer command_buffer) {
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {_swap_chain_extent.width, _swap_chain_extent.height, 1};
+
+	vkCmdCopyImageToBuffer(command_buffer, _render_graph.image(_backbuffer), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, _readback_buffers[_current_frame], 1, &region);
+
+	// makes the copy visible to the host once the fence signals
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = _readback_buffers[_current_frame];
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(command_buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+		0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+}
 
-	_current_frame = (_current_frame + 1) % _swap_chain_images.size();
+VkDescriptorSet Application::allocate_transient_descriptor_set(VkDescriptorSetLayout layout) {
+	return _frame_descriptor_allocators[_current_frame].allocate(layout);
 }
 
 void Application::cleanup() {
+	if (_shader_manager) {
+		_shader_manager->stop();
+	}
+
+	finish_pending_pipelines();
+	// the device is idle, so every captured frame is complete
+	_frame_capture.close();
+	_pipelines.clear(_device);
 	cleanup_swap_chain();
+	_pipeline_compiler.destroy();
+
+	flush_deferred_destroys(true);
+
+	vkDestroyPipelineLayout(_device, _pipeline_layout, nullptr);
+
+	vkDestroyPipeline(_device, _cull_pipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _cull_pipeline_layout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _cull_descriptor_layout, nullptr);
+	destroy_cull_buffers();
+	_compute_scheduler.destroy();
+
+	vkDestroyPipeline(_device, _fxaa_pipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _fxaa_pipeline_layout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _fxaa_descriptor_layout, nullptr);
+	vkDestroySampler(_device, _post_process_sampler, nullptr);
+
+	if (_capture_pipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(_device, _capture_pipeline, nullptr);
+		vkDestroyPipelineLayout(_device, _capture_pipeline_layout, nullptr);
+		vkDestroyDescriptorSetLayout(_device, _capture_descriptor_layout, nullptr);
+	}
+
+	_descriptor_allocator.destroy();
+	for (auto& allocator : _frame_descriptor_allocators) {
+		allocator.destroy();
+	}
+	vkDestroyDescriptorSetLayout(_device, _texture_descriptor_layout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _descriptor_layout, nullptr);
 
 	vkDestroySampler(_device, _texture_sampler, nullptr);
-	vkDestroyImageView(_device, _texture_image_view, nullptr);
-	vkDestroyImage(_device, _texture_image, nullptr);
-    vkFreeMemory(_device, _texture_image_memory, nullptr);
+	for (auto& texture : _textures) {
+		vkDestroyImageView(_device, texture.view, nullptr);
+		vkDestroyImage(_device, texture.image, nullptr);
+	    vkFreeMemory(_device, texture.memory, nullptr);
+	}
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        vkDestroyBuffer(_device, _uniform_buffers[i], nullptr);
+        vkFreeMemory(_device, _uniform_buffers_memory[i], nullptr);
+    }
 
-	for (size_t i=0; i<_swap_chain_images.size(); ++i) {
+	for (size_t i=0; i<MAX_FRAMES_IN_FLIGHT; ++i) {
 		vkDestroySemaphore(_device, _render_finished_semaphores[i], nullptr);
     	vkDestroySemaphore(_device, _image_available_semaphores[i], nullptr);
     	vkDestroyFence(_device, _in_flight_fences[i], nullptr);
@@ -175,15 +886,29 @@ void Application::cleanup() {
 	vkDestroyBuffer(_device, _vertex_buffer, nullptr);
 	vkFreeMemory(_device, _vertex_buffer_memory, nullptr);
 
+	vkDestroyBuffer(_device, _position_buffer, nullptr);
+	vkFreeMemory(_device, _position_buffer_memory, nullptr);
+
+	if (_statistics_query_pool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(_device, _statistics_query_pool, nullptr);
+	}
+	if (_timestamp_query_pool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(_device, _timestamp_query_pool, nullptr);
+	}
+
 	vkDestroyCommandPool(_device, _command_pool, nullptr);
 	
 	vkDestroyDevice(_device, nullptr);
-	vkDestroySurfaceKHR(_instance, _surface, nullptr);
+	if (_surface != VK_NULL_HANDLE) {
+		vkDestroySurfaceKHR(_instance, _surface, nullptr);
+	}
 	teardown_debug_messenger();
 	vkDestroyInstance(_instance, nullptr);
 
-	glfwDestroyWindow(_window);
-    glfwTerminate();
+	if (_window != nullptr) {
+		glfwDestroyWindow(_window);
+	    glfwTerminate();
+	}
 }
 
 void Application::create_instance() {
@@ -194,7 +919,7 @@ void Application::create_instance() {
     app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     app_info.pEngineName = "No Engine";
     app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    app_info.apiVersion = VK_API_VERSION_1_0;
+    app_info.apiVersion = VK_API_VERSION_1_3;
 
     // create info
 	VkInstanceCreateInfo create_info{};
@@ -212,10 +937,12 @@ void Application::create_instance() {
 		create_info.enabledLayerCount = 0;
 	}
 
-	// extensions
+	// extensions, none for the surface when rendering headless
 	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	const char** glfwExtensions = nullptr;
+	if (!headless()) {
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	}
 
 	if (!check_extensions_support(glfwExtensions, glfwExtensions + glfwExtensionCount)) {
 		throw std::runtime_error("not all glfw extensions supported!");
@@ -244,7 +971,7 @@ std::vector<VkExtensionProperties> Application::extensions(const char* layer_nam
 	std::vector<VkExtensionProperties> extensions(extension_count);
 	vkEnumerateInstanceExtensionProperties(layer_name, &extension_count, extensions.data());
 
-	return std::move(extensions);
+	return extensions;
 }
 
 template <class Itor>
@@ -269,7 +996,7 @@ std::vector<VkLayerProperties> Application::layers() {
 	std::vector<VkLayerProperties> layers(layer_count);
 	vkEnumerateInstanceLayerProperties(&layer_count, layers.data());
 
-	return std::move(layers);
+	return layers;
 }
 
 template <class Itor>
@@ -342,6 +1069,9 @@ void Application::teardown_debug_messenger() {
 }
 
 void Application::create_surface() {
+	if (headless()) {
+		return;
+	}
 	if (glfwCreateWindowSurface(_instance, _window, nullptr, &_surface) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create window surface");
 	}
@@ -357,7 +1087,7 @@ std::vector<VkPhysicalDevice> Application::physical_devices() {
 	std::vector<VkPhysicalDevice> devices(count);
 	vkEnumeratePhysicalDevices(_instance, &count, devices.data());
 
-	return std::move(devices);
+	return devices;
 }
 
 std::vector<VkQueueFamilyProperties> Application::queue_families(VkPhysicalDevice device) {
@@ -370,7 +1100,7 @@ std::vector<VkQueueFamilyProperties> Application::queue_families(VkPhysicalDevic
 	std::vector<VkQueueFamilyProperties> families(count);
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &count, families.data());
 
-	return std::move(families);
+	return families;
 }
 
 std::optional<uint32_t> Application::find_queue_family(VkPhysicalDevice device, uint32_t queue_flags, VkSurfaceKHR surface) {
@@ -399,6 +1129,18 @@ std::optional<uint32_t> Application::find_queue_family(VkPhysicalDevice device,
 	return std::optional<uint32_t>();
 }
 
+std::optional<uint32_t> Application::find_async_compute_family(VkPhysicalDevice device) {
+	auto families = queue_families(device);
+	for (size_t i=0; i<families.size(); ++i) {
+		if ((families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0
+			&& (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0) {
+			return i;
+		}
+	}
+
+	return std::optional<uint32_t>();
+}
+
 std::vector<VkExtensionProperties> Application::device_extensions(VkPhysicalDevice device) {
 	uint32_t count;
     vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
@@ -406,7 +1148,7 @@ std::vector<VkExtensionProperties> Application::device_extensions(VkPhysicalDevi
     std::vector<VkExtensionProperties> extensions(count);
     vkEnumerateDeviceExtensionProperties(device, nullptr, &count, extensions.data());
 
-    return std::move(extensions);
+    return extensions;
 }
 
 template <class Itor>
@@ -449,33 +1191,93 @@ SwapChainDetails Application::query_swapchain_details(VkPhysicalDevice device) {
 }
 
 void Application::pick_physical_device() {
-	for (auto& device : physical_devices()) {
-		if (is_device_suitable(device)) {
-			_physical_device = device;
-			_msaa_samples = get_max_usable_sample_count();
-			return;
-		}
-	}
+	DeviceSelector selector;
+	selector.rank(physical_devices(), [this](VkPhysicalDevice device) {
+		return is_device_suitable(device);
+	});
 
-	throw std::runtime_error("no suitable device");
+	const auto& chosen = selector.select(_device_override);
+	selector.log(chosen);
+
+	_physical_device = chosen.device;
+	_max_msaa_samples = get_max_usable_sample_count();
+	apply_anti_aliasing_policy();
 }
 
 bool Application::is_device_suitable(VkPhysicalDevice device) {
 	VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
-	return check_device_extensions_support(used_device_extensions.begin(), used_device_extensions.end(), device)
-		&& query_swapchain_details(device).is_complete()
+	// offscreen rendering needs neither the swap chain nor presentation
+	bool presentable = headless()
+		|| (check_device_extensions_support(used_device_extensions.begin(), used_device_extensions.end(), device)
+			&& query_swapchain_details(device).is_complete()
+			&& find_queue_family(device, 0, _surface).has_value());
+
+	return presentable
 	 	&& find_queue_family(device, VK_QUEUE_GRAPHICS_BIT).has_value()
-		&& find_queue_family(device, 0, _surface).has_value()
-		&& supportedFeatures.samplerAnisotropy;
+		&& supportedFeatures.samplerAnisotropy
+		&& check_descriptor_indexing_support(device);
+}
+
+Application::DynamicRenderingSupport Application::check_dynamic_rendering_support(VkPhysicalDevice device) {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+
+	const char* extension = VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME;
+	bool core = properties.apiVersion >= VK_API_VERSION_1_3;
+	if (!core && !check_device_extensions_support(&extension, &extension + 1, device)) {
+		return DynamicRenderingSupport::NONE;
+	}
+
+	// the KHR and core feature structs are the same, only the names differ
+	VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering_features{};
+	dynamic_rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &dynamic_rendering_features;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	if (!dynamic_rendering_features.dynamicRendering) {
+		return DynamicRenderingSupport::NONE;
+	}
+	return core ? DynamicRenderingSupport::CORE : DynamicRenderingSupport::EXTENSION;
+}
+
+bool Application::check_descriptor_indexing_support(VkPhysicalDevice device) {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_2) {
+		return false;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeatures indexing_features{};
+	indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &indexing_features;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return indexing_features.runtimeDescriptorArray
+		&& indexing_features.descriptorBindingPartiallyBound
+		&& indexing_features.descriptorBindingVariableDescriptorCount
+		&& indexing_features.descriptorBindingSampledImageUpdateAfterBind
+		&& indexing_features.descriptorBindingUpdateUnusedWhilePending
+		&& indexing_features.shaderSampledImageArrayNonUniformIndexing;
 }
 
 void Application::create_logic_device() {
 	auto graphics_family = find_queue_family(_physical_device, VK_QUEUE_GRAPHICS_BIT);
-	auto present_family = find_queue_family(_physical_device, 0, _surface);
+	auto present_family = headless() ? graphics_family : find_queue_family(_physical_device, 0, _surface);
+	// optional, compute work runs on the graphics queue without it
+	auto compute_family = _async_compute_allowed ? find_async_compute_family(_physical_device) : std::optional<uint32_t>();
 
 	std::set unique_queue_families = {graphics_family.value(), present_family.value()};
+	if (compute_family.has_value()) {
+		unique_queue_families.insert(compute_family.value());
+	}
 	std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
 
 	float queuePriority = 1.0f;
@@ -493,13 +1295,44 @@ void Application::create_logic_device() {
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
 	deviceFeatures.sampleRateShading = VK_TRUE;
 
+	// optional, only used to count fragment shader invocations
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(_physical_device, &supportedFeatures);
+	_pipeline_statistics_supported = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+	deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+
+	// bindless textures: one runtime sized, partially bound sampler array updated after bind
+	VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+	indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+	indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+	indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+	indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+
+	std::vector<const char*> extensions = headless() ? std::vector<const char*>() : used_device_extensions;
+
+	// optional, the render graph falls back to render passes without it
+	auto dynamic_rendering = _dynamic_rendering_allowed ? check_dynamic_rendering_support(_physical_device) : DynamicRenderingSupport::NONE;
+	VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{};
+	dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+	dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+	if (dynamic_rendering != DynamicRenderingSupport::NONE) {
+		indexingFeatures.pNext = &dynamicRenderingFeatures;
+	}
+	if (dynamic_rendering == DynamicRenderingSupport::EXTENSION) {
+		extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+	}
+
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &indexingFeatures;
 	createInfo.pQueueCreateInfos = queue_create_infos.data();
 	createInfo.queueCreateInfoCount = queue_create_infos.size();
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = used_device_extensions.size();
-	createInfo.ppEnabledExtensionNames = used_device_extensions.data();
+	createInfo.enabledExtensionCount = extensions.size();
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	// we don't need it now
 	if (enable_validation_layers) {
@@ -515,6 +1348,26 @@ void Application::create_logic_device() {
 
 	vkGetDeviceQueue(_device, graphics_family.value(), 0, &_graphics_queue);
 	vkGetDeviceQueue(_device, present_family.value(), 0, &_present_queue);
+
+	VkQueue computeQueue = VK_NULL_HANDLE;
+	if (compute_family.has_value()) {
+		vkGetDeviceQueue(_device, compute_family.value(), 0, &computeQueue);
+	}
+	_compute_scheduler.init(_device, graphics_family.value(), compute_family.value_or(graphics_family.value()), computeQueue, MAX_FRAMES_IN_FLIGHT);
+	if (compute_family.has_value()) {
+		std::cout << "async compute on queue family " << compute_family.value() << std::endl;
+	} else {
+		std::cout << "compute on the graphics queue" << std::endl;
+	}
+
+	if (dynamic_rendering == DynamicRenderingSupport::CORE) {
+		_cmd_begin_rendering = reinterpret_cast<PFN_vkCmdBeginRendering>(vkGetDeviceProcAddr(_device, "vkCmdBeginRendering"));
+		_cmd_end_rendering = reinterpret_cast<PFN_vkCmdEndRendering>(vkGetDeviceProcAddr(_device, "vkCmdEndRendering"));
+	} else if (dynamic_rendering == DynamicRenderingSupport::EXTENSION) {
+		_cmd_begin_rendering = reinterpret_cast<PFN_vkCmdBeginRendering>(vkGetDeviceProcAddr(_device, "vkCmdBeginRenderingKHR"));
+		_cmd_end_rendering = reinterpret_cast<PFN_vkCmdEndRendering>(vkGetDeviceProcAddr(_device, "vkCmdEndRenderingKHR"));
+	}
+	std::cout << "rendering with " << (_cmd_begin_rendering != nullptr ? "dynamic rendering" : "render passes") << std::endl;
 }
 
 VkSurfaceFormatKHR Application::choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& formats) {
@@ -528,26 +1381,20 @@ VkSurfaceFormatKHR Application::choose_swap_surface_format(const std::vector<VkS
 }
 
 VkPresentModeKHR Application::choose_swap_present_mode(const std::vector<VkPresentModeKHR>& modes) {
-	for (const auto& mode : modes) {
-        if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return mode;
-        }
-    }
-
-    return VK_PRESENT_MODE_FIFO_KHR;
+	auto mode = _present_policy.choose_mode(modes);
+	if (_present_policy.mode && mode != *_present_policy.mode) {
+		std::cout << "present mode " << PresentPolicy::mode_name(*_present_policy.mode) << " not supported, using "
+			<< PresentPolicy::mode_name(mode) << std::endl;
+	}
+	return mode;
 }
 
 VkExtent2D Application::choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities) {
 	if (capabilities.currentExtent.width != UINT32_MAX) {
         return capabilities.currentExtent;
     } else {
-        int width, height;
-        glfwGetFramebufferSize(_window, &width, &height);
-
-        VkExtent2D actualExtent = {
-            static_cast<uint32_t>(width),
-            static_cast<uint32_t>(height)
-        };
+        // sampled on the main thread with the frame input, this may run on the render thread
+        VkExtent2D actualExtent = _framebuffer_extent;
 
         actualExtent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actualExtent.width));
         actualExtent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, actualExtent.height));
@@ -577,7 +1424,13 @@ void Application::create_swap_chain() {
 	createInfo.imageColorSpace = surfaceFormat.colorSpace;
 	createInfo.imageExtent = extent;
 	createInfo.imageArrayLayers = 1;
-	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	// transfers into the image are only used by the FXAA path, out of it by the frame capture
+	_swap_chain_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+		| (swap_chain_details.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	if (!_capture_path.empty()) {
+		_swap_chain_usage |= swap_chain_details.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+	createInfo.imageUsage = _swap_chain_usage;
 
 	auto graphics_family = find_queue_family(_physical_device, VK_QUEUE_GRAPHICS_BIT);
 	auto present_family = find_queue_family(_physical_device, 0, _surface);
@@ -596,6 +1449,7 @@ void Application::create_swap_chain() {
 	createInfo.preTransform = swap_chain_details.capabilities.currentTransform;
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
+	_present_mode = presentMode;
 	createInfo.clipped = VK_TRUE;
 	createInfo.oldSwapchain = VK_NULL_HANDLE;
 
@@ -619,12 +1473,136 @@ void Application::create_image_views() {
 	}
 }
 
-void Application::create_pipeline() {
-    auto vertShaderCode = read_file("default.vert.spv");
-    auto fragShaderCode = read_file("default.frag.spv");
+void Application::create_pipelines(const std::vector<PipelineKey>& keys) {
+	for (auto key : keys) {
+		request_pipeline(key);
+	}
+	finish_pending_pipelines();
+}
+
+void Application::request_pipeline(PipelineKey key) {
+	if (_pipelines.find(key) != VK_NULL_HANDLE || _pending_pipelines.count(key) > 0) {
+		return;
+	}
+
+	_pending_pipelines[key] = _pipeline_compiler.compile([this, key](VkPipelineCache cache) {
+		return build_pipeline(key, cache);
+	});
+}
+
+void Application::finish_pending_pipelines() {
+	for (auto& [key, future] : _pending_pipelines) {
+		_pipelines.insert(key, future.get());
+	}
+	_pending_pipelines.clear();
+}
+
+VkPipeline Application::get_pipeline(PipelineKey key) {
+	auto pipeline = _pipelines.find(key);
+	if (pipeline != VK_NULL_HANDLE) {
+		return pipeline;
+	}
+
+	request_pipeline(key);
+
+	auto it = _pending_pipelines.find(key);
+	if (it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		pipeline = it->second.get();
+		_pending_pipelines.erase(it);
+		_pipelines.insert(key, pipeline);
+		return pipeline;
+	}
+
+	// alpha testing and the depth test change which pixels are drawn, the fallback has to
+	// agree with the requested variant on both; without one the draw waits for its variant
+	auto fallbackKey = _fallback_pipeline_key | (key & (PIPELINE_FEATURE_ALPHA_TEST | PIPELINE_FEATURE_DEPTH_EQUAL));
+	if (fallbackKey == key) {
+		return VK_NULL_HANDLE;
+	}
+	request_pipeline(fallbackKey);
+	return _pipelines.find(fallbackKey);
+}
+
+VkPipeline Application::build_pipeline(PipelineKey key, VkPipelineCache cache) {
+	if (key & PIPELINE_FEATURE_DEPTH_ONLY) {
+		return create_pipeline<PositionVertex>(key, cache);
+	}
+	return create_pipeline<Vertex>(key, cache);
+}
+
+std::vector<PipelineKey> Application::required_pipeline_keys() const {
+	std::vector<PipelineKey> keys = {main_pass_key(_fallback_pipeline_key)};
+	if (_depth_prepass) {
+		keys.push_back(PIPELINE_FEATURE_DEPTH_ONLY);
+	}
+	return keys;
+}
+
+PipelineKey Application::main_pass_key(PipelineKey features) const {
+	return _depth_prepass ? (features | PIPELINE_FEATURE_DEPTH_EQUAL) : features;
+}
+
+PipelineKey Application::draw_pipeline_key(const DrawMaterial& material) const {
+	auto key = material.features | _shared_pipeline_features;
+	// cut out materials are not in the depth pre-pass, they test and write depth as without it
+	return (material.features & PIPELINE_FEATURE_ALPHA_TEST) ? key : main_pass_key(key);
+}
+
+void Application::request_model_pipelines() {
+	for (const auto& material : _materials) {
+		request_pipeline(draw_pipeline_key(material));
+	}
+}
+
+void Application::apply_anti_aliasing_policy() {
+	_msaa_samples = std::min(_anti_aliasing.samples, _max_msaa_samples);
 
-    VkShaderModule vertShaderModule = create_shader_module(vertShaderCode);
-    VkShaderModule fragShaderModule = create_shader_module(fragShaderCode);
+	_shared_pipeline_features &= ~PIPELINE_FEATURE_SAMPLE_SHADING;
+	if (_anti_aliasing.sample_shading && _msaa_samples != VK_SAMPLE_COUNT_1_BIT) {
+		_shared_pipeline_features |= PIPELINE_FEATURE_SAMPLE_SHADING;
+	}
+}
+
+bool Application::fxaa_supported() {
+	// the result is blitted into the swap chain image, which needs to accept it
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(_physical_device, _swap_chain_format, &props);
+	return (_swap_chain_usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+		&& (props.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+}
+
+void Application::rebuild_render_graph() {
+	vkDeviceWaitIdle(_device);
+	_render_graph_dirty = false;
+
+	// variants of the old graph may target render passes that no longer exist
+	finish_pending_pipelines();
+	_pipelines.clear(_device);
+	_render_graph.reset();
+
+	apply_anti_aliasing_policy();
+	build_render_graph();
+	create_pipelines(required_pipeline_keys());
+	request_model_pipelines();
+
+	_statistics_recorded.assign(MAX_FRAMES_IN_FLIGHT, false);
+}
+
+// runs on the compiler's worker threads, so it must only read state that stays
+// fixed while compiles are pending (see finish_pending_pipelines)
+template <class VertexType>
+VkPipeline Application::create_pipeline(PipelineKey key, VkPipelineCache cache) {
+	// depth only variants run just the vertex stage and have no color attachment
+	bool depthOnly = (key & PIPELINE_FEATURE_DEPTH_ONLY) != 0;
+	bool depthEqual = (key & PIPELINE_FEATURE_DEPTH_EQUAL) != 0;
+
+    // every variant maps the same few files, the cache shares them
+    auto vertShaderCode = _blob_cache.load(depthOnly ? "depth_only.vert.spv" : "default.vert.spv");
+    VkShaderModule vertShaderModule = create_shader_module(vertShaderCode->span());
+    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+    if (!depthOnly) {
+    	fragShaderModule = create_shader_module(_blob_cache.load("default.frag.spv")->span());
+    }
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
 	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -639,10 +1617,14 @@ void Application::create_pipeline() {
 	fragShaderStageInfo.module = fragShaderModule;
 	fragShaderStageInfo.pName = "main";
 
+	// features the variant doesn't use are compiled out of the fragment shader
+	Specialization<FragmentSpecialization> fragSpecialization(FragmentSpecialization::from_key(key));
+	fragShaderStageInfo.pSpecializationInfo = fragSpecialization.info();
+
 	VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescriptions = Vertex::getAttributeDescriptions();
+	auto bindingDescription = VertexType::getBindingDescription();
+	auto attributeDescriptions = VertexType::getAttributeDescriptions();
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vertexInputInfo.vertexBindingDescriptionCount = 1;
@@ -655,24 +1637,17 @@ void Application::create_pipeline() {
 	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-	VkViewport viewport{};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float) _swap_chain_extent.width;
-	viewport.height = (float) _swap_chain_extent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor{};
-	scissor.offset = {0, 0};
-	scissor.extent = _swap_chain_extent;
-
+	// set per pass with set_viewport(), so a resize keeps the pipelines
 	VkPipelineViewportStateCreateInfo viewportState{};
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
 	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
+
+	std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
 
 	VkPipelineRasterizationStateCreateInfo rasterizer{};
 	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -689,9 +1664,9 @@ void Application::create_pipeline() {
 
 	VkPipelineMultisampleStateCreateInfo multisampling{};
 	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_TRUE;
+	multisampling.sampleShadingEnable = (key & PIPELINE_FEATURE_SAMPLE_SHADING) ? VK_TRUE : VK_FALSE;
 	multisampling.rasterizationSamples = _msaa_samples;
-	multisampling.minSampleShading = .2f; // Optional
+	multisampling.minSampleShading = _anti_aliasing.min_sample_shading; // Optional
 	multisampling.pSampleMask = nullptr; // Optional
 	multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
 	multisampling.alphaToOneEnable = VK_FALSE; // Optional
@@ -710,29 +1685,19 @@ void Application::create_pipeline() {
 	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 	colorBlending.logicOpEnable = VK_FALSE;
 	colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-	colorBlending.attachmentCount = 1;
+	colorBlending.attachmentCount = depthOnly ? 0 : 1;
 	colorBlending.pAttachments = &colorBlendAttachment;
 	colorBlending.blendConstants[0] = 0.0f; // Optional
 	colorBlending.blendConstants[1] = 0.0f; // Optional
 	colorBlending.blendConstants[2] = 0.0f; // Optional
 	colorBlending.blendConstants[3] = 0.0f; // Optional
 
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1; // Optional
-	pipelineLayoutInfo.pSetLayouts = &_descriptor_layout; // Optional
-	pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-	pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-	if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_pipeline_layout) != VK_SUCCESS) {
-	    throw std::runtime_error("failed to create pipeline layout!");
-	}
-
 	VkPipelineDepthStencilStateCreateInfo depthStencil{};
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+	// after a pre-pass only the front-most fragment of each pixel matches, and the depth is final
+	depthStencil.depthWriteEnable = depthEqual ? VK_FALSE : VK_TRUE;
+	depthStencil.depthCompareOp = depthEqual ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
 	depthStencil.depthBoundsTestEnable = VK_FALSE;
 	depthStencil.minDepthBounds = 0.0f; // Optional
 	depthStencil.maxDepthBounds = 1.0f; // Optional
@@ -740,238 +1705,1041 @@ void Application::create_pipeline() {
 	depthStencil.front = {}; // Optional
 	depthStencil.back = {}; // Optional
 
-	VkGraphicsPipelineCreateInfo pipelineInfo{};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = &depthStencil; // Optional
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = nullptr; // Optional
+	// without a render pass the pipeline is only told the attachment formats
+	auto target = _render_graph.target(depthOnly ? _depth_prepass_pass : _main_pass);
+	VkPipelineRenderingCreateInfo renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	renderingInfo.colorAttachmentCount = static_cast<uint32_t>(target.color_formats.size());
+	renderingInfo.pColorAttachmentFormats = target.color_formats.data();
+	renderingInfo.depthAttachmentFormat = target.depth_format;
+	renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = target.render_pass == VK_NULL_HANDLE ? &renderingInfo : nullptr;
+	pipelineInfo.stageCount = depthOnly ? 1 : 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil; // Optional
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+
+	pipelineInfo.layout = _pipeline_layout;
+	pipelineInfo.renderPass = target.render_pass;
+	pipelineInfo.subpass = 0;
+
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+	pipelineInfo.basePipelineIndex = -1; // Optional
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(_device, cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	    throw std::runtime_error("failed to create graphics pipeline!");
+	}
+
+    if (fragShaderModule != VK_NULL_HANDLE) {
+    	vkDestroyShaderModule(_device, fragShaderModule, nullptr);
+    }
+    vkDestroyShaderModule(_device, vertShaderModule, nullptr);
+
+    return pipeline;
+}
+
+void Application::create_pipeline_layout() {
+	std::array<VkDescriptorSetLayout, 2> setLayouts = {_descriptor_layout, _texture_descriptor_layout};
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(DrawPushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_pipeline_layout) != VK_SUCCESS) {
+	    throw std::runtime_error("failed to create pipeline layout!");
+	}
+}
+
+VkShaderModule Application::create_shader_module(std::span<const char> code) {
+	VkShaderModuleCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = code.size();
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(_device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+    	throw std::runtime_error("failed to create shader module!");
+	}
+
+	return shaderModule;
+}
+
+std::vector<char> Application::read_file(const std::string& filename) {
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+
+    size_t fileSize = (size_t) file.tellg();
+	std::vector<char> buffer(fileSize);
+
+	file.seekg(0);
+	file.read(buffer.data(), fileSize);
+
+	file.close();
+
+	return buffer;
+}
+
+void Application::create_command_pool() {
+	auto index = find_queue_family(_physical_device, VK_QUEUE_GRAPHICS_BIT);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = index.value();
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if (vkCreateCommandPool(_device, &poolInfo, nullptr, &_command_pool) != VK_SUCCESS) {
+	    throw std::runtime_error("failed to create command pool!");
+	}
+}
+
+void Application::create_command_buffers() {
+	_command_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = _command_pool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = (uint32_t) _command_buffers.size();
+
+	if (vkAllocateCommandBuffers(_device, &allocInfo, _command_buffers.data()) != VK_SUCCESS) {
+	    throw std::runtime_error("failed to allocate command buffers!");
+	}
+}
+
+void Application::record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index) {
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = nullptr; // Optional
+
+    if (vkBeginCommandBuffer(command_buffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+	if (_statistics_query_pool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(command_buffer, _statistics_query_pool, _current_frame, 1);
+		_statistics_recorded[_current_frame] = true;
+	}
+	if (_timestamp_query_pool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(command_buffer, _timestamp_query_pool, _current_frame * 2, 2);
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _timestamp_query_pool, _current_frame * 2);
+		_timestamps_recorded[_current_frame] = true;
+	}
+
+	// submits the frame's compute passes on their own queue, or records them right here
+	_compute_scheduler.flush(_current_frame, command_buffer);
+
+	// frames of another size than the stream, after a resize, are not captured
+	_capture_slot.reset();
+	if (_frame_capture.is_open() && _frame_capture.extent().width == _swap_chain_extent.width
+		&& _frame_capture.extent().height == _swap_chain_extent.height) {
+		_capture_slot = _frame_capture.acquire(_in_flight_fences[_current_frame]);
+	}
+
+	_render_graph.bind_image(_backbuffer, _swap_chain_images[image_index], _swap_chain_image_views[image_index]);
+	_render_graph.execute(command_buffer);
+
+	if (_timestamp_query_pool != VK_NULL_HANDLE) {
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _timestamp_query_pool, _current_frame * 2 + 1);
+	}
+
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+	    throw std::runtime_error("failed to record command buffer!");
+	}
+}
+
+void Application::build_render_graph() {
+	auto finalLayout = headless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	_backbuffer = _render_graph.import_image("backbuffer", _swap_chain_format, VK_SAMPLE_COUNT_1_BIT, finalLayout);
+	auto depth = _render_graph.create_image("depth", find_depth_format(), _msaa_samples);
+
+	if (_depth_prepass) {
+		_render_graph.add_pass("depth_prepass")
+			.depth(depth, VK_ATTACHMENT_LOAD_OP_CLEAR)
+			.execute([this](VkCommandBuffer command_buffer) {
+				draw_depth_prepass(command_buffer);
+			});
+	}
+
+	// the multisampled color image only exists with MSAA, and the intermediate one only with FXAA
+	bool fxaa = _anti_aliasing.fxaa && _msaa_samples == VK_SAMPLE_COUNT_1_BIT && fxaa_supported();
+	RenderGraphImage scene = RENDER_GRAPH_NONE;
+
+	auto& main = _render_graph.add_pass("main");
+	if (_msaa_samples != VK_SAMPLE_COUNT_1_BIT) {
+		auto color = _render_graph.create_image("color", _swap_chain_format, _msaa_samples);
+		main.color(color, VK_ATTACHMENT_LOAD_OP_CLEAR, {{0.0f, 0.0f, 0.0f, 1.0f}})
+			.resolve(_backbuffer);
+	} else if (fxaa) {
+		scene = _render_graph.create_image("scene", _swap_chain_format);
+		main.color(scene, VK_ATTACHMENT_LOAD_OP_CLEAR, {{0.0f, 0.0f, 0.0f, 1.0f}});
+	} else {
+		main.color(_backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, {{0.0f, 0.0f, 0.0f, 1.0f}});
+	}
+	if (_depth_prepass) {
+		main.depth(depth, VK_ATTACHMENT_LOAD_OP_LOAD, false);
+	} else {
+		main.depth(depth);
+	}
+	main.execute([this](VkCommandBuffer command_buffer) {
+		if (_statistics_query_pool != VK_NULL_HANDLE) {
+			vkCmdBeginQuery(command_buffer, _statistics_query_pool, _current_frame, 0);
+		}
+		draw_scene(command_buffer);
+		if (_statistics_query_pool != VK_NULL_HANDLE) {
+			vkCmdEndQuery(command_buffer, _statistics_query_pool, _current_frame);
+		}
+	});
+
+	if (fxaa) {
+		// the shader works on linear color; 8 bits of it would band in the dark gradients
+		// once the blit encodes them to sRGB
+		auto antialiased = _render_graph.create_image("fxaa", VK_FORMAT_R16G16B16A16_SFLOAT);
+		_render_graph.add_pass("fxaa")
+			.read(scene, RenderGraphUsage::SAMPLED_COMPUTE)
+			.write(antialiased, RenderGraphUsage::STORAGE_COMPUTE)
+			.execute([this, scene, antialiased](VkCommandBuffer command_buffer) {
+				record_fxaa(command_buffer, scene, antialiased);
+			});
+		_render_graph.add_pass("blit")
+			.read(antialiased, RenderGraphUsage::TRANSFER_SRC)
+			.write(_backbuffer, RenderGraphUsage::TRANSFER_DST)
+			.execute([this, antialiased](VkCommandBuffer command_buffer) {
+				blit_to_backbuffer(command_buffer, antialiased);
+			});
+	}
+
+	if (_frame_capture.is_open()) {
+		// a copy of the frame, in RGBA8 whatever the swap chain format, for the readback
+		auto capture = _render_graph.create_image("capture", capture_format(_swap_chain_format));
+		_render_graph.add_pass("capture_blit")
+			.read(_backbuffer, RenderGraphUsage::TRANSFER_SRC)
+			.write(capture, RenderGraphUsage::TRANSFER_DST)
+			.execute([this, capture](VkCommandBuffer command_buffer) {
+				record_capture_blit(command_buffer, capture);
+			});
+
+		if (_frame_capture.format() == FrameCapture::Format::Y4M) {
+			_render_graph.add_pass("capture_convert")
+				.read(capture, RenderGraphUsage::SAMPLED_COMPUTE)
+				.side_effect()
+				.execute([this, capture](VkCommandBuffer command_buffer) {
+					record_capture_convert(command_buffer, capture);
+				});
+		} else {
+			_render_graph.add_pass("capture_copy")
+				.read(capture, RenderGraphUsage::TRANSFER_SRC)
+				.side_effect()
+				.execute([this, capture](VkCommandBuffer command_buffer) {
+					record_capture_copy(command_buffer, capture);
+				});
+		}
+	}
+
+	if (headless()) {
+		_render_graph.add_pass("readback")
+			.read(_backbuffer, RenderGraphUsage::TRANSFER_SRC)
+			.side_effect()
+			.execute([this](VkCommandBuffer command_buffer) {
+				record_readback(command_buffer);
+			});
+	}
+
+	_render_graph.compile(_swap_chain_extent);
+	_main_pass = _render_graph.find_pass("main");
+	_depth_prepass_pass = _render_graph.find_pass("depth_prepass");
+}
+
+void Application::set_viewport(VkCommandBuffer command_buffer) {
+	auto extent = _render_graph.extent();
+
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float) extent.width;
+	viewport.height = (float) extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.offset = {0, 0};
+	scissor.extent = extent;
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+}
+
+VkDescriptorSet Application::frame_descriptor_set() {
+	return _descriptor_cache.get(_descriptor_layout, {
+		DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, _uniform_buffers[_current_frame], 0, sizeof(UniformBufferObject))
+	});
+}
+
+void Application::draw_scene(VkCommandBuffer command_buffer) {
+	set_viewport(command_buffer);
+
+	std::array<VkDescriptorSet, 2> descriptorSets = {frame_descriptor_set(), _texture_descriptor_set};
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline_layout, 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+
+	VkBuffer vertexBuffers[] = {_vertex_buffer};
+	VkDeviceSize offsets[] = {0};
+	vkCmdBindVertexBuffers(command_buffer, 0, 1, vertexBuffers, offsets);
+
+	vkCmdBindIndexBuffer(command_buffer, _index_buffer, 0, VK_INDEX_TYPE_UINT32);
+
+	// the list is sorted, each pipeline is bound once for the run of draws using it
+	std::optional<PipelineKey> boundKey;
+	bool skipping = false;
+	for (size_t i = 0; i < _draws.size(); ++i) {
+		const auto& item = _draws[i];
+		const auto& material = _materials[_submeshes[item.submesh].material];
+		auto key = draw_pipeline_key(material);
+		if (boundKey != key) {
+			auto pipeline = get_pipeline(key);
+			skipping = pipeline == VK_NULL_HANDLE;
+			if (!skipping) {
+				vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			}
+			boundKey = key;
+		}
+		// neither the variant nor a matching fallback is compiled yet
+		if (skipping) {
+			continue;
+		}
+
+		DrawPushConstants draw{};
+		draw.model = _scene.world(item.node);
+		draw.material_id = material.texture;
+		vkCmdPushConstants(command_buffer, _pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(draw), &draw);
+
+		// the culling pass wrote this draw, with no instances when it is off screen
+		VkDeviceSize drawOffset = i * sizeof(VkDrawIndexedIndirectCommand);
+		vkCmdDrawIndexedIndirect(command_buffer, _cull_draw_buffers[_current_frame], drawOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+
+void Application::draw_depth_prepass(VkCommandBuffer command_buffer) {
+	set_viewport(command_buffer);
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, get_pipeline(PIPELINE_FEATURE_DEPTH_ONLY));
+
+	// the depth only vertex shader reads the camera, not the textures
+	auto frameSet = frame_descriptor_set();
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline_layout, 0, 1, &frameSet, 0, nullptr);
+
+	VkBuffer vertexBuffers[] = {_position_buffer};
+	VkDeviceSize offsets[] = {0};
+	vkCmdBindVertexBuffers(command_buffer, 0, 1, vertexBuffers, offsets);
+
+	vkCmdBindIndexBuffer(command_buffer, _index_buffer, 0, VK_INDEX_TYPE_UINT32);
+
+	for (size_t i = 0; i < _draws.size(); ++i) {
+		const auto& item = _draws[i];
+		const auto& material = _materials[_submeshes[item.submesh].material];
+		// without the fragment shader nothing is cut out, these lay down their depth in the main pass
+		if (material.features & PIPELINE_FEATURE_ALPHA_TEST) {
+			continue;
+		}
+
+		DrawPushConstants draw{};
+		draw.model = _scene.world(item.node);
+		draw.material_id = material.texture;
+		vkCmdPushConstants(command_buffer, _pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(draw), &draw);
+
+		// the culling pass wrote this draw, with no instances when it is off screen
+		VkDeviceSize drawOffset = i * sizeof(VkDrawIndexedIndirectCommand);
+		vkCmdDrawIndexedIndirect(command_buffer, _cull_draw_buffers[_current_frame], drawOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+
+void Application::build_scene() {
+	_scene.clear();
+	_scene_drawables.clear();
+
+	// copies are stacked away from the camera and drawn back to front, the worst case for
+	// overdraw; each copy's placement is the parent of the spinning model
+	for (uint32_t i = _overdraw_layers; i-- > 0; ) {
+		auto offset = glm::vec3(-0.15f, -0.15f, 0.0f) * static_cast<float>(i);
+		auto placement = _scene.add_node(SCENE_NODE_NONE, glm::translate(glm::mat4(1.0f), offset));
+		_scene_drawables.push_back(_scene.add_node(placement));
+	}
+	build_draw_list();
+	reserve_cull_buffers();
+}
+
+void Application::build_draw_list() {
+	_draws.clear();
+	for (auto node : _scene_drawables) {
+		for (uint32_t submesh = 0; submesh < _submeshes.size(); ++submesh) {
+			_draws.push_back({node, submesh});
+		}
+	}
+
+	// grouped by pipeline features, then by texture; stable, so within a group the
+	// nodes keep their order, back to front for the overdraw measurement
+	std::stable_sort(_draws.begin(), _draws.end(), [this](const DrawItem& a, const DrawItem& b) {
+		const auto& materialA = _materials[_submeshes[a.submesh].material];
+		const auto& materialB = _materials[_submeshes[b.submesh].material];
+		return std::tie(materialA.features, materialA.texture) < std::tie(materialB.features, materialB.texture);
+	});
+}
+
+void Application::create_post_process_resources() {
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+	if (vkCreateSampler(_device, &samplerInfo, nullptr, &_post_process_sampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create post process sampler!");
+	}
+
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_fxaa_descriptor_layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+
+	// graph images change with every rebuild, so their sets are written per frame
+	for (auto& allocator : _frame_descriptor_allocators) {
+		allocator.register_layout(_fxaa_descriptor_layout, bindings.data(), static_cast<uint32_t>(bindings.size()));
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &_fxaa_descriptor_layout;
+
+	if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_fxaa_pipeline_layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+
+	_fxaa_pipeline = create_fxaa_pipeline();
+}
+
+VkPipeline Application::create_fxaa_pipeline() {
+	VkShaderModule shaderModule = create_shader_module(_blob_cache.load("fxaa.comp.spv")->span());
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = _fxaa_pipeline_layout;
+
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(_device, _pipeline_compiler.cache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create compute pipeline!");
+	}
+
+	vkDestroyShaderModule(_device, shaderModule, nullptr);
+	return pipeline;
+}
+
+void Application::record_fxaa(VkCommandBuffer command_buffer, RenderGraphImage input, RenderGraphImage output) {
+	auto set = allocate_transient_descriptor_set(_fxaa_descriptor_layout);
+
+	VkDescriptorImageInfo inputInfo{};
+	inputInfo.sampler = _post_process_sampler;
+	inputInfo.imageView = _render_graph.image_view(input);
+	inputInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorImageInfo outputInfo{};
+	outputInfo.imageView = _render_graph.image_view(output);
+	outputInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	std::array<VkWriteDescriptorSet, 2> writes{};
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet = set;
+	writes[0].dstBinding = 0;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writes[0].descriptorCount = 1;
+	writes[0].pImageInfo = &inputInfo;
+	writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[1].dstSet = set;
+	writes[1].dstBinding = 1;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	writes[1].descriptorCount = 1;
+	writes[1].pImageInfo = &outputInfo;
+	vkUpdateDescriptorSets(_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _fxaa_pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _fxaa_pipeline_layout, 0, 1, &set, 0, nullptr);
+
+	auto extent = _render_graph.extent();
+	vkCmdDispatch(command_buffer, (extent.width + 7) / 8, (extent.height + 7) / 8, 1);
+}
+
+void Application::blit_to_backbuffer(VkCommandBuffer command_buffer, RenderGraphImage source) {
+	auto extent = _render_graph.extent();
+
+	VkImageBlit blit{};
+	blit.srcOffsets[0] = {0, 0, 0};
+	blit.srcOffsets[1] = {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1};
+	blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.srcSubresource.mipLevel = 0;
+	blit.srcSubresource.baseArrayLayer = 0;
+	blit.srcSubresource.layerCount = 1;
+	blit.dstOffsets[0] = {0, 0, 0};
+	blit.dstOffsets[1] = {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1};
+	blit.dstSubresource = blit.srcSubresource;
+
+	// a blit rather than a copy, since it converts to the swap chain's format and color space
+	vkCmdBlitImage(command_buffer,
+		_render_graph.image(source), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		_render_graph.image(_backbuffer), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1, &blit,
+		VK_FILTER_NEAREST);
+}
+
+bool Application::capture_supported() {
+	// the frame is blitted out of the swap chain image, which needs to allow it
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(_physical_device, _swap_chain_format, &props);
+	return (_swap_chain_usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+		&& (props.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
+}
+
+void Application::open_capture() {
+	if (_capture_path.empty()) {
+		return;
+	}
+	// a batch writes its images as PNGs
+	if (headless()) {
+		std::cerr << "frame capture is not available in batch mode" << std::endl;
+		return;
+	}
+	if (!capture_supported()) {
+		throw std::runtime_error("failed to capture frames, the swap chain images can not be copied!");
+	}
+
+	_frame_capture.open(_physical_device, _device, _capture_path, _swap_chain_extent);
+	std::cerr << "capturing " << _swap_chain_extent.width << "x" << _swap_chain_extent.height
+		<< (_frame_capture.format() == FrameCapture::Format::Y4M ? " Y4M" : " raw RGBA") << " to " << _capture_path << std::endl;
+}
+
+void Application::create_capture_resources() {
+	// the raw stream is a plain copy, only Y4M converts on the GPU
+	if (!_frame_capture.is_open() || _frame_capture.format() != FrameCapture::Format::Y4M) {
+		return;
+	}
+
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_capture_descriptor_layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+
+	// the capture image changes with every graph rebuild and the buffer with every frame
+	for (auto& allocator : _frame_descriptor_allocators) {
+		allocator.register_layout(_capture_descriptor_layout, bindings.data(), static_cast<uint32_t>(bindings.size()));
+	}
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(CapturePushConstants);
 
-	pipelineInfo.layout = _pipeline_layout;
-	pipelineInfo.renderPass = _render_pass;
-	pipelineInfo.subpass = 0;
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &_capture_descriptor_layout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-	pipelineInfo.basePipelineIndex = -1; // Optional
+	if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_capture_pipeline_layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
 
-	if (vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_pipeline) != VK_SUCCESS) {
-	    throw std::runtime_error("failed to create graphics pipeline!");
+	_capture_pipeline = create_capture_pipeline();
+}
+
+VkPipeline Application::create_capture_pipeline() {
+	VkShaderModule shaderModule = create_shader_module(_blob_cache.load("capture_yuv.comp.spv")->span());
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = _capture_pipeline_layout;
+
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(_device, _pipeline_compiler.cache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create compute pipeline!");
 	}
 
-    vkDestroyShaderModule(_device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(_device, vertShaderModule, nullptr);
+	vkDestroyShaderModule(_device, shaderModule, nullptr);
+	return pipeline;
 }
 
-void Application::create_render_pass() {
-	VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = _swap_chain_format;
-    colorAttachment.samples = _msaa_samples;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkAttachmentDescription depthAttachment{};
-	depthAttachment.format = find_depth_format();
-	depthAttachment.samples = _msaa_samples;
-	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	VkAttachmentDescription colorAttachmentResolve{};
-    colorAttachmentResolve.format = _swap_chain_format;
-    colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	VkAttachmentReference colorAttachmentRef{};
-	colorAttachmentRef.attachment = 0;
-	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkAttachmentReference depthAttachmentRef{};
-	depthAttachmentRef.attachment = 1;
-	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	VkAttachmentReference colorAttachmentResolveRef{};
-    colorAttachmentResolveRef.attachment = 2;
-    colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpass{};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorAttachmentRef;
-	subpass.pDepthStencilAttachment = &depthAttachmentRef;
-	subpass.pResolveAttachments = &colorAttachmentResolveRef;
-
-	VkSubpassDependency dependency{};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-	std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
-	VkRenderPassCreateInfo renderPassInfo{};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = attachments.size();
-	renderPassInfo.pAttachments = attachments.data();
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
-
-	if (vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_render_pass) != VK_SUCCESS) {
-	    throw std::runtime_error("failed to create render pass!");
-	}
-}
-
-VkShaderModule Application::create_shader_module(const std::vector<char>& code) {
-	VkShaderModuleCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+void Application::record_capture_blit(VkCommandBuffer command_buffer, RenderGraphImage capture) {
+	// without a readback buffer the frame is dropped, the passes only keep their barriers
+	if (!_capture_slot) {
+		return;
+	}
 
-	VkShaderModule shaderModule;
-	if (vkCreateShaderModule(_device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-    	throw std::runtime_error("failed to create shader module!");
+	auto extent = _render_graph.extent();
+
+	VkImageBlit blit{};
+	blit.srcOffsets[0] = {0, 0, 0};
+	blit.srcOffsets[1] = {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1};
+	blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.srcSubresource.mipLevel = 0;
+	blit.srcSubresource.baseArrayLayer = 0;
+	blit.srcSubresource.layerCount = 1;
+	blit.dstOffsets[0] = {0, 0, 0};
+	blit.dstOffsets[1] = {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1};
+	blit.dstSubresource = blit.srcSubresource;
+
+	// a blit swizzles BGRA swap chains into the RGBA order of the stream
+	vkCmdBlitImage(command_buffer,
+		_render_graph.image(_backbuffer), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		_render_graph.image(capture), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1, &blit,
+		VK_FILTER_NEAREST);
+}
+
+void Application::record_capture_copy(VkCommandBuffer command_buffer, RenderGraphImage capture) {
+	if (!_capture_slot) {
+		return;
 	}
 
-	return shaderModule;
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {_frame_capture.extent().width, _frame_capture.extent().height, 1};
+
+	vkCmdCopyImageToBuffer(command_buffer, _render_graph.image(capture), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		_frame_capture.buffer(*_capture_slot), 1, &region);
+	record_capture_barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
 }
 
-std::vector<char> Application::read_file(const std::string& filename) {
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+void Application::record_capture_convert(VkCommandBuffer command_buffer, RenderGraphImage capture) {
+	if (!_capture_slot) {
+		return;
+	}
 
-    if (!file.is_open()) {
-        throw std::runtime_error("failed to open file!");
-    }
+	auto set = allocate_transient_descriptor_set(_capture_descriptor_layout);
+
+	VkDescriptorImageInfo inputInfo{};
+	inputInfo.sampler = _post_process_sampler;
+	inputInfo.imageView = _render_graph.image_view(capture);
+	inputInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorBufferInfo outputInfo{};
+	outputInfo.buffer = _frame_capture.buffer(*_capture_slot);
+	outputInfo.offset = 0;
+	outputInfo.range = _frame_capture.buffer_size();
+
+	std::array<VkWriteDescriptorSet, 2> writes{};
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet = set;
+	writes[0].dstBinding = 0;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writes[0].descriptorCount = 1;
+	writes[0].pImageInfo = &inputInfo;
+	writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[1].dstSet = set;
+	writes[1].dstBinding = 1;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writes[1].descriptorCount = 1;
+	writes[1].pBufferInfo = &outputInfo;
+	vkUpdateDescriptorSets(_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	CapturePushConstants params{};
+	params.width = _frame_capture.extent().width;
+	params.height = _frame_capture.extent().height;
+	params.plane_words = static_cast<uint32_t>(_frame_capture.plane_stride() / 4);
+	params.encode_srgb = capture_format(_swap_chain_format) == VK_FORMAT_R8G8B8A8_SRGB ? 1 : 0;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _capture_pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _capture_pipeline_layout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(command_buffer, _capture_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+	vkCmdDispatch(command_buffer, (params.plane_words + 63) / 64, 1, 1);
+
+	record_capture_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void Application::record_capture_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access) {
+	// makes the frame visible to the writer once poll() sees the fence signalled
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = _frame_capture.buffer(*_capture_slot);
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(command_buffer,
+		src_stage, VK_PIPELINE_STAGE_HOST_BIT,
+		0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+}
+
+void Application::create_cull_resources() {
+	// world matrices, draws, and the nodes drawn
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); ++i) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
 
-    size_t fileSize = (size_t) file.tellg();
-	std::vector<char> buffer(fileSize);
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
 
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
+	if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_cull_descriptor_layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+	// the buffers never change, so the per frame sets are cached
+	_descriptor_allocator.register_layout(_cull_descriptor_layout, bindings.data(), static_cast<uint32_t>(bindings.size()));
 
-	file.close();
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(CullPushConstants);
 
-	return std::move(buffer);
-}
-
-void Application::create_framebuffers() {
-	_swap_chain_framebuffers.resize(_swap_chain_image_views.size());
-	for (size_t i = 0; i < _swap_chain_image_views.size(); i++) {
-		std::array<VkImageView, 3> attachments = {
-			_color_image_view,
-			_depth_image_view,
-	        _swap_chain_image_views[i]
-	    };
-
-	    VkFramebufferCreateInfo framebufferInfo{};
-	    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-	    framebufferInfo.renderPass = _render_pass;
-	    framebufferInfo.attachmentCount = attachments.size();
-	    framebufferInfo.pAttachments = attachments.data();
-	    framebufferInfo.width = _swap_chain_extent.width;
-	    framebufferInfo.height = _swap_chain_extent.height;
-	    framebufferInfo.layers = 1;
-
-	    if (vkCreateFramebuffer(_device, &framebufferInfo, nullptr, &_swap_chain_framebuffers[i]) != VK_SUCCESS) {
-	        throw std::runtime_error("failed to create framebuffer!");
-	    }
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &_cull_descriptor_layout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_cull_pipeline_layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout!");
 	}
+
+	_cull_pipeline = create_cull_pipeline();
+	create_cull_buffers(MIN_CULL_NODES, MIN_CULL_INSTANCES);
 }
 
-void Application::create_command_pool() {
-	auto index = find_queue_family(_physical_device, VK_QUEUE_GRAPHICS_BIT);
+void Application::create_cull_buffers(uint32_t node_capacity, uint32_t instance_capacity) {
+	_cull_node_capacity = node_capacity;
+	_cull_instance_capacity = instance_capacity;
 
-	VkCommandPoolCreateInfo poolInfo{};
-	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	poolInfo.queueFamilyIndex = index.value();
-	poolInfo.flags = 0; // Optional
+	_cull_instance_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+	_cull_instance_buffers_memory.resize(MAX_FRAMES_IN_FLIGHT);
+	_cull_instance_buffers_mapped.resize(MAX_FRAMES_IN_FLIGHT);
+	_cull_draw_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+	_cull_draw_buffers_memory.resize(MAX_FRAMES_IN_FLIGHT);
 
-	if (vkCreateCommandPool(_device, &poolInfo, nullptr, &_command_pool) != VK_SUCCESS) {
-	    throw std::runtime_error("failed to create command pool!");
+	VkDeviceSize instanceSize = cull_instances_offset() + instance_capacity * sizeof(CullInstance);
+	VkDeviceSize drawSize = instance_capacity * sizeof(VkDrawIndexedIndirectCommand);
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		// only the compute passes read the instances, the draws are read by graphics too
+		create_buffer(instanceSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			_cull_instance_buffers[i],
+			_cull_instance_buffers_memory[i]);
+		vkMapMemory(_device, _cull_instance_buffers_memory[i], 0, instanceSize, 0, &_cull_instance_buffers_mapped[i]);
+
+		create_buffer(drawSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			_cull_draw_buffers[i],
+			_cull_draw_buffers_memory[i],
+			_compute_scheduler.queue_families());
 	}
 }
 
-void Application::create_command_buffers() {
-	_command_buffers.resize(_swap_chain_framebuffers.size());
+void Application::destroy_cull_buffers() {
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		vkDestroyBuffer(_device, _cull_instance_buffers[i], nullptr);
+		vkFreeMemory(_device, _cull_instance_buffers_memory[i], nullptr);
+		vkDestroyBuffer(_device, _cull_draw_buffers[i], nullptr);
+		vkFreeMemory(_device, _cull_draw_buffers_memory[i], nullptr);
+	}
+}
 
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = _command_pool;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = (uint32_t) _command_buffers.size();
+void Application::reserve_cull_buffers() {
+	uint32_t nodeCapacity = _cull_node_capacity;
+	uint32_t instanceCapacity = _cull_instance_capacity;
+	while (nodeCapacity < _scene.size()) {
+		nodeCapacity *= 2;
+	}
+	while (instanceCapacity < _draws.size()) {
+		instanceCapacity *= 2;
+	}
+	if (nodeCapacity == _cull_node_capacity && instanceCapacity == _cull_instance_capacity) {
+		return;
+	}
 
-	if (vkAllocateCommandBuffers(_device, &allocInfo, _command_buffers.data()) != VK_SUCCESS) {
-	    throw std::runtime_error("failed to allocate command buffers!");
+	// every frame slot uses the buffers; scenes only grow on load and when the benchmark
+	// adds layers, so waiting for the device is fine
+	vkDeviceWaitIdle(_device);
+	destroy_cull_buffers();
+	// a new buffer may reuse an old handle, the sets cached for the old ones must go
+	_descriptor_cache.forget(_cull_descriptor_layout);
+	create_cull_buffers(nodeCapacity, instanceCapacity);
+}
+
+VkPipeline Application::create_cull_pipeline() {
+	VkShaderModule shaderModule = create_shader_module(_blob_cache.load("cull.comp.spv")->span());
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = _cull_pipeline_layout;
+
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(_device, _pipeline_compiler.cache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create compute pipeline!");
 	}
 
-	for (size_t i = 0; i < _command_buffers.size(); i++) {
-	    VkCommandBufferBeginInfo beginInfo{};
-	    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	    beginInfo.flags = 0; // Optional
-	    beginInfo.pInheritanceInfo = nullptr; // Optional
+	vkDestroyShaderModule(_device, shaderModule, nullptr);
+	return pipeline;
+}
+
+void Application::schedule_culling() {
+	// the fence of this frame slot was waited on, so the GPU is done reading the old ones;
+	// the world matrices go up in one copy, the shader applies the view projection
+	auto mapped = static_cast<char*>(_cull_instance_buffers_mapped[_current_frame]);
+	auto worlds = _scene.world_matrices();
+	memcpy(mapped, worlds.data(), worlds.size_bytes());
+	auto instances = reinterpret_cast<CullInstance*>(mapped + cull_instances_offset());
+	for (size_t i = 0; i < _draws.size(); ++i) {
+		const auto& submesh = _submeshes[_draws[i].submesh];
+		CullInstance instance{};
+		instance.bounds_min = glm::vec4(submesh.bounds_min, 1.0f);
+		instance.bounds_max = glm::vec4(submesh.bounds_max, 1.0f);
+		instance.node = _scene.index(_draws[i].node);
+		instance.first_index = submesh.first_index;
+		instance.index_count = submesh.index_count;
+		instances[i] = instance;
+	}
 
-	    if (vkBeginCommandBuffer(_command_buffers[i], &beginInfo) != VK_SUCCESS) {
-	        throw std::runtime_error("failed to begin recording command buffer!");
-	    }
+	CullPushConstants params{};
+	params.view_proj = _view_proj;
+	params.instance_count = static_cast<uint32_t>(_draws.size());
+
+	auto set = _descriptor_cache.get(_cull_descriptor_layout, {
+		DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _cull_instance_buffers[_current_frame], 0, cull_instances_offset()),
+		DescriptorBinding::buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _cull_draw_buffers[_current_frame], 0, VK_WHOLE_SIZE),
+		DescriptorBinding::buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _cull_instance_buffers[_current_frame], cull_instances_offset(), VK_WHOLE_SIZE)
+	});
+
+	_compute_scheduler.schedule("cull", VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+		[this, set, params](VkCommandBuffer command_buffer) {
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cull_pipeline);
+			vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cull_pipeline_layout, 0, 1, &set, 0, nullptr);
+			vkCmdPushConstants(command_buffer, _cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+			vkCmdDispatch(command_buffer, (params.instance_count + 63) / 64, 1, 1);
+		});
+}
+
+void Application::create_statistics_query_pool() {
+	_statistics_recorded.assign(MAX_FRAMES_IN_FLIGHT, false);
+	if (!_pipeline_statistics_supported) {
+		if (_prepass_benchmark) {
+			throw std::runtime_error("pipeline statistics queries not supported, cannot run the pre-pass benchmark!");
+		}
+		return;
+	}
 
-	    VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = _render_pass;
-		renderPassInfo.framebuffer = _swap_chain_framebuffers[i];
+	VkQueryPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	poolInfo.queryCount = MAX_FRAMES_IN_FLIGHT;
+	poolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
 
-		renderPassInfo.renderArea.offset = {0, 0};
-		renderPassInfo.renderArea.extent = _swap_chain_extent;
+	if (vkCreateQueryPool(_device, &poolInfo, nullptr, &_statistics_query_pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create query pool!");
+	}
+}
 
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
-		clearValues[1].depthStencil = {1.0f, 0};
+void Application::collect_pipeline_statistics(uint32_t current_frame) {
+	if (_statistics_query_pool == VK_NULL_HANDLE || !_statistics_recorded[current_frame]) {
+		return;
+	}
 
-		renderPassInfo.clearValueCount = clearValues.size();
-		renderPassInfo.pClearValues = clearValues.data();
+	// the frame's fence has signaled, so the result is available without waiting
+	uint64_t invocations = 0;
+	if (vkGetQueryPoolResults(_device, _statistics_query_pool, current_frame, 1, sizeof(invocations), &invocations, sizeof(invocations), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+		_fragment_invocations += invocations;
+		++_statistics_frames;
+	}
+	_statistics_recorded[current_frame] = false;
+}
 
-		vkCmdBeginRenderPass(_command_buffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline);
+void Application::create_timestamp_query_pool() {
+	_timestamps_recorded.assign(MAX_FRAMES_IN_FLIGHT, false);
 
-		vkCmdBindDescriptorSets(_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline_layout, 0, 1, &_descriptor_sets[i], 0, nullptr);
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(_physical_device, &properties);
+	auto graphicsFamily = find_queue_family(_physical_device, VK_QUEUE_GRAPHICS_BIT);
+	uint32_t validBits = queue_families(_physical_device)[graphicsFamily.value()].timestampValidBits;
+	// only the limiter uses them, it then goes by the CPU time alone
+	if (validBits == 0 || properties.limits.timestampPeriod == 0.0f) {
+		return;
+	}
+	_timestamp_period_ns = properties.limits.timestampPeriod;
+	_timestamp_mask = validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
 
-		VkBuffer vertexBuffers[] = {_vertex_buffer};
-		VkDeviceSize offsets[] = {0};
-		vkCmdBindVertexBuffers(_command_buffers[i], 0, 1, vertexBuffers, offsets);
+	VkQueryPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 2;
 
-		vkCmdBindIndexBuffer(_command_buffers[i], _index_buffer, 0, VK_INDEX_TYPE_UINT32);
+	if (vkCreateQueryPool(_device, &poolInfo, nullptr, &_timestamp_query_pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timestamp query pool!");
+	}
+}
 
-		vkCmdDrawIndexed(_command_buffers[i], static_cast<uint32_t>(_indices.size()), 1, 0, 0, 0);
+void Application::collect_gpu_time(uint32_t current_frame) {
+	if (_timestamp_query_pool == VK_NULL_HANDLE || !_timestamps_recorded[current_frame]) {
+		return;
+	}
 
-		vkCmdEndRenderPass(_command_buffers[i]);
-		if (vkEndCommandBuffer(_command_buffers[i]) != VK_SUCCESS) {
-		    throw std::runtime_error("failed to record command buffer!");
-		}
+	// the frame's fence has signaled, so the results are available without waiting
+	uint64_t timestamps[2];
+	if (vkGetQueryPoolResults(_device, _timestamp_query_pool, current_frame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+		uint64_t ticks = (timestamps[1] - timestamps[0]) & _timestamp_mask;
+		_frame_limiter.record_gpu_time(ticks * _timestamp_period_ns / 1e6);
+	}
+	_timestamps_recorded[current_frame] = false;
+}
+
+void Application::configure_frame_limiter() {
+	double fps = 0.0;
+	if (_present_policy.target_fps) {
+		fps = *_present_policy.target_fps;
+	} else if (_present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR || _present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
+		// nothing else would stop these from rendering frames that are never shown
+		const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+		fps = videoMode != nullptr && videoMode->refreshRate > 0 ? videoMode->refreshRate : 60.0;
+	}
+	_frame_limiter.set_target(fps, _present_policy.just_in_time);
+
+	std::cout << "present mode " << PresentPolicy::mode_name(_present_mode);
+	if (_frame_limiter.target_fps() > 0.0) {
+		std::cout << ", limited to " << _frame_limiter.target_fps() << " fps" << (_frame_limiter.just_in_time() ? " just in time" : "");
+	} else if (_present_policy.just_in_time) {
+		std::cout << ", just in time needs a frame rate limit";
+	}
+	std::cout << std::endl;
+}
+
+void Application::step_prepass_benchmark() {
+	static const uint64_t BENCHMARK_FRAMES = 300;
+	static const uint32_t BENCHMARK_OVERDRAW_LAYERS = 16;
+
+	if (_benchmark_phase == 0) {
+		_overdraw_layers = BENCHMARK_OVERDRAW_LAYERS;
+		build_scene();
+		_depth_prepass = false;
+		_render_graph_dirty = true;
+		_fragment_invocations = 0;
+		_statistics_frames = 0;
+		_benchmark_start = std::chrono::steady_clock::now();
+		_benchmark_phase = 1;
+		return;
+	}
+
+	if (_statistics_frames < BENCHMARK_FRAMES) {
+		return;
 	}
+
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _benchmark_start).count();
+	auto invocations = _fragment_invocations / _statistics_frames;
+	std::cout << "depth pre-pass " << (_depth_prepass ? "on " : "off") << ": "
+		<< invocations << " fragment shader invocations per frame, "
+		<< elapsed / _statistics_frames << " ms per frame" << std::endl;
+
+	if (_benchmark_phase == 1) {
+		_benchmark_baseline = invocations;
+		_depth_prepass = true;
+		_render_graph_dirty = true;
+		_fragment_invocations = 0;
+		_statistics_frames = 0;
+		_benchmark_start = std::chrono::steady_clock::now();
+		_benchmark_phase = 2;
+		return;
+	}
+
+	if (_benchmark_baseline > 0) {
+		std::cout << "depth pre-pass saved " << 100.0 * (1.0 - double(invocations) / double(_benchmark_baseline))
+			<< "% of fragment shader invocations at " << _overdraw_layers << "x overdraw" << std::endl;
+	}
+	glfwSetWindowShouldClose(_window, GLFW_TRUE);
 }
 
 void Application::create_sync_objects() {
-	_image_available_semaphores.resize(_swap_chain_images.size());
-	_render_finished_semaphores.resize(_swap_chain_images.size());
-	_in_flight_fences.resize(_swap_chain_images.size());
+	_image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	_render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	_in_flight_fences.resize(MAX_FRAMES_IN_FLIGHT);
 	_in_flight_image_fences.resize(_swap_chain_images.size(), VK_NULL_HANDLE);
 
 	VkSemaphoreCreateInfo semaphoreInfo{};
@@ -981,7 +2749,7 @@ void Application::create_sync_objects() {
     fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    for (size_t i=0; i<_swap_chain_images.size(); ++i) {
+    for (size_t i=0; i<MAX_FRAMES_IN_FLIGHT; ++i) {
     	if (vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &_image_available_semaphores[i]) != VK_SUCCESS
     		|| vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &_render_finished_semaphores[i]) != VK_SUCCESS
     		|| vkCreateFence(_device, &fenceInfo, nullptr, &_in_flight_fences[i]) != VK_SUCCESS) {
@@ -991,60 +2759,63 @@ void Application::create_sync_objects() {
 }
 
 void Application::cleanup_swap_chain() {
-	for (auto framebuffer : _swap_chain_framebuffers) {
-        vkDestroyFramebuffer(_device, framebuffer, nullptr);
-    }
-
-    vkDestroyImageView(_device, _depth_image_view, nullptr);
-    vkDestroyImage(_device, _depth_image, nullptr);
-    vkFreeMemory(_device, _depth_image_memory, nullptr);
-
-    vkDestroyImageView(_device, _color_image_view, nullptr);
-    vkDestroyImage(_device, _color_image, nullptr);
-    vkFreeMemory(_device, _color_image_memory, nullptr);
-
-    vkFreeCommandBuffers(_device, _command_pool, static_cast<uint32_t>(_command_buffers.size()), _command_buffers.data());
-    
-    vkDestroyDescriptorPool(_device, _descriptor_pool, nullptr);
-
-    for (size_t i = 0; i < _swap_chain_images.size(); i++) {
-        vkDestroyBuffer(_device, _uniform_buffers[i], nullptr);
-        vkFreeMemory(_device, _uniform_buffers_memory[i], nullptr);
-    }
-
-	vkDestroyPipeline(_device, _pipeline, nullptr);
-	vkDestroyPipelineLayout(_device, _pipeline_layout, nullptr);
-	vkDestroyDescriptorSetLayout(_device, _descriptor_layout, nullptr);
-	vkDestroyRenderPass(_device, _render_pass, nullptr);
+	_render_graph.reset();
 	for (auto imageView : _swap_chain_image_views) {
         vkDestroyImageView(_device, imageView, nullptr);
     }
-	vkDestroySwapchainKHR(_device, _swap_chain, nullptr);
+
+	if (headless()) {
+		for (size_t i = 0; i < _swap_chain_images.size(); i++) {
+			vkDestroyImage(_device, _swap_chain_images[i], nullptr);
+			vkFreeMemory(_device, _offscreen_image_memory[i], nullptr);
+			vkDestroyBuffer(_device, _readback_buffers[i], nullptr);
+			vkFreeMemory(_device, _readback_buffers_memory[i], nullptr);
+		}
+		_offscreen_image_memory.clear();
+		_readback_buffers.clear();
+		_readback_buffers_memory.clear();
+		_readback_buffers_mapped.clear();
+	} else {
+		vkDestroySwapchainKHR(_device, _swap_chain, nullptr);
+	}
+	_swap_chain_images.clear();
+	_swap_chain_image_views.clear();
 }
 
 void Application::recreate_swap_chain() {
-	int width = 0, height = 0;
-    glfwGetFramebufferSize(_window, &width, &height);
-    while (width == 0 || height == 0) {
-        glfwGetFramebufferSize(_window, &width, &height);
-        glfwWaitEvents();
-    }
-
+	// sample_input() waits while the window is minimized, no GLFW calls here since
+	// this runs on the render thread when the frames are pipelined
 	vkDeviceWaitIdle(_device);
 
+	// pending compiles read the render graph that is rebuilt below
+	finish_pending_pipelines();
+	auto attachmentFormats = [this]() {
+		auto target = _render_graph.target(_main_pass);
+		return std::pair(target.color_formats, target.depth_format);
+	};
+	auto oldFormats = attachmentFormats();
 	cleanup_swap_chain();
 
-	create_swap_chain();
-	create_image_views();
-	create_render_pass();
-	create_pipeline();
-	create_color_resources();
-	create_depth_resources();
-	create_framebuffers();
-	create_uniform_buffers();
-	create_descriptor_pool();
-	create_descriptor_sets();
-	create_command_buffers();
+	if (headless()) {
+		create_offscreen_targets();
+	} else {
+		create_swap_chain();
+		create_image_views();
+	}
+	build_render_graph();
+
+	// viewport and scissor are dynamic; the variants only bake the attachment formats and
+	// samples, and run in any render pass compatible with the one they were made with
+	if (attachmentFormats() != oldFormats) {
+		auto pipeline_keys = _pipelines.keys();
+		_pipelines.clear(_device);
+		create_pipelines(pipeline_keys);
+	}
+
+	// the image count may change with the new swap chain
+	_in_flight_image_fences.assign(_swap_chain_images.size(), VK_NULL_HANDLE);
+	_swap_chain_stale = false;
+	invalidate(FrameInvalidation::SWAP_CHAIN);
 }
 
 void Application::create_vertex_buffer() {
@@ -1075,6 +2846,39 @@ void Application::create_vertex_buffer() {
     vkFreeMemory(_device, stagingBufferMemory, nullptr);
 }
 
+void Application::create_position_buffer() {
+	std::vector<PositionVertex> positions(_vertices.size());
+	for (size_t i = 0; i < _vertices.size(); ++i) {
+		positions[i].pos = _vertices[i].pos;
+	}
+
+	VkDeviceSize size = sizeof(positions[0]) * positions.size();
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	create_buffer(size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		stagingBuffer,
+		stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(_device, stagingBufferMemory, 0, size, 0, &data);
+	memcpy(data, positions.data(), (size_t)size);
+	vkUnmapMemory(_device, stagingBufferMemory);
+
+	create_buffer(size,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		_position_buffer,
+		_position_buffer_memory);
+
+	copy_buffer(stagingBuffer, _position_buffer, size);
+
+	vkDestroyBuffer(_device, stagingBuffer, nullptr);
+	vkFreeMemory(_device, stagingBufferMemory, nullptr);
+}
+
 void Application::create_index_buffer() {
     VkDeviceSize size = sizeof(_indices[0]) * _indices.size();
 
@@ -1103,10 +2907,17 @@ void Application::create_index_buffer() {
     vkFreeMemory(_device, stagingBufferMemory, nullptr);
 }
 
-uint32_t Application::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) {
+uint32_t Application::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred) {
 	VkPhysicalDeviceMemoryProperties memProperties;
 	vkGetPhysicalDeviceMemoryProperties(_physical_device, &memProperties);
 
+	auto wanted = properties | preferred;
+	for (uint32_t i = 0; preferred != 0 && i < memProperties.memoryTypeCount; i++) {
+	    if ((type_filter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & wanted) == wanted) {
+	        return i;
+	    }
+	}
+
 	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
 	    if ((type_filter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
 	        return i;
@@ -1120,13 +2931,22 @@ void Application::create_buffer(VkDeviceSize size,
 		VkBufferUsageFlags usage, 
 		VkMemoryPropertyFlags properties, 
 		VkBuffer& buffer,
-		VkDeviceMemory& buffer_memory) {
+		VkDeviceMemory& buffer_memory,
+		const std::vector<uint32_t>& queue_families,
+		VkMemoryPropertyFlags preferred_properties) {
 
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = size;
 	bufferInfo.usage = usage;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	// buffers used from more than one queue family skip ownership transfers
+	if (queue_families.size() > 1) {
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queue_families.size());
+		bufferInfo.pQueueFamilyIndices = queue_families.data();
+	} else {
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
 
 	if (vkCreateBuffer(_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to create vertex buffer!");
@@ -1138,7 +2958,7 @@ void Application::create_buffer(VkDeviceSize size,
 	VkMemoryAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = find_memory_type(memRequirements.memoryTypeBits, properties);
+	allocInfo.memoryTypeIndex = find_memory_type(memRequirements.memoryTypeBits, properties, preferred_properties);
 
 	if (vkAllocateMemory(_device, &allocInfo, nullptr, &buffer_memory) != VK_SUCCESS) {
     	throw std::runtime_error("failed to allocate vertex buffer memory!");
@@ -1167,131 +2987,181 @@ void Application::create_descriptor_layout() {
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
 
-    VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-	samplerLayoutBinding.binding = 1;
-	samplerLayoutBinding.descriptorCount = 1;
-	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerLayoutBinding.pImmutableSamplers = nullptr;
-	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
-
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-	layoutInfo.pBindings = bindings.data();
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &uboLayoutBinding;
 
 	if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_descriptor_layout) != VK_SUCCESS) {
 	    throw std::runtime_error("failed to create descriptor set layout!");
 	}
+
+	_descriptor_allocator.register_layout(_descriptor_layout, &uboLayoutBinding, 1);
+	for (auto& allocator : _frame_descriptor_allocators) {
+		allocator.register_layout(_descriptor_layout, &uboLayoutBinding, 1);
+	}
 }
 
-void Application::create_uniform_buffers() {
-	_uniform_buffers.resize(_swap_chain_images.size());
-	_uniform_buffers_memory.resize(_swap_chain_images.size());
+void Application::create_texture_descriptor_layout() {
+	VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
 
-	VkDeviceSize size = sizeof(UniformBufferObject);
-	for (size_t i = 0; i < _swap_chain_images.size(); i++) {
-		create_buffer(size,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			_uniform_buffers[i],
-			_uniform_buffers_memory[i]);
-    }
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &indexingProperties;
+	vkGetPhysicalDeviceProperties2(_physical_device, &properties);
+
+	_max_bindless_textures = std::min({MAX_BINDLESS_TEXTURES,
+		indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+		indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages});
+
+	VkDescriptorSetLayoutBinding texturesBinding{};
+	texturesBinding.binding = 0;
+	texturesBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	texturesBinding.descriptorCount = _max_bindless_textures;
+	texturesBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	texturesBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+		| VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+		| VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+		| VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = 1;
+	bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &texturesBinding;
+
+	if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_texture_descriptor_layout) != VK_SUCCESS) {
+	    throw std::runtime_error("failed to create texture descriptor set layout!");
+	}
+
+	_descriptor_allocator.register_layout(_texture_descriptor_layout, &texturesBinding, 1,
+		VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT, true);
 }
 
-void Application::update_uniform_buffer(uint32_t current_image) {
-	static auto startTime = std::chrono::high_resolution_clock::now();
+void Application::create_texture_descriptor_set() {
+	_texture_descriptor_set = _descriptor_allocator.allocate(_texture_descriptor_layout, _max_bindless_textures);
+}
 
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+void Application::write_texture_descriptor(uint32_t texture_index) {
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = _textures[texture_index].view;
+	imageInfo.sampler = _texture_sampler;
 
-    UniformBufferObject ubo{};
-	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(9.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.proj = glm::perspective(glm::radians(45.0f), _swap_chain_extent.width / (float) _swap_chain_extent.height, 0.1f, 10.0f);
-	ubo.proj[1][1] *= -1;
-	void* data;
-	vkMapMemory(_device, _uniform_buffers_memory[current_image], 0, sizeof(ubo), 0, &data);
-	memcpy(data, &ubo, sizeof(ubo));
-	vkUnmapMemory(_device, _uniform_buffers_memory[current_image]);
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = _texture_descriptor_set;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = texture_index;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	// the slot is not referenced by any pending draw yet, so this is legal while the set is bound
+	vkUpdateDescriptorSets(_device, 1, &descriptorWrite, 0, nullptr);
+}
+
+uint32_t Application::load_texture(const std::string& path) {
+	// decoded straight from the mapped file
+	return load_texture(_blob_cache.load(path)->span());
 }
 
-void Application::create_descriptor_pool() {
-	std::array<VkDescriptorPoolSize, 2> poolSizes{};
-	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(_swap_chain_images.size());
-	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(_swap_chain_images.size());
+uint32_t Application::load_texture(std::span<const char> encoded) {
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(encoded.data()), static_cast<int>(encoded.size()),
+		&texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
 
-	VkDescriptorPoolCreateInfo poolInfo{};
-	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-	poolInfo.pPoolSizes = poolSizes.data();
+	if (!pixels) {
+		throw std::runtime_error("failed to load texture image!");
+	}
+	std::unique_ptr<stbi_uc, void (*)(void*)> ownedPixels(pixels, stbi_image_free);
 
-	poolInfo.maxSets = static_cast<uint32_t>(_swap_chain_images.size());
+	return create_texture(pixels, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+}
 
-	if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptor_pool) != VK_SUCCESS) {
-    	throw std::runtime_error("failed to create descriptor pool!");
+uint32_t Application::create_texture(const uint8_t* rgba, uint32_t width, uint32_t height) {
+	if (_textures.size() >= _max_bindless_textures) {
+		throw std::runtime_error("bindless texture table is full!");
 	}
+
+	Texture texture{};
+	create_texture_image(rgba, width, height, texture);
+	texture.view = create_image_view(texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, texture.mipmap_levels);
+
+	auto index = static_cast<uint32_t>(_textures.size());
+	_textures.push_back(texture);
+	write_texture_descriptor(index);
+
+	return index;
 }
 
-void Application::create_descriptor_sets() {
-	std::vector<VkDescriptorSetLayout> layouts(_swap_chain_images.size(), _descriptor_layout);
-	VkDescriptorSetAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocInfo.descriptorPool = _descriptor_pool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(_swap_chain_images.size());
-	allocInfo.pSetLayouts = layouts.data();
+void Application::create_uniform_buffers() {
+	_uniform_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+	_uniform_buffers_memory.resize(MAX_FRAMES_IN_FLIGHT);
+	_uniform_buffers_mapped.resize(MAX_FRAMES_IN_FLIGHT);
 
-	_descriptor_sets.resize(_swap_chain_images.size());
-	if (vkAllocateDescriptorSets(_device, &allocInfo, _descriptor_sets.data()) != VK_SUCCESS) {
-    	throw std::runtime_error("failed to allocate descriptor sets!");
-	}
+	VkDeviceSize size = sizeof(UniformBufferObject);
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		create_buffer(size,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			_uniform_buffers[i],
+			_uniform_buffers_memory[i]);
 
-	for (size_t i = 0; i < _swap_chain_images.size(); i++) {
-	    VkDescriptorBufferInfo bufferInfo{};
-	    bufferInfo.buffer = _uniform_buffers[i];
-	    bufferInfo.offset = 0;
-	    bufferInfo.range = sizeof(UniformBufferObject);
+		// stays mapped for the buffer's whole lifetime
+		vkMapMemory(_device, _uniform_buffers_memory[i], 0, size, 0, &_uniform_buffers_mapped[i]);
+    }
+}
 
-	    VkDescriptorImageInfo imageInfo{};
-	    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	    imageInfo.imageView = _texture_image_view;
-	    imageInfo.sampler = _texture_sampler;
+void Application::update_uniform_buffer(uint32_t current_frame, const FrameInput& input) {
+    auto spin = glm::rotate(glm::mat4(1.0f), input.time * glm::radians(9.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    for (auto node : _scene_drawables) {
+    	_scene.set_local(node, spin);
+    }
+    _scene.update(&_jobs);
+
+    UniformBufferObject ubo = camera_uniforms(input.camera_eye, input.camera_target, _swap_chain_extent);
+	memcpy(_uniform_buffers_mapped[current_frame], &ubo, sizeof(ubo));
 
-	    std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+	// the model-view-projection is folded on the CPU once per draw instead of once per vertex
+	_view_proj = ubo.view_proj;
+}
 
-		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = _descriptor_sets[i];
-		descriptorWrites[0].dstBinding = 0;
-		descriptorWrites[0].dstArrayElement = 0;
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrites[0].descriptorCount = 1;
-		descriptorWrites[0].pBufferInfo = &bufferInfo;
+UniformBufferObject Application::camera_uniforms(const glm::vec3& eye, const glm::vec3& target, VkExtent2D extent) {
+	UniformBufferObject ubo{};
+	ubo.view = glm::lookAt(eye, target, glm::vec3(0.0f, 0.0f, 1.0f));
+	ubo.proj = glm::perspective(glm::radians(45.0f), extent.width / (float) extent.height, 0.1f, 10.0f);
+	ubo.proj[1][1] *= -1;
+	ubo.view_proj = ubo.proj * ubo.view;
+	return ubo;
+}
 
-		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[1].dstSet = _descriptor_sets[i];
-		descriptorWrites[1].dstBinding = 1;
-		descriptorWrites[1].dstArrayElement = 0;
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pImageInfo = &imageInfo;
+void Application::create_descriptor_allocators() {
+	_descriptor_allocator.init(_device);
+	_descriptor_cache.init(_device, &_descriptor_allocator);
 
-		vkUpdateDescriptorSets(_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	_frame_descriptor_allocators.resize(MAX_FRAMES_IN_FLIGHT);
+	for (auto& allocator : _frame_descriptor_allocators) {
+		allocator.init(_device);
 	}
 }
 
-void Application::create_texture_image() {
-	int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    _texture_mipmap_levels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+void Application::create_texture_image(const uint8_t* rgba, uint32_t width, uint32_t height, Texture& texture) {
+    auto texWidth = static_cast<int32_t>(width);
+    auto texHeight = static_cast<int32_t>(height);
+    texture.mipmap_levels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
     VkDeviceSize imageSize = texWidth * texHeight * 4;
 
-    if (!pixels) {
-        throw std::runtime_error("failed to load texture image!");
-    }
-
     VkBuffer stagingBuffer;
 	VkDeviceMemory stagingBufferMemory;
 	create_buffer(imageSize, 
@@ -1301,29 +3171,23 @@ void Application::create_texture_image() {
 
 	void* data;
 	vkMapMemory(_device, stagingBufferMemory, 0, imageSize, 0, &data);
-	    memcpy(data, pixels, static_cast<size_t>(imageSize));
+	    memcpy(data, rgba, static_cast<size_t>(imageSize));
 	vkUnmapMemory(_device, stagingBufferMemory);
 
-	stbi_image_free(pixels);
-
-	create_image(static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), _texture_mipmap_levels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB,
+	create_image(static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), texture.mipmap_levels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB,
 		VK_IMAGE_TILING_OPTIMAL, 
 		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		_texture_image, _texture_image_memory);
+		texture.image, texture.memory);
 
-	transition_image_layout(_texture_image, VK_FORMAT_R8G8B8A8_SRGB, 
+	transition_image_layout(texture.image, VK_FORMAT_R8G8B8A8_SRGB, 
 		VK_IMAGE_LAYOUT_UNDEFINED, 
 		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		_texture_mipmap_levels);
+		texture.mipmap_levels);
 
-	copy_buffer_to_image(stagingBuffer, _texture_image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+	copy_buffer_to_image(stagingBuffer, texture.image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
 
-	generate_mipmaps(_texture_image, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, _texture_mipmap_levels);
-	// transition_image_layout(_texture_image, VK_FORMAT_R8G8B8A8_SRGB, 
-	// 	VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-	// 	VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-	// 	_texture_mipmap_levels);
+	generate_mipmaps(texture.image, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, texture.mipmap_levels);
 
 	vkDestroyBuffer(_device, stagingBuffer, nullptr);
     vkFreeMemory(_device, stagingBufferMemory, nullptr);
@@ -1521,10 +3385,6 @@ VkImageView Application::create_image_view(VkImage image, VkFormat format, VkIma
 	return view;
 }
 
-void Application::create_texture_image_view() {
-	_texture_image_view = create_image_view(_texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, _texture_mipmap_levels);
-}
-
 void Application::create_texture_sampler() {
 	VkSamplerCreateInfo samplerInfo{};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -1550,26 +3410,14 @@ void Application::create_texture_sampler() {
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = static_cast<float>(_texture_mipmap_levels);
+	// shared by every texture in the bindless table, so don't clamp to one texture's mip chain
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
 	if (vkCreateSampler(_device, &samplerInfo, nullptr, &_texture_sampler) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler!");
     }
 }
 
-void Application::create_depth_resources() {
-	VkFormat depthFormat = find_depth_format();
-	create_image(_swap_chain_extent.width, _swap_chain_extent.height, 1, _msaa_samples, depthFormat, 
-		VK_IMAGE_TILING_OPTIMAL, 
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _depth_image, _depth_image_memory);
-	_depth_image_view = create_image_view(_depth_image, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
-
-	transition_image_layout(_depth_image, depthFormat, 
-		VK_IMAGE_LAYOUT_UNDEFINED, 
-		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
-}
-
 VkFormat Application::find_support_format(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
 	for (VkFormat format : candidates) {
 	    VkFormatProperties props;
@@ -1597,41 +3445,53 @@ bool Application::has_stencil_component(VkFormat format) {
 }
 
 void Application::load_model() {
-	tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str())) {
-        throw std::runtime_error(warn + err);
-    }
-
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-    for (const auto& shape : shapes) {
-	    for (const auto& index : shape.mesh.indices) {
-	        Vertex vertex{};
-
-	        vertex.pos = {
-			    attrib.vertices[3 * index.vertex_index + 0],
-			    attrib.vertices[3 * index.vertex_index + 1],
-			    attrib.vertices[3 * index.vertex_index + 2]
-			};
-
-			vertex.texCoord = {
-			    attrib.texcoords[2 * index.texcoord_index + 0],
-			    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-			};
-
-			vertex.color = {1.0f, 1.0f, 1.0f};
-
-			if (uniqueVertices.count(vertex) == 0) {
-	            uniqueVertices[vertex] = static_cast<uint32_t>(_vertices.size());
-	            _vertices.push_back(vertex);
-	        }
+	// parsed in place from the mapped file or archive
+	auto path = _model_path.empty() ? MODEL_PATH : _model_path;
+	auto file = _blob_cache.load(path);
+	auto model = load_model_file(path, file->span(), &_jobs);
+	if (_model_path.empty()) {
+		// the viking room's OBJ names no material library, its texture is known
+		for (auto& material : model.materials) {
+			if (!material.textured()) {
+				material.texture_path = TEXTURE_PATH;
+			}
+		}
+	}
+	_vertices = std::move(model.vertices);
+	_indices = std::move(model.indices);
+	_submeshes = std::move(model.submeshes);
+	_model_materials = std::move(model.materials);
+}
+
+void Application::create_materials() {
+	// materials sharing a texture file share its slot
+	std::unordered_map<std::string, uint32_t> texturesByPath;
+	_materials.clear();
+	for (const auto& material : _model_materials) {
+		DrawMaterial draw{};
+		if (!material.texture_data.empty()) {
+			draw.texture = load_texture(std::span<const char>(material.texture_data));
+		} else if (!material.texture_path.empty()) {
+			auto it = texturesByPath.find(material.texture_path);
+			if (it == texturesByPath.end()) {
+				it = texturesByPath.emplace(material.texture_path, load_texture(material.texture_path)).first;
+			}
+			draw.texture = it->second;
+		}
 
-	        _indices.push_back(uniqueVertices[vertex]);
-	    }
+		if (material.textured()) {
+			draw.features |= PIPELINE_FEATURE_TEXTURE;
+		}
+		if (material.vertex_color) {
+			draw.features |= PIPELINE_FEATURE_VERTEX_COLOR;
+		}
+		if (material.alpha_test) {
+			draw.features |= PIPELINE_FEATURE_ALPHA_TEST;
+		}
+		_materials.push_back(draw);
 	}
+	// the embedded images are uploaded, nothing else needs them
+	_model_materials.clear();
 }
 
 void Application::generate_mipmaps(VkImage image,  VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
@@ -1736,13 +3596,3 @@ VkSampleCountFlagBits Application::get_max_usable_sample_count() {
     return VK_SAMPLE_COUNT_1_BIT;
 }
 
-void Application::create_color_resources() {
-    VkFormat colorFormat = _swap_chain_format;
-
-    create_image(_swap_chain_extent.width, _swap_chain_extent.height, 1, _msaa_samples, colorFormat, 
-    	VK_IMAGE_TILING_OPTIMAL, 
-    	VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 
-    	VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-    	_color_image, _color_image_memory);
-    _color_image_view = create_image_view(_color_image, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
-}
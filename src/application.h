@@ -2,66 +2,106 @@
 #include <GLFW/glfw3.h>
 
 #include <vector>
+#include <string>
 #include <optional>
 #include <array>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <future>
+#include <unordered_map>
+#include <chrono>
+#include <span>
 #include <glm/glm.hpp>
 
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include "vertex.h"
+#include "model_loader.h"
+#include "job_system.h"
+#include "blob_cache.h"
+#include "asset_archive.h"
+#include "descriptor_allocator.h"
+#include "shader_manager.h"
+#include "pipeline_variants.h"
+#include "pipeline_compiler.h"
+#include "render_graph.h"
+#include "compute_scheduler.h"
+#include "device_selector.h"
+#include "batch_renderer.h"
+#include "frame_capture.h"
+#include "frame_pipeline.h"
+#include "frame_pacing.h"
+#include "scene_graph.h"
+
+// per frame camera data; per draw transforms travel as push constants
+struct UniformBufferObject {
+    glm::mat4 view;
+    glm::mat4 proj;
+    glm::mat4 view_proj;
+};
 
-struct Vertex {
-    glm::vec3 pos;
-    glm::vec3 color;
-    glm::vec2 texCoord;
+struct Texture {
+	VkImage image;
+	VkDeviceMemory memory;
+	VkImageView view;
+	uint32_t mipmap_levels;
+};
 
-    static VkVertexInputBindingDescription getBindingDescription() {
-        VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+// must match the push_constant block in default.vert and default.frag
+struct DrawPushConstants {
+	glm::mat4 model;
+	uint32_t material_id;
+};
 
-        return bindingDescription;
-    }
+// push constants of cull.comp
+struct CullPushConstants {
+	glm::mat4 view_proj;
+	uint32_t instance_count;
+};
 
-    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
-    	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-    	attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-		attributeDescriptions[2].binding = 0;
-        attributeDescriptions[2].location = 2;
-        attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-    	return attributeDescriptions;
-	}
-
-	bool operator==(const Vertex& other) const {
-	    return pos == other.pos && color == other.color && texCoord == other.texCoord;
-	}
+// one submesh at one scene node, as cull.comp reads it
+struct CullInstance {
+	glm::vec4 bounds_min;
+	glm::vec4 bounds_max;
+	// position of the node's world matrix
+	uint32_t node;
+	uint32_t first_index;
+	uint32_t index_count;
+	uint32_t padding;
 };
 
-namespace std {
-    template<> struct hash<Vertex> {
-        size_t operator()(Vertex const& vertex) const {
-            return ((hash<glm::vec3>()(vertex.pos) ^
-                   (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-                   (hash<glm::vec2>()(vertex.texCoord) << 1);
-        }
-    };
-}
+// a model material as the renderer draws it
+struct DrawMaterial {
+	// the shader features it needs, on top of the ones shared by every draw
+	PipelineKey features;
+	// slot in the bindless texture table
+	uint32_t texture;
+};
 
-struct UniformBufferObject {
-    glm::mat4 model;
-    glm::mat4 view;
-    glm::mat4 proj;
+// one submesh of the model at one scene node; each is culled and drawn on its own
+struct DrawItem {
+	SceneNode node;
+	uint32_t submesh;
+};
+
+// push constants of capture_yuv.comp
+struct CapturePushConstants {
+	uint32_t width;
+	uint32_t height;
+	uint32_t plane_words;
+	uint32_t encode_srgb;
+};
+
+// Anti-aliasing quality/cost trade-off. MSAA sample counts are clamped to what the
+// device supports; FXAA only runs on the single sample path.
+struct AntiAliasingPolicy {
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_4_BIT;
+	bool sample_shading = false;
+	float min_sample_shading = 0.2f;
+	bool fxaa = false;
+
+	// "off", "fxaa", "msaa2", "msaa4", "msaa8", with "+ss" for sample shading, e.g. "msaa4+ss"
+	static std::optional<AntiAliasingPolicy> parse(const std::string& name);
+	std::string name() const;
 };
 
 struct SwapChainDetails {
@@ -84,9 +124,129 @@ private:
 	void main_loop();
 	void cleanup();
 
-	void draw_frame();
+	// the input/simulation stage on the main thread feeds the render stage, which records
+	// and submits the frame; pipelined, the render stage runs on its own thread
+	void pipelined_main_loop();
+	// paces the next frame, or rendering on demand with nothing invalidated, blocks for events
+	void wait_for_frame();
+	bool frame_needed();
+	// from any thread; wakes the main loop when it is idle
+	void invalidate(uint32_t reasons);
+	FrameInput sample_input();
+	void render_frame(const FrameInput& input);
+	void handle_key(int key);
+	void draw_frame(const FrameInput& input);
+	// ends the latency of every frame whose fence signalled
+	void record_frame_latencies();
+
+	// offscreen rendering of the batch views, without window, surface or swap chain
+	bool headless() const { return _batch_queue != nullptr; }
+	void batch_loop();
+	void render_batch_view(const BatchView& view);
+	// one color target and readback buffer per frame in flight, in place of the swap chain images
+	void create_offscreen_targets();
+	void record_readback(VkCommandBuffer command_buffer);
+	// hands the image the frame slot read back to the writer, once its fence signalled
+	void finish_readback(size_t frame);
+
+	// the pre-pass toggle changes the passes, so the graph and every pipeline are rebuilt
+	void rebuild_render_graph();
+	std::vector<PipelineKey> required_pipeline_keys() const;
+	// adds the state the main pass needs when depth was laid down by the pre-pass
+	PipelineKey main_pass_key(PipelineKey features) const;
+	// the main pass variant for a material
+	PipelineKey draw_pipeline_key(const DrawMaterial& material) const;
+	void request_model_pipelines();
+	// derives the sample count and model pipeline features from _anti_aliasing
+	void apply_anti_aliasing_policy();
+	bool fxaa_supported();
+
+	void create_post_process_resources();
+	VkPipeline create_fxaa_pipeline();
+	void record_fxaa(VkCommandBuffer command_buffer, RenderGraphImage input, RenderGraphImage output);
+	void blit_to_backbuffer(VkCommandBuffer command_buffer, RenderGraphImage source);
+
+	// streaming of the presented frames to _capture_path through _frame_capture
+	bool capture_supported();
+	void open_capture();
+	void create_capture_resources();
+	VkPipeline create_capture_pipeline();
+	void record_capture_blit(VkCommandBuffer command_buffer, RenderGraphImage capture);
+	void record_capture_copy(VkCommandBuffer command_buffer, RenderGraphImage capture);
+	void record_capture_convert(VkCommandBuffer command_buffer, RenderGraphImage capture);
+	void record_capture_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access);
+
+	// GPU frustum culling of the scene instances into indirect draws, run through _compute_scheduler
+	void create_cull_resources();
+	void create_cull_buffers(uint32_t node_capacity, uint32_t instance_capacity);
+	void destroy_cull_buffers();
+	// grows the culling buffers to the scene and its draw list
+	void reserve_cull_buffers();
+	// the draws follow the world matrices in the instance buffer
+	VkDeviceSize cull_instances_offset() const { return _cull_node_capacity * sizeof(glm::mat4); }
+	VkPipeline create_cull_pipeline();
+	void schedule_culling();
+
+	void create_statistics_query_pool();
+	void collect_pipeline_statistics(uint32_t current_frame);
+	// GPU time of each frame from timestamps around its command buffer, for just in time frame starts
+	void create_timestamp_query_pool();
+	void collect_gpu_time(uint32_t current_frame);
+	// the cap and frame start policy for the present mode the swap chain ended up with
+	void configure_frame_limiter();
+	void step_prepass_benchmark();
+
+	void reload_shaders();
+
+	// serves the assets from one archive file instead of loose files, when there is one
+	void mount_asset_archive();
+
+	// runs destroy once every frame that might reference the object has finished
+	void defer_destroy(std::function<void()>&& destroy);
+	void flush_deferred_destroys(bool all);
 public:
-	void set_framebuffer_resized() {_framebuffer_resized = true;}
+	void set_framebuffer_resized() {_framebuffer_resized = true; invalidate(FrameInvalidation::WINDOW);}
+	// the window system lost the window's contents
+	void on_window_refresh() {invalidate(FrameInvalidation::WINDOW);}
+	void on_key(int key, int action);
+
+	void set_depth_prepass(bool enabled) {_depth_prepass = enabled;}
+	// an OBJ or glTF binary (.glb) file to draw instead of the default model, before run()
+	void set_model(const std::string& path) {_model_path = path;}
+	// forces the render pass path even where dynamic rendering is available, before run()
+	void set_dynamic_rendering_allowed(bool allowed) {_dynamic_rendering_allowed = allowed;}
+	// an enumeration index or part of the device name, overrides VULKAN_DEVICE and the ranking
+	void set_device(const std::string& device) {_device_override = device;}
+	// keeps compute on the graphics queue even where a dedicated compute family exists, before run()
+	void set_async_compute_allowed(bool allowed) {_async_compute_allowed = allowed;}
+	// takes effect at the next frame when called while running
+	void set_anti_aliasing(const AntiAliasingPolicy& policy);
+	// renders an overdraw heavy scene with and without the depth pre-pass, prints
+	// the fragment shader invocations of both and exits
+	void set_prepass_benchmark(bool enabled) {_prepass_benchmark = enabled;}
+	// simulates the next frame on the main thread while another thread records and submits
+	// this one; the throughput and latency of the mode are printed on exit
+	void set_frame_pipelining(bool enabled) {_frame_pipelining = enabled;}
+	// falls back to the closest supported mode, before run()
+	void set_present_mode(VkPresentModeKHR mode) {_present_policy.mode = mode;}
+	// 0 for no cap, before run()
+	void set_frame_rate_limit(double fps) {_present_policy.target_fps = fps;}
+	void set_just_in_time(bool enabled) {_present_policy.just_in_time = enabled;}
+	// draws only when the scene, camera, window, swap chain or settings changed and otherwise
+	// blocks for events; the model rests until R starts its rotation, before run()
+	void set_on_demand(bool enabled) {_on_demand = enabled;}
+
+	// renders the views of queue offscreen instead of opening a window; several
+	// applications may share one queue and writer, one per device
+	void set_batch(BatchQueue* queue, ImageWriter* writer) {_batch_queue = queue; _image_writer = writer;}
+	void set_pipeline_cache_path(const std::string& path) {_pipeline_cache_path = path;}
+	// the archive the assets are loaded from; by default assets.pak when it exists, else loose files
+	void set_asset_archive(const std::string& path) {_asset_archive_path = path;}
+	// streams every presented frame to path, "-" for stdout; Y4M for .y4m files, raw RGBA otherwise
+	void set_capture(const std::string& path) {_capture_path = path;}
+
+	// sets from here are only valid until the current frame slot comes around again
+	VkDescriptorSet allocate_transient_descriptor_set(VkDescriptorSetLayout layout);
 
 private:
 	void create_instance();
@@ -108,6 +268,8 @@ private:
 	std::vector<VkPhysicalDevice> physical_devices();
 	std::vector<VkQueueFamilyProperties> queue_families(VkPhysicalDevice device);
 	std::optional<uint32_t> find_queue_family(VkPhysicalDevice device, uint32_t queue_flags, VkSurfaceKHR surface = VK_NULL_HANDLE);
+	// a compute family without graphics, which usually maps to separate hardware queues
+	std::optional<uint32_t> find_async_compute_family(VkPhysicalDevice device);
 	std::vector<VkExtensionProperties> device_extensions(VkPhysicalDevice device);
 	template <class Itor>
 	bool check_device_extensions_support(Itor first, Itor last, VkPhysicalDevice device);
@@ -115,6 +277,9 @@ private:
 
 	void pick_physical_device();
 	bool is_device_suitable(VkPhysicalDevice device);
+	bool check_descriptor_indexing_support(VkPhysicalDevice device);
+	enum class DynamicRenderingSupport { NONE, CORE, EXTENSION };
+	DynamicRenderingSupport check_dynamic_rendering_support(VkPhysicalDevice device);
 
 	void create_logic_device();
 
@@ -126,36 +291,68 @@ private:
 	void create_image_views();
 
 	void create_descriptor_layout();
-	void create_pipeline();
-	VkShaderModule create_shader_module(const std::vector<char>& buffer);
-
-	void create_render_pass();
-
-	void create_framebuffers();
+	void create_pipeline_layout();
+	// compiles every key on the worker threads and waits for all of them
+	void create_pipelines(const std::vector<PipelineKey>& keys);
+	// queues a background compile, no-op if the variant exists or is already queued
+	void request_pipeline(PipelineKey key);
+	void finish_pending_pipelines();
+	// the fallback variant with the same alpha test and depth test is returned while the
+	// requested one is still compiling, VK_NULL_HANDLE while neither is ready
+	VkPipeline get_pipeline(PipelineKey key);
+	VkPipeline build_pipeline(PipelineKey key, VkPipelineCache cache);
+	template <class VertexType>
+	VkPipeline create_pipeline(PipelineKey key, VkPipelineCache cache);
+	VkShaderModule create_shader_module(std::span<const char> code);
+
+	// declares the frame's passes; rebuilt with the swap chain since it sizes the attachments
+	void build_render_graph();
 
 	void create_command_pool();
 	void create_command_buffers();
+	void record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index);
+	// viewport and scissor covering the render graph extent, dynamic in every graphics pipeline
+	void set_viewport(VkCommandBuffer command_buffer);
+	// the camera uniforms of the current frame, set 0 of the draw pipelines
+	VkDescriptorSet frame_descriptor_set();
+	void draw_scene(VkCommandBuffer command_buffer);
+	void draw_depth_prepass(VkCommandBuffer command_buffer);
+	// one copy of the model, more only when measuring overdraw
+	void build_scene();
+	// every submesh at every drawn node, sorted by pipeline and material
+	void build_draw_list();
 
 	void create_sync_objects();
 
 	void create_vertex_buffer();
+	void create_position_buffer();
 	void create_index_buffer();
-	uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties);
+	// types with the preferred flags as well are taken first if there are any
+	uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred = 0);
 
 	void create_buffer(VkDeviceSize size, 
 		VkBufferUsageFlags usage, 
 		VkMemoryPropertyFlags properties, 
 		VkBuffer& buffer,
-		VkDeviceMemory& buffer_memory);
+		VkDeviceMemory& buffer_memory,
+		const std::vector<uint32_t>& queue_families = {},
+		VkMemoryPropertyFlags preferred_properties = 0);
 	void copy_buffer(VkBuffer src, VkBuffer dest, VkDeviceSize size);
 
 	void create_uniform_buffers();
-	void update_uniform_buffer(uint32_t current_image);
+	void update_uniform_buffer(uint32_t current_frame, const FrameInput& input);
 
-	void create_descriptor_pool();
-	void create_descriptor_sets();
+	void create_descriptor_allocators();
 
-	void create_texture_image();
+	void create_texture_descriptor_layout();
+	void create_texture_descriptor_set();
+	void write_texture_descriptor(uint32_t texture_index);
+
+	uint32_t load_texture(const std::string& path);
+	// an encoded image in memory, e.g. embedded in a model file
+	uint32_t load_texture(std::span<const char> encoded);
+	uint32_t create_texture(const uint8_t* rgba, uint32_t width, uint32_t height);
+	void create_texture_image(const uint8_t* rgba, uint32_t width, uint32_t height, Texture& texture);
 	void create_image(uint32_t width, uint32_t height, uint32_t mipmap_levels, VkSampleCountFlagBits numSamples, VkFormat format, 
 		VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, 
 		VkImage& image, VkDeviceMemory& imageMemory);
@@ -166,21 +363,20 @@ private:
 	void transition_image_layout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipmap_levels);
 	void copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 
-	void create_texture_image_view();
 	VkImageView create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipmap_levels);
 	void create_texture_sampler();
 
-	void create_depth_resources();
 	VkFormat find_support_format(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 	VkFormat find_depth_format();
 	bool has_stencil_component(VkFormat format);
 
 	void load_model();
+	// the textures and pipeline features of the loaded model's materials
+	void create_materials();
 
 	void generate_mipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
 
 	VkSampleCountFlagBits get_max_usable_sample_count();
-	void create_color_resources();
 private:
 	void cleanup_swap_chain();
 	void recreate_swap_chain();
@@ -191,34 +387,89 @@ public:
 	    const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
 	    void* pUserData);
 
+	// copies the whole file; loaders go through _blob_cache, which maps it instead
 	static std::vector<char> read_file(const std::string& filename);
+	// camera matrices of the frame uniforms, with Vulkan's clip space
+	static UniformBufferObject camera_uniforms(const glm::vec3& eye, const glm::vec3& target, VkExtent2D extent);
 
 private:
-	GLFWwindow* _window;
+	GLFWwindow* _window = nullptr;
 
 	VkInstance _instance;
 	
 	VkDebugUtilsMessengerEXT _debug_messenger;
 
-	VkSurfaceKHR _surface;
+	VkSurfaceKHR _surface = VK_NULL_HANDLE;
 
 	VkPhysicalDevice _physical_device = VK_NULL_HANDLE;
 
-	VkDevice _device;
+	VkDevice _device = VK_NULL_HANDLE;
 	VkQueue _graphics_queue;
 	VkQueue _present_queue;
 
-	VkSwapchainKHR _swap_chain;
+	std::string _device_override;
+	bool _async_compute_allowed = true;
+	ComputeScheduler _compute_scheduler;
+
+	// headless, the images are the offscreen targets and there is no swap chain
+	VkSwapchainKHR _swap_chain = VK_NULL_HANDLE;
 	std::vector<VkImage> _swap_chain_images;
 	VkFormat _swap_chain_format;
 	VkExtent2D _swap_chain_extent;
 	std::vector<VkImageView> _swap_chain_image_views;
-	std::vector<VkFramebuffer> _swap_chain_framebuffers;
-
-	VkPipeline _pipeline;
+	VkPresentModeKHR _present_mode = VK_PRESENT_MODE_FIFO_KHR;
+
+	PresentPolicy _present_policy;
+	FrameLimiter _frame_limiter;
+
+	BatchQueue* _batch_queue = nullptr;
+	ImageWriter* _image_writer = nullptr;
+	// size of the offscreen targets, follows the current batch view
+	VkExtent2D _offscreen_extent{800, 600};
+	std::vector<VkDeviceMemory> _offscreen_image_memory;
+	std::vector<VkBuffer> _readback_buffers;
+	std::vector<VkDeviceMemory> _readback_buffers_memory;
+	std::vector<void*> _readback_buffers_mapped;
+	struct PendingReadback {
+		bool pending = false;
+		std::string output;
+		VkExtent2D extent;
+	};
+	std::vector<PendingReadback> _pending_readbacks;
+
+	// engine work that can run off the main thread; jobs touching GLFW go through submit_main()
+	JobSystem _jobs;
+
+	// shader, texture and model files, shared with the pipeline compiler's threads
+	BlobCache _blob_cache;
+	std::string _asset_archive_path;
+
+	PipelineVariantCache _pipelines;
+	PipelineCompiler _pipeline_compiler;
+	// empty for the default file
+	std::string _pipeline_cache_path;
+	std::unordered_map<PipelineKey, std::shared_future<VkPipeline>> _pending_pipelines;
+	// cheapest variant that can still draw any material, compiled before the first frame;
+	// untextured materials sample the white texture in slot 0 until their own is ready
+	PipelineKey _fallback_pipeline_key = PIPELINE_FEATURE_TEXTURE;
+	// added to every material's features: sample shading, from the anti-aliasing policy
+	PipelineKey _shared_pipeline_features = 0;
 	VkDescriptorSetLayout _descriptor_layout;
 	VkPipelineLayout _pipeline_layout;
-	VkRenderPass _render_pass;
+
+	// owns the attachments and render passes; the swap chain image is imported as _backbuffer
+	RenderGraph _render_graph;
+	RenderGraphImage _backbuffer = RENDER_GRAPH_NONE;
+	RenderGraphPassId _main_pass = RENDER_GRAPH_NONE;
+	RenderGraphPassId _depth_prepass_pass = RENDER_GRAPH_NONE;
+
+	bool _depth_prepass = false;
+	bool _render_graph_dirty = false;
+
+	// core or KHR entry points, null when the graph uses render passes
+	bool _dynamic_rendering_allowed = true;
+	PFN_vkCmdBeginRendering _cmd_begin_rendering = nullptr;
+	PFN_vkCmdEndRendering _cmd_end_rendering = nullptr;
 
 	VkCommandPool _command_pool;
 	std::vector<VkCommandBuffer> _command_buffers;
@@ -229,11 +480,45 @@ private:
 	std::vector<VkFence> _in_flight_image_fences;
 
 	size_t _current_frame = 0;
+	uint64_t _frame_count = 0;
 
-	bool _framebuffer_resized = false;
+	std::deque<std::pair<uint64_t, std::function<void()>>> _deferred_destroys;
+
+	std::unique_ptr<ShaderManager> _shader_manager;
 
+	// main thread only; the render stage learns about both through FrameInput
+	bool _framebuffer_resized = false;
+	std::vector<int> _pressed_keys;
+	// render stage copy of the size sampled with the input
+	VkExtent2D _framebuffer_extent{};
+	// render stage only: a present returned SUBOPTIMAL or OUT_OF_DATE
+	bool _swap_chain_stale = false;
+
+	bool _frame_pipelining = false;
+	uint64_t _input_count = 0;
+	std::chrono::steady_clock::time_point _last_sample;
+	// simulation state, main thread only: the model's rotation advances while it is animating
+	float _scene_time = 0.0f;
+	bool _animating = true;
+
+	bool _on_demand = false;
+	FrameInvalidation _invalidation;
+	// the camera of the last sampled frame, a different one invalidates
+	glm::vec3 _sampled_camera_eye{0.0f};
+	glm::vec3 _sampled_camera_target{0.0f};
+	bool _idled = false;
+	FrameStats _frame_stats;
+	// input sample time of the frame each slot holds, until its fence is seen signalled
+	std::vector<std::optional<std::chrono::steady_clock::time_point>> _frame_input_times;
+
+	// empty for the default model
+	std::string _model_path;
 	std::vector<Vertex> _vertices;
 	std::vector<uint32_t> _indices;
+	std::vector<Submesh> _submeshes;
+	// as loaded, until create_materials() turns them into _materials
+	std::vector<ModelMaterial> _model_materials;
+	std::vector<DrawMaterial> _materials;
 
 	VkBuffer _vertex_buffer;
 	VkDeviceMemory _vertex_buffer_memory;
@@ -241,25 +526,86 @@ private:
 	VkBuffer _index_buffer;
 	VkDeviceMemory _index_buffer_memory;
 
+	// positions only, shares _index_buffer with the full vertex stream
+	VkBuffer _position_buffer;
+	VkDeviceMemory _position_buffer_memory;
+
+	// fragment shader invocations of the main pass, one query per frame in flight
+	bool _pipeline_statistics_supported = false;
+	VkQueryPool _statistics_query_pool = VK_NULL_HANDLE;
+	std::vector<bool> _statistics_recorded;
+	uint64_t _fragment_invocations = 0;
+	uint64_t _statistics_frames = 0;
+
+	// two timestamps per frame in flight, at the start and the end of its command buffer
+	VkQueryPool _timestamp_query_pool = VK_NULL_HANDLE;
+	std::vector<bool> _timestamps_recorded;
+	double _timestamp_period_ns = 0.0;
+	uint64_t _timestamp_mask = 0;
+
+	bool _prepass_benchmark = false;
+	uint32_t _overdraw_layers = 1;
+	int _benchmark_phase = 0;
+	uint64_t _benchmark_baseline = 0;
+	std::chrono::steady_clock::time_point _benchmark_start;
+
 	std::vector<VkBuffer> _uniform_buffers;
 	std::vector<VkDeviceMemory> _uniform_buffers_memory;
-
-	VkDescriptorPool _descriptor_pool;
-	std::vector<VkDescriptorSet> _descriptor_sets;
-
-	VkImage _texture_image;
-	VkDeviceMemory _texture_image_memory;
-	VkImageView _texture_image_view;
+	std::vector<void*> _uniform_buffers_mapped;
+
+	// render stage state; the world matrices are updated with the frame uniforms
+	SceneGraph _scene;
+	// the nodes the model is drawn at
+	std::vector<SceneNode> _scene_drawables;
+	// in draw order, one indirect draw each
+	std::vector<DrawItem> _draws;
+	glm::mat4 _view_proj;
+	// the simulation's camera, sampled into each frame's input
+	glm::vec3 _camera_eye{2.0f, 2.0f, 2.0f};
+	glm::vec3 _camera_target{0.0f, 0.0f, 0.0f};
+
+	// per frame in flight: mapped instance transforms in, one indirect draw per instance out
+	VkDescriptorSetLayout _cull_descriptor_layout;
+	VkPipelineLayout _cull_pipeline_layout;
+	VkPipeline _cull_pipeline;
+	std::vector<VkBuffer> _cull_instance_buffers;
+	std::vector<VkDeviceMemory> _cull_instance_buffers_memory;
+	std::vector<void*> _cull_instance_buffers_mapped;
+	std::vector<VkBuffer> _cull_draw_buffers;
+	std::vector<VkDeviceMemory> _cull_draw_buffers_memory;
+	uint32_t _cull_node_capacity = 0;
+	uint32_t _cull_instance_capacity = 0;
+
+	// long lived sets come from _descriptor_allocator through _descriptor_cache,
+	// per frame sets from the frame's allocator, which is reset once its fence signals
+	DescriptorAllocator _descriptor_allocator;
+	DescriptorCache _descriptor_cache;
+	std::vector<DescriptorAllocator> _frame_descriptor_allocators;
+
+	std::vector<Texture> _textures;
 	VkSampler _texture_sampler;
-	uint32_t _texture_mipmap_levels;
 
-	VkImage _depth_image;
-	VkImageView _depth_image_view;
-	VkDeviceMemory _depth_image_memory;
+	// bindless texture table, indexed in the fragment shader by material id
+	uint32_t _max_bindless_textures = 0;
+	VkDescriptorSetLayout _texture_descriptor_layout;
+	VkDescriptorSet _texture_descriptor_set;
 
+	AntiAliasingPolicy _anti_aliasing;
 	VkSampleCountFlagBits _msaa_samples = VK_SAMPLE_COUNT_1_BIT;
-
-	VkImage _color_image;
-	VkDeviceMemory _color_image_memory;
-	VkImageView _color_image_view;
+	VkSampleCountFlagBits _max_msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+	VkImageUsageFlags _swap_chain_usage = 0;
+
+	// FXAA compute pass of the single sample path
+	VkSampler _post_process_sampler;
+	VkDescriptorSetLayout _fxaa_descriptor_layout;
+	VkPipelineLayout _fxaa_pipeline_layout;
+	VkPipeline _fxaa_pipeline;
+
+	// frame capture; the slot is the readback buffer of the frame being recorded, if it got one
+	std::string _capture_path;
+	FrameCapture _frame_capture;
+	std::optional<uint32_t> _capture_slot;
+	VkDescriptorSetLayout _capture_descriptor_layout = VK_NULL_HANDLE;
+	VkPipelineLayout _capture_pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline _capture_pipeline = VK_NULL_HANDLE;
 };
@@ -0,0 +1,260 @@
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+#include <future>
+#include <atomic>
+#include <unordered_set>
+#include <cstring>
+#include <algorithm>
+
+#include "asset_archive.h"
+#include "lz_codec.h"
+#include "job_system.h"
+#include "thread_pool.h"
+
+namespace {
+
+// an entry of stored chunks, straight from the mapping of the archive it keeps open
+class MappedEntryBlob : public Blob {
+public:
+	MappedEntryBlob(std::shared_ptr<const AssetArchive> archive, const char* data, size_t size)
+		: _archive(std::move(archive)) {
+		_data = data;
+		_size = size;
+	}
+
+private:
+	std::shared_ptr<const AssetArchive> _archive;
+};
+
+class DecodedEntryBlob : public Blob {
+public:
+	explicit DecodedEntryBlob(size_t size)
+		: _storage(size) {
+		_data = _storage.data();
+		_size = size;
+	}
+
+	char* storage() { return _storage.data(); }
+
+private:
+	std::vector<char> _storage;
+};
+
+}
+
+std::string archive_entry_name(const std::string& path) {
+	auto name = std::filesystem::path(path).lexically_normal().generic_string();
+	if (name.rfind("./", 0) == 0) {
+		name.erase(0, 2);
+	}
+	return name;
+}
+
+void write_asset_archive(const std::string& output, const std::vector<std::string>& files, uint32_t chunk_size) {
+	std::ofstream out(output, std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) {
+		throw std::runtime_error("failed to open archive " + output + "!");
+	}
+
+	ArchiveHeader header{};
+	std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+	header.version = ARCHIVE_VERSION;
+	header.chunk_size = chunk_size;
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	uint64_t offset = sizeof(header);
+
+	auto pad = [&out, &offset](uint64_t alignment) {
+		static const char zeros[ARCHIVE_ALIGNMENT] = {};
+		uint64_t padding = (alignment - offset % alignment) % alignment;
+		out.write(zeros, static_cast<std::streamsize>(padding));
+		offset += padding;
+	};
+
+	ThreadPool pool;
+	std::vector<ArchiveEntry> entries;
+	std::vector<ArchiveChunk> chunks;
+	std::string names;
+	std::unordered_set<std::string> seen;
+
+	for (const auto& file : files) {
+		auto name = archive_entry_name(file);
+		if (!seen.insert(name).second) {
+			throw std::runtime_error("duplicate archive entry " + name + "!");
+		}
+
+		FileBlob blob(file);
+		pad(ARCHIVE_ALIGNMENT);
+
+		ArchiveEntry entry{};
+		entry.name_offset = names.size();
+		entry.name_size = static_cast<uint32_t>(name.size());
+		entry.size = blob.size();
+		entry.first_chunk = static_cast<uint32_t>(chunks.size());
+		entry.chunk_count = static_cast<uint32_t>((blob.size() + chunk_size - 1) / chunk_size);
+		names += name;
+
+		// an empty result stores the chunk: compression has to save a sixteenth to be worth decoding,
+		// and at least a byte, as readers take a chunk of stored_size == raw_size for a stored one
+		std::vector<std::future<std::vector<char>>> compressed;
+		for (uint32_t i = 0; i < entry.chunk_count; ++i) {
+			const char* begin = blob.data() + static_cast<size_t>(i) * chunk_size;
+			size_t length = std::min<size_t>(chunk_size, blob.size() - static_cast<size_t>(i) * chunk_size);
+			compressed.push_back(pool.submit([begin, length]() {
+				std::vector<char> result(length - std::max<size_t>(1, length / 16));
+				result.resize(lz_compress(begin, length, result.data(), result.size()));
+				return result;
+			}));
+		}
+
+		for (uint32_t i = 0; i < entry.chunk_count; ++i) {
+			auto data = compressed[i].get();
+			ArchiveChunk chunk{};
+			chunk.offset = offset;
+			chunk.raw_size = static_cast<uint32_t>(std::min<size_t>(chunk_size, blob.size() - static_cast<size_t>(i) * chunk_size));
+			if (data.empty()) {
+				chunk.stored_size = chunk.raw_size;
+				out.write(blob.data() + static_cast<size_t>(i) * chunk_size, chunk.raw_size);
+			} else {
+				chunk.stored_size = static_cast<uint32_t>(data.size());
+				out.write(data.data(), static_cast<std::streamsize>(data.size()));
+			}
+			offset += chunk.stored_size;
+			chunks.push_back(chunk);
+		}
+		entries.push_back(entry);
+	}
+
+	pad(alignof(ArchiveEntry));
+	header.toc_offset = offset;
+	header.entry_count = static_cast<uint32_t>(entries.size());
+	header.chunk_count = static_cast<uint32_t>(chunks.size());
+	out.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(ArchiveEntry)));
+	out.write(reinterpret_cast<const char*>(chunks.data()), static_cast<std::streamsize>(chunks.size() * sizeof(ArchiveChunk)));
+	out.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+	out.seekp(0);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if (!out.good()) {
+		throw std::runtime_error("failed to write archive " + output + "!");
+	}
+}
+
+std::shared_ptr<AssetArchive> AssetArchive::open(const std::string& path, JobSystem* jobs) {
+	// the constructor is private, so no make_shared
+	return std::shared_ptr<AssetArchive>(new AssetArchive(path, jobs));
+}
+
+AssetArchive::AssetArchive(const std::string& path, JobSystem* jobs)
+	: _path(path), _file(path), _jobs(jobs) {
+	auto invalid = [&path]() {
+		return std::runtime_error("failed to read archive " + path + ", it is damaged or of another version!");
+	};
+
+	// everything is checked once here, so loads can trust the table of contents
+	if (_file.size() < sizeof(ArchiveHeader)) {
+		throw invalid();
+	}
+	_header = reinterpret_cast<const ArchiveHeader*>(_file.data());
+	if (std::memcmp(_header->magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 || _header->version != ARCHIVE_VERSION
+		|| _header->chunk_size == 0 || _header->toc_offset % alignof(ArchiveEntry) != 0) {
+		throw invalid();
+	}
+
+	uint64_t tocSize = uint64_t(_header->entry_count) * sizeof(ArchiveEntry) + uint64_t(_header->chunk_count) * sizeof(ArchiveChunk);
+	if (_header->toc_offset > _file.size() || tocSize > _file.size() - _header->toc_offset) {
+		throw invalid();
+	}
+	auto entries = reinterpret_cast<const ArchiveEntry*>(_file.data() + _header->toc_offset);
+	_chunks = reinterpret_cast<const ArchiveChunk*>(entries + _header->entry_count);
+	const char* names = reinterpret_cast<const char*>(_chunks + _header->chunk_count);
+	uint64_t namesSize = _file.size() - _header->toc_offset - tocSize;
+
+	for (uint32_t i = 0; i < _header->chunk_count; ++i) {
+		const auto& chunk = _chunks[i];
+		if (chunk.raw_size > _header->chunk_size || chunk.stored_size > chunk.raw_size
+			|| chunk.offset > _header->toc_offset || chunk.stored_size > _header->toc_offset - chunk.offset) {
+			throw invalid();
+		}
+	}
+
+	for (uint32_t i = 0; i < _header->entry_count; ++i) {
+		const auto& entry = entries[i];
+		if (entry.name_offset > namesSize || entry.name_size > namesSize - entry.name_offset
+			|| entry.first_chunk > _header->chunk_count || entry.chunk_count > _header->chunk_count - entry.first_chunk) {
+			throw invalid();
+		}
+		// every chunk but the last is full, so chunk i decodes to i * chunk_size; the chunks
+		// are back to back, so an entry of stored chunks is one range of the file
+		uint64_t size = 0;
+		for (uint32_t c = 0; c < entry.chunk_count; ++c) {
+			const auto& chunk = _chunks[entry.first_chunk + c];
+			if (c + 1 < entry.chunk_count && (chunk.raw_size != _header->chunk_size
+				|| _chunks[entry.first_chunk + c + 1].offset != chunk.offset + chunk.stored_size)) {
+				throw invalid();
+			}
+			size += chunk.raw_size;
+		}
+		if (size != entry.size) {
+			throw invalid();
+		}
+		_entries[std::string(names + entry.name_offset, entry.name_size)] = &entry;
+	}
+}
+
+const ArchiveEntry* AssetArchive::find(const std::string& path) const {
+	auto it = _entries.find(archive_entry_name(path));
+	return it == _entries.end() ? nullptr : it->second;
+}
+
+bool AssetArchive::contains(const std::string& path) const {
+	return find(path) != nullptr;
+}
+
+bool AssetArchive::decompress(const ArchiveChunk& chunk, char* destination) const {
+	const char* source = _file.data() + chunk.offset;
+	if (chunk.stored_size == chunk.raw_size) {
+		std::memcpy(destination, source, chunk.raw_size);
+		return true;
+	}
+	return lz_decompress(source, chunk.stored_size, destination, chunk.raw_size);
+}
+
+std::shared_ptr<const Blob> AssetArchive::load(const std::string& path) const {
+	auto entry = find(path);
+	if (entry == nullptr) {
+		throw std::runtime_error("failed to find " + path + " in archive " + _path + "!");
+	}
+
+	// open() checked that the chunks are back to back, so such an entry is one range of the mapping
+	const ArchiveChunk* first = _chunks + entry->first_chunk;
+	const ArchiveChunk* last = first + entry->chunk_count;
+	bool stored = std::all_of(first, last, [](const ArchiveChunk& chunk) {
+		return chunk.stored_size == chunk.raw_size;
+	});
+	if (stored) {
+		const char* data = entry->chunk_count == 0 ? nullptr : _file.data() + first->offset;
+		return std::make_shared<MappedEntryBlob>(shared_from_this(), data, static_cast<size_t>(entry->size));
+	}
+
+	auto blob = std::make_shared<DecodedEntryBlob>(static_cast<size_t>(entry->size));
+	std::atomic<bool> decoded{true};
+	auto decode = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			if (!decompress(first[i], blob->storage() + i * _header->chunk_size)) {
+				decoded = false;
+			}
+		}
+	};
+	// loads may come from jobs themselves, waiting runs the other chunks meanwhile
+	if (_jobs != nullptr && entry->chunk_count > 1) {
+		_jobs->parallel_for(entry->chunk_count, 1, decode);
+	} else {
+		decode(0, entry->chunk_count);
+	}
+
+	if (!decoded) {
+		throw std::runtime_error("failed to decompress " + path + " from archive " + _path + "!");
+	}
+	return blob;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "blob_cache.h"
+
+class JobSystem;
+
+// Packed asset archive: every asset in one file, so a cold start opens one file
+// instead of dozens, which is what dominates on network mounts.
+//
+// Layout, little endian:
+//   ArchiveHeader
+//   entry data, each entry starting on an ARCHIVE_ALIGNMENT boundary; an entry is
+//     a run of chunks of at most chunk_size raw bytes, each LZ compressed or stored
+//   table of contents at toc_offset: ArchiveEntry[entry_count],
+//     ArchiveChunk[chunk_count], then the names of the entries back to back
+//
+// Chunks that do not compress are stored, and an entry of stored chunks only is
+// handed out straight from the mapped archive, e.g. PNGs, which are compressed already.
+
+static const char ARCHIVE_MAGIC[8] = {'V', 'K', 'A', 'S', 'S', 'E', 'T', 'S'};
+static const uint32_t ARCHIVE_VERSION = 1;
+// a page, so stored entries are mapped like loose files
+static const uint64_t ARCHIVE_ALIGNMENT = 4096;
+static const uint32_t ARCHIVE_DEFAULT_CHUNK_SIZE = 256 * 1024;
+
+struct ArchiveHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t chunk_size;
+	uint32_t entry_count;
+	uint32_t chunk_count;
+	uint64_t toc_offset;
+};
+
+struct ArchiveEntry {
+	uint64_t name_offset;
+	uint64_t size;
+	uint32_t name_size;
+	uint32_t first_chunk;
+	uint32_t chunk_count;
+	uint32_t reserved;
+};
+
+struct ArchiveChunk {
+	uint64_t offset;
+	// equal to raw_size when the chunk is stored
+	uint32_t stored_size;
+	uint32_t raw_size;
+};
+
+static_assert(sizeof(ArchiveHeader) == 32, "archive header layout");
+static_assert(sizeof(ArchiveEntry) == 32, "archive entry layout");
+static_assert(sizeof(ArchiveChunk) == 16, "archive chunk layout");
+
+// the name an asset is stored and looked up under, e.g. "assets/textures/viking_room.png"
+std::string archive_entry_name(const std::string& path);
+
+// Packs files into an archive at output, compressing their chunks on worker threads.
+void write_asset_archive(const std::string& output, const std::vector<std::string>& files, uint32_t chunk_size = ARCHIVE_DEFAULT_CHUNK_SIZE);
+
+// Maps an archive and hands out its entries. Entries of more than one compressed
+// chunk are decompressed on the job system's workers, one chunk per job, or on the
+// loading thread without one. Safe to use from several threads.
+class AssetArchive : public std::enable_shared_from_this<AssetArchive> {
+public:
+	// throws when the file is no valid archive
+	// jobs must outlive every load from the archive
+	static std::shared_ptr<AssetArchive> open(const std::string& path, JobSystem* jobs = nullptr);
+
+	bool contains(const std::string& path) const;
+	// the blob keeps the archive mapped as long as it lives; throws when there is no such entry
+	std::shared_ptr<const Blob> load(const std::string& path) const;
+
+	size_t size() const { return _entries.size(); }
+
+private:
+	AssetArchive(const std::string& path, JobSystem* jobs);
+
+	const ArchiveEntry* find(const std::string& path) const;
+	bool decompress(const ArchiveChunk& chunk, char* destination) const;
+
+private:
+	std::string _path;
+	FileBlob _file;
+	const ArchiveHeader* _header = nullptr;
+	const ArchiveChunk* _chunks = nullptr;
+	std::unordered_map<std::string, const ArchiveEntry*> _entries;
+	JobSystem* _jobs = nullptr;
+};
@@ -0,0 +1,182 @@
+#include <stdexcept>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "batch_renderer.h"
+#include "device_selector.h"
+#include "application.h"
+
+std::vector<BatchView> load_batch_views(const std::string& path) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open view list " + path + "!");
+	}
+
+	std::vector<BatchView> views;
+	std::string line;
+	size_t number = 0;
+	while (std::getline(file, line)) {
+		++number;
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		std::istringstream stream(line);
+		BatchView view{};
+		stream >> view.eye.x >> view.eye.y >> view.eye.z
+			>> view.target.x >> view.target.y >> view.target.z
+			>> view.width >> view.height >> view.output;
+		if (!stream || view.width == 0 || view.height == 0) {
+			throw std::runtime_error(path + ":" + std::to_string(number) + ": malformed view!");
+		}
+		views.push_back(view);
+	}
+	return views;
+}
+
+BatchQueue::BatchQueue(std::vector<BatchView> views)
+	: _views(std::move(views)) {
+	std::stable_sort(_views.begin(), _views.end(), [](const BatchView& a, const BatchView& b) {
+		return std::make_pair(a.width, a.height) < std::make_pair(b.width, b.height);
+	});
+}
+
+bool BatchQueue::pop(BatchView& view) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_next == _views.size()) {
+		return false;
+	}
+	view = _views[_next++];
+	return true;
+}
+
+ImageWriter::ImageWriter(size_t thread_count, size_t max_pending)
+	: _max_pending(max_pending), _pool(thread_count) {
+}
+
+void ImageWriter::write_png(const std::string& path, uint32_t width, uint32_t height, std::vector<uint8_t>&& rgba) {
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_slot_free.wait(lock, [this] { return _pending < _max_pending; });
+		++_pending;
+	}
+
+	_pool.submit([this, path, width, height, pixels = std::move(rgba)]() {
+		int stride = static_cast<int>(width) * 4;
+		if (stbi_write_png(path.c_str(), static_cast<int>(width), static_cast<int>(height), 4, pixels.data(), stride) != 0) {
+			++_written;
+		} else {
+			std::cerr << "failed to write " << path << std::endl;
+			++_failed;
+		}
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		--_pending;
+		_slot_free.notify_one();
+	});
+}
+
+void ImageWriter::wait_idle() {
+	_pool.wait_idle();
+}
+
+// resolves a device list to enumeration indices with a throwaway instance, so each
+// worker can pin its own instance to one device; suitability is checked by the worker
+static std::vector<std::string> resolve_devices(const std::string& devices) {
+	VkApplicationInfo appInfo{};
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.apiVersion = VK_API_VERSION_1_3;
+
+	VkInstanceCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	createInfo.pApplicationInfo = &appInfo;
+
+	VkInstance instance;
+	if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create instance!");
+	}
+
+	uint32_t count = 0;
+	vkEnumeratePhysicalDevices(instance, &count, nullptr);
+	std::vector<VkPhysicalDevice> physicalDevices(count);
+	vkEnumeratePhysicalDevices(instance, &count, physicalDevices.data());
+
+	DeviceSelector selector;
+	selector.rank(physicalDevices, [](VkPhysicalDevice) {
+		return true;
+	});
+
+	std::vector<std::string> indices;
+	for (const auto& candidate : selector.select_many(devices)) {
+		indices.push_back(std::to_string(candidate.index));
+	}
+
+	vkDestroyInstance(instance, nullptr);
+	return indices;
+}
+
+int run_batch(const BatchSettings& settings) {
+	auto views = load_batch_views(settings.views_path);
+	if (!settings.output_dir.empty()) {
+		for (auto& view : views) {
+			view.output = settings.output_dir + "/" + view.output;
+		}
+	}
+
+	BatchQueue queue(std::move(views));
+	ImageWriter writer;
+
+	// one worker per device, each with its own instance, device and pipelines
+	std::vector<std::string> devices = {""};
+	if (!settings.devices.empty()) {
+		devices = resolve_devices(settings.devices);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> workers;
+	std::atomic<size_t> failedWorkers{0};
+	for (const auto& device : devices) {
+		workers.emplace_back([&settings, &queue, &writer, &failedWorkers, device, workerCount = devices.size()]() {
+			Application app;
+			settings.configure(app);
+			if (!device.empty()) {
+				app.set_device(device);
+			}
+			// pipeline caches are per device, workers must not write the same file
+			if (workerCount > 1) {
+				app.set_pipeline_cache_path("pipeline_cache_" + device + ".bin");
+			}
+			app.set_batch(&queue, &writer);
+
+			try {
+				app.run();
+			} catch (std::exception& e) {
+				std::cerr << "render worker on device " << (device.empty() ? "default" : device) << " failed: " << e.what() << std::endl;
+				++failedWorkers;
+			}
+		});
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	writer.wait_idle();
+
+	auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << writer.written() << " of " << queue.size() << " images in " << seconds << " s, "
+		<< writer.written() / seconds << " images/s on " << devices.size() - failedWorkers << " device(s)" << std::endl;
+
+	bool complete = writer.written() == queue.size() && writer.failed() == 0;
+	if (complete && !settings.golden.golden_dir.empty()) {
+		complete = compare_with_goldens(queue.views(), settings.golden) == 0;
+	}
+	return complete ? EXIT_SUCCESS : EXIT_FAILURE;
+}
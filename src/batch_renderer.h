@@ -0,0 +1,91 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+
+#include "thread_pool.h"
+#include "golden_compare.h"
+
+class Application;
+
+// One image of a batch: the camera, the output size and the file it goes to.
+struct BatchView {
+	glm::vec3 eye;
+	glm::vec3 target;
+	uint32_t width;
+	uint32_t height;
+	std::string output;
+};
+
+// Reads a view list with one view per line:
+//   eye_x eye_y eye_z target_x target_y target_z width height output.png
+// Empty lines and lines starting with # are skipped.
+std::vector<BatchView> load_batch_views(const std::string& path);
+
+// Hands the views of a batch out to the render workers. The views are sorted by
+// size, so a worker only rebuilds its size dependent resources when the size changes.
+class BatchQueue {
+public:
+	explicit BatchQueue(std::vector<BatchView> views);
+
+	// false once every view was handed out
+	bool pop(BatchView& view);
+	size_t size() const { return _views.size(); }
+	const std::vector<BatchView>& views() const { return _views; }
+
+private:
+	std::mutex _mutex;
+	std::vector<BatchView> _views;
+	size_t _next = 0;
+};
+
+// Encodes PNGs on a pool of worker threads. write_png() blocks while max_pending
+// images are queued, so rendering never runs arbitrarily far ahead of the encoders.
+class ImageWriter {
+public:
+	explicit ImageWriter(size_t thread_count = 0, size_t max_pending = 64);
+
+	// rgba holds width * height tightly packed RGBA8 pixels
+	void write_png(const std::string& path, uint32_t width, uint32_t height, std::vector<uint8_t>&& rgba);
+	void wait_idle();
+
+	size_t written() const { return _written; }
+	size_t failed() const { return _failed; }
+
+private:
+	size_t _max_pending;
+
+	std::mutex _mutex;
+	std::condition_variable _slot_free;
+	size_t _pending = 0;
+
+	std::atomic<size_t> _written{0};
+	std::atomic<size_t> _failed{0};
+
+	// last, so its destructor drains the queue while the members above still exist
+	ThreadPool _pool;
+};
+
+struct BatchSettings {
+	std::string views_path;
+	// prepended to the output file of every view
+	std::string output_dir;
+	// empty for the one device the selector picks, "all" or a comma separated list
+	// of indices and names for one render worker per device
+	std::string devices;
+	// applies the remaining command line options to every worker
+	std::function<void(Application&)> configure;
+	// compares the images with goldens once the batch is written, when it has a directory
+	GoldenSettings golden;
+};
+
+// Renders every view of settings.views_path without a window and prints the throughput.
+// Returns the process exit code, which is a failure too when an image misses its golden.
+int run_batch(const BatchSettings& settings);
@@ -0,0 +1,164 @@
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "blob_cache.h"
+#include "asset_archive.h"
+
+#ifdef _WIN32
+
+FileBlob::FileBlob(const std::string& path) {
+	_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (_file == INVALID_HANDLE_VALUE) {
+		_file = nullptr;
+		throw std::runtime_error("failed to open file " + path + "!");
+	}
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(_file, &size);
+	_size = static_cast<size_t>(size.QuadPart);
+	// an empty file can not be mapped and has nothing to map
+	if (_size == 0) {
+		return;
+	}
+
+	_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (_mapping != nullptr) {
+		_data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+	}
+	if (_data == nullptr) {
+		if (_mapping != nullptr) {
+			CloseHandle(_mapping);
+		}
+		CloseHandle(_file);
+		throw std::runtime_error("failed to map file " + path + "!");
+	}
+}
+
+FileBlob::~FileBlob() {
+	if (_data != nullptr) {
+		UnmapViewOfFile(_data);
+	}
+	if (_mapping != nullptr) {
+		CloseHandle(_mapping);
+	}
+	if (_file != nullptr) {
+		CloseHandle(_file);
+	}
+}
+
+#else
+
+FileBlob::FileBlob(const std::string& path) {
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("failed to open file " + path + "!");
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		::close(fd);
+		throw std::runtime_error("failed to open file " + path + "!");
+	}
+	_size = static_cast<size_t>(info.st_size);
+	// an empty file can not be mapped and has nothing to map
+	if (_size == 0) {
+		::close(fd);
+		return;
+	}
+
+	void* mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file alive on its own
+	::close(fd);
+	if (mapped == MAP_FAILED) {
+		throw std::runtime_error("failed to map file " + path + "!");
+	}
+	// loaders read front to back: read ahead aggressively and start it now
+	madvise(mapped, _size, MADV_SEQUENTIAL);
+	madvise(mapped, _size, MADV_WILLNEED);
+	_data = static_cast<const char*>(mapped);
+}
+
+FileBlob::~FileBlob() {
+	if (_data != nullptr) {
+		munmap(const_cast<char*>(_data), _size);
+	}
+}
+
+#endif
+
+std::shared_ptr<const Blob> BlobCache::load(const std::string& path) {
+	std::shared_ptr<const AssetArchive> archive;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = _entries.find(path);
+		if (it != _entries.end() && it->second.archived) {
+			++_hits;
+			return it->second.blob;
+		}
+		if (_archive && _disk_overrides.count(path) == 0 && _archive->contains(path)) {
+			archive = _archive;
+		}
+	}
+
+	if (archive) {
+		// decompressed outside the lock, so loads of other files go on meanwhile
+		auto blob = archive->load(path);
+		std::lock_guard<std::mutex> lock(_mutex);
+		++_misses;
+		auto& entry = _entries[path];
+		// another thread may have loaded it at the same time
+		if (!entry.archived) {
+			entry.blob = blob;
+			entry.archived = true;
+		}
+		return entry.blob;
+	}
+
+	std::error_code error;
+	auto writeTime = std::filesystem::last_write_time(path, error);
+	auto size = std::filesystem::file_size(path, error);
+	if (error) {
+		throw std::runtime_error("failed to open file " + path + "!");
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto it = _entries.find(path);
+	if (it != _entries.end() && !it->second.archived && it->second.write_time == writeTime && it->second.size == size) {
+		++_hits;
+		return it->second.blob;
+	}
+
+	++_misses;
+	Entry entry;
+	entry.blob = std::make_shared<const FileBlob>(path);
+	entry.write_time = writeTime;
+	entry.size = size;
+	// a stale blob is only replaced here, whoever still holds it keeps the old contents
+	_entries[path] = entry;
+	return entry.blob;
+}
+
+void BlobCache::mount(std::shared_ptr<const AssetArchive> archive) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_archive = std::move(archive);
+}
+
+void BlobCache::reload_from_disk(const std::string& path) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_disk_overrides.insert(path);
+	// a loose file entry is checked against the disk anyway, an archived one must go
+	auto it = _entries.find(path);
+	if (it != _entries.end() && it->second.archived) {
+		_entries.erase(it);
+	}
+}
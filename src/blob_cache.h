@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <span>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+
+class AssetArchive;
+
+// Read only contents of a loaded file, wherever they live.
+class Blob {
+public:
+	virtual ~Blob() = default;
+
+	// page aligned when mapped, at least 16 byte aligned otherwise; enough for SPIR-V's words
+	const char* data() const { return _data; }
+	size_t size() const { return _size; }
+	std::span<const char> span() const { return {_data, _size}; }
+
+protected:
+	const char* _data = nullptr;
+	size_t _size = 0;
+};
+
+// A read only file mapped into memory. The pages are read by the kernel as they
+// are touched, hinted as sequential and needed soon, so a loader reading the
+// file front to back runs at page cache speed without copying it first.
+class FileBlob : public Blob {
+public:
+	// throws when the file can not be opened or mapped
+	explicit FileBlob(const std::string& path);
+	~FileBlob() override;
+
+	FileBlob(const FileBlob&) = delete;
+	FileBlob& operator=(const FileBlob&) = delete;
+
+private:
+#ifdef _WIN32
+	void* _file = nullptr;
+	void* _mapping = nullptr;
+#endif
+};
+
+// Shares the mapping of a file between everything loading it. Mappings stay in the
+// cache once loaded; their pages are clean, so under memory pressure the kernel
+// drops them and reads them back later. An entry is mapped again when the file
+// changed on disk; replacing a file by renaming a new one over it, as the shader
+// manager does, leaves blobs that are still held intact.
+// With an archive mounted, files it contains are served from it without touching
+// the file system, except for the ones reload_from_disk() was called for.
+// Safe to use from several threads.
+class BlobCache {
+public:
+	std::shared_ptr<const Blob> load(const std::string& path);
+
+	void mount(std::shared_ptr<const AssetArchive> archive);
+	// the file changed on disk, e.g. a recompiled shader, and now shadows the archive's copy
+	void reload_from_disk(const std::string& path);
+
+	size_t hits() const { return _hits; }
+	size_t misses() const { return _misses; }
+
+private:
+	struct Entry {
+		std::shared_ptr<const Blob> blob;
+		// archive entries never change, only loose files are checked again
+		bool archived = false;
+		std::filesystem::file_time_type write_time;
+		uintmax_t size = 0;
+	};
+
+	std::mutex _mutex;
+	std::unordered_map<std::string, Entry> _entries;
+	std::shared_ptr<const AssetArchive> _archive;
+	std::unordered_set<std::string> _disk_overrides;
+	std::atomic<size_t> _hits{0};
+	std::atomic<size_t> _misses{0};
+};
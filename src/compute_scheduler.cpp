@@ -0,0 +1,147 @@
+#include <stdexcept>
+
+#include "compute_scheduler.h"
+
+void ComputeScheduler::init(VkDevice device, uint32_t graphics_family, uint32_t compute_family, VkQueue compute_queue, uint32_t frames_in_flight) {
+	_device = device;
+	_compute_queue = compute_queue;
+
+	_queue_families = {graphics_family};
+	if (!async()) {
+		return;
+	}
+	_queue_families.push_back(compute_family);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = compute_family;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if (vkCreateCommandPool(_device, &poolInfo, nullptr, &_command_pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create compute command pool!");
+	}
+
+	_command_buffers.resize(frames_in_flight);
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = _command_pool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = frames_in_flight;
+
+	if (vkAllocateCommandBuffers(_device, &allocInfo, _command_buffers.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate compute command buffers!");
+	}
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	_finished_semaphores.resize(frames_in_flight);
+	for (auto& semaphore : _finished_semaphores) {
+		if (vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute semaphore!");
+		}
+	}
+}
+
+void ComputeScheduler::destroy() {
+	for (auto semaphore : _finished_semaphores) {
+		vkDestroySemaphore(_device, semaphore, nullptr);
+	}
+	_finished_semaphores.clear();
+
+	if (_command_pool != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(_device, _command_pool, nullptr);
+		_command_pool = VK_NULL_HANDLE;
+	}
+	_command_buffers.clear();
+	_passes.clear();
+}
+
+void ComputeScheduler::schedule(const std::string& name, VkPipelineStageFlags consumer_stage, VkAccessFlags consumer_access, RecordFunction record) {
+	_passes.push_back({name, consumer_stage, consumer_access, std::move(record)});
+}
+
+void ComputeScheduler::flush(uint32_t frame, VkCommandBuffer graphics_command_buffer) {
+	_wait_semaphores.clear();
+	_wait_stages.clear();
+	if (_passes.empty()) {
+		return;
+	}
+
+	VkPipelineStageFlags consumerStages = 0;
+	VkAccessFlags consumerAccess = 0;
+	for (const auto& pass : _passes) {
+		consumerStages |= pass.consumer_stage;
+		consumerAccess |= pass.consumer_access;
+	}
+
+	if (!async()) {
+		record_passes(graphics_command_buffer);
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = consumerAccess;
+		vkCmdPipelineBarrier(graphics_command_buffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, consumerStages,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+		_passes.clear();
+		return;
+	}
+
+	// the graphics fence of this slot was waited on, and graphics waited for this buffer
+	auto commandBuffer = _command_buffers[frame];
+	vkResetCommandBuffer(commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording compute command buffer!");
+	}
+	record_passes(commandBuffer);
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record compute command buffer!");
+	}
+
+	// a semaphore signal makes every write before it available, the wait makes them
+	// visible to the consumer stages, so no barrier is needed on either side
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &_finished_semaphores[frame];
+
+	if (vkQueueSubmit(_compute_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit compute command buffer!");
+	}
+
+	_wait_semaphores.push_back(_finished_semaphores[frame]);
+	_wait_stages.push_back(consumerStages);
+	_passes.clear();
+}
+
+void ComputeScheduler::record_passes(VkCommandBuffer command_buffer) {
+	for (size_t i = 0; i < _passes.size(); ++i) {
+		// passes run in the order they were scheduled and may read what earlier ones wrote
+		if (i > 0) {
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(command_buffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0,
+				1, &barrier,
+				0, nullptr,
+				0, nullptr);
+		}
+		_passes[i].record(command_buffer);
+	}
+}
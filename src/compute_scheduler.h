@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+// Per-frame compute work (culling, simulation, post-processing) that graphics consumes.
+// On devices with a dedicated compute queue family the passes of a frame are recorded
+// into their own command buffer and submitted on that queue, signalling a semaphore the
+// graphics submit waits on, so they overlap with the raster work of the previous frame.
+// With a single queue family they are recorded inline at the start of the graphics
+// command buffer behind one pipeline barrier, and nothing else changes for the caller.
+//
+// The graphics submit of a frame slot always waits for its compute submit, so the
+// graphics fence of the slot also covers the compute command buffer.
+class ComputeScheduler {
+public:
+	using RecordFunction = std::function<void(VkCommandBuffer)>;
+
+	// compute_queue is VK_NULL_HANDLE when the device has no dedicated compute family
+	void init(VkDevice device, uint32_t graphics_family, uint32_t compute_family, VkQueue compute_queue, uint32_t frames_in_flight);
+	void destroy();
+
+	bool async() const { return _compute_queue != VK_NULL_HANDLE; }
+
+	// buffers shared by compute passes and graphics are created with these, CONCURRENT
+	// sharing when there are two families, so no ownership transfers are needed
+	VkSharingMode sharing_mode() const { return _queue_families.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE; }
+	const std::vector<uint32_t>& queue_families() const { return _queue_families; }
+
+	// queues a pass for the current frame; consumer_stage and consumer_access describe
+	// the first graphics use of what the pass writes
+	void schedule(const std::string& name, VkPipelineStageFlags consumer_stage, VkAccessFlags consumer_access, RecordFunction record);
+
+	// records the passes scheduled since the last flush. Async, they are submitted right
+	// away and the graphics submit must wait on wait_semaphores() with wait_stages(); inline,
+	// they go into graphics_command_buffer, which must be in the recording state.
+	void flush(uint32_t frame, VkCommandBuffer graphics_command_buffer);
+
+	// empty when the last flush had nothing to wait for
+	const std::vector<VkSemaphore>& wait_semaphores() const { return _wait_semaphores; }
+	const std::vector<VkPipelineStageFlags>& wait_stages() const { return _wait_stages; }
+
+private:
+	struct ScheduledPass {
+		std::string name;
+		VkPipelineStageFlags consumer_stage;
+		VkAccessFlags consumer_access;
+		RecordFunction record;
+	};
+
+	void record_passes(VkCommandBuffer command_buffer);
+
+private:
+	VkDevice _device = VK_NULL_HANDLE;
+	VkQueue _compute_queue = VK_NULL_HANDLE;
+	std::vector<uint32_t> _queue_families;
+
+	VkCommandPool _command_pool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> _command_buffers;
+	std::vector<VkSemaphore> _finished_semaphores;
+
+	std::vector<ScheduledPass> _passes;
+	std::vector<VkSemaphore> _wait_semaphores;
+	std::vector<VkPipelineStageFlags> _wait_stages;
+};
@@ -0,0 +1,246 @@
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+
+#include "descriptor_allocator.h"
+
+static const uint32_t MAX_SETS_PER_POOL = 4096;
+
+void DescriptorAllocator::init(VkDevice device, uint32_t initial_sets) {
+	_device = device;
+	_initial_sets = initial_sets;
+}
+
+void DescriptorAllocator::destroy() {
+	for (auto& [layout, pools] : _layouts) {
+		for (auto pool : pools.ready_pools) {
+			vkDestroyDescriptorPool(_device, pool, nullptr);
+		}
+		for (auto pool : pools.full_pools) {
+			vkDestroyDescriptorPool(_device, pool, nullptr);
+		}
+	}
+	_layouts.clear();
+}
+
+void DescriptorAllocator::register_layout(VkDescriptorSetLayout layout,
+		const VkDescriptorSetLayoutBinding* bindings,
+		uint32_t binding_count,
+		VkDescriptorPoolCreateFlags pool_flags,
+		bool variable_count) {
+
+	LayoutPools pools;
+	pools.flags = pool_flags;
+	pools.sets_per_pool = _initial_sets;
+	pools.variable_count = variable_count;
+
+	for (uint32_t i = 0; i < binding_count; ++i) {
+		auto it = std::find_if(pools.sizes_per_set.begin(), pools.sizes_per_set.end(), [type = bindings[i].descriptorType](const VkDescriptorPoolSize& size) {
+			return size.type == type;
+		});
+		if (it != pools.sizes_per_set.end()) {
+			it->descriptorCount += bindings[i].descriptorCount;
+		} else {
+			pools.sizes_per_set.push_back({bindings[i].descriptorType, bindings[i].descriptorCount});
+		}
+	}
+
+	_layouts[layout] = std::move(pools);
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout, uint32_t variable_count) {
+	auto it = _layouts.find(layout);
+	if (it == _layouts.end()) {
+		throw std::runtime_error("descriptor set layout not registered!");
+	}
+	auto& pools = it->second;
+
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	auto pool = grab_pool(pools);
+	auto result = try_allocate(pool, layout, variable_count, pools.variable_count, set);
+
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+		pools.ready_pools.pop_back();
+		pools.full_pools.push_back(pool);
+
+		pool = grab_pool(pools);
+		result = try_allocate(pool, layout, variable_count, pools.variable_count, set);
+	}
+
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate descriptor set!");
+	}
+
+	return set;
+}
+
+void DescriptorAllocator::reset() {
+	for (auto& [layout, pools] : _layouts) {
+		for (auto pool : pools.ready_pools) {
+			vkResetDescriptorPool(_device, pool, 0);
+		}
+		for (auto pool : pools.full_pools) {
+			vkResetDescriptorPool(_device, pool, 0);
+			pools.ready_pools.push_back(pool);
+		}
+		pools.full_pools.clear();
+	}
+}
+
+VkDescriptorPool DescriptorAllocator::grab_pool(LayoutPools& pools) {
+	if (pools.ready_pools.empty()) {
+		pools.ready_pools.push_back(create_pool(pools));
+		// every new pool is larger than the last, so a busy layout settles on a few big pools
+		pools.sets_per_pool = std::min(pools.sets_per_pool * 2, MAX_SETS_PER_POOL);
+	}
+
+	return pools.ready_pools.back();
+}
+
+VkDescriptorPool DescriptorAllocator::create_pool(const LayoutPools& pools) {
+	// sets with a variable sized binding are few and large, so don't multiply their size
+	uint32_t set_count = pools.variable_count ? 1 : pools.sets_per_pool;
+
+	std::vector<VkDescriptorPoolSize> sizes = pools.sizes_per_set;
+	for (auto& size : sizes) {
+		size.descriptorCount *= set_count;
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = pools.flags;
+	poolInfo.maxSets = set_count;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+	poolInfo.pPoolSizes = sizes.data();
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor pool!");
+	}
+
+	return pool;
+}
+
+VkResult DescriptorAllocator::try_allocate(VkDescriptorPool pool, VkDescriptorSetLayout layout, uint32_t variable_count, bool variable, VkDescriptorSet& set) {
+	VkDescriptorSetVariableDescriptorCountAllocateInfo countInfo{};
+	countInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+	countInfo.descriptorSetCount = 1;
+	countInfo.pDescriptorCounts = &variable_count;
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.pNext = variable ? &countInfo : nullptr;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	return vkAllocateDescriptorSets(_device, &allocInfo, &set);
+}
+
+DescriptorBinding DescriptorBinding::buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+	DescriptorBinding b{};
+	b.binding = binding;
+	b.type = type;
+	b.buffer_info.buffer = buffer;
+	b.buffer_info.offset = offset;
+	b.buffer_info.range = range;
+	return b;
+}
+
+DescriptorBinding DescriptorBinding::image(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout) {
+	DescriptorBinding b{};
+	b.binding = binding;
+	b.type = type;
+	b.image_info.imageView = view;
+	b.image_info.sampler = sampler;
+	b.image_info.imageLayout = layout;
+	return b;
+}
+
+bool DescriptorBinding::operator==(const DescriptorBinding& other) const {
+	return binding == other.binding
+		&& type == other.type
+		&& buffer_info.buffer == other.buffer_info.buffer
+		&& buffer_info.offset == other.buffer_info.offset
+		&& buffer_info.range == other.buffer_info.range
+		&& image_info.imageView == other.image_info.imageView
+		&& image_info.sampler == other.image_info.sampler
+		&& image_info.imageLayout == other.image_info.imageLayout;
+}
+
+template <class T>
+static void hash_combine(size_t& seed, const T& value) {
+	seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+size_t DescriptorCache::KeyHash::operator()(const Key& key) const {
+	size_t seed = std::hash<VkDescriptorSetLayout>()(key.layout);
+	for (const auto& b : key.bindings) {
+		hash_combine(seed, b.binding);
+		hash_combine(seed, static_cast<uint32_t>(b.type));
+		hash_combine(seed, b.buffer_info.buffer);
+		hash_combine(seed, b.buffer_info.offset);
+		hash_combine(seed, b.buffer_info.range);
+		hash_combine(seed, b.image_info.imageView);
+		hash_combine(seed, b.image_info.sampler);
+	}
+	return seed;
+}
+
+void DescriptorCache::init(VkDevice device, DescriptorAllocator* allocator) {
+	_device = device;
+	_allocator = allocator;
+}
+
+VkDescriptorSet DescriptorCache::get(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings) {
+	Key key{layout, bindings};
+	auto it = _sets.find(key);
+	if (it != _sets.end()) {
+		return it->second;
+	}
+
+	VkDescriptorSet set;
+	auto& freeSets = _free_sets[layout];
+	if (!freeSets.empty()) {
+		set = freeSets.back();
+		freeSets.pop_back();
+	} else {
+		set = _allocator->allocate(layout);
+	}
+
+	std::vector<VkWriteDescriptorSet> writes(bindings.size());
+	for (size_t i = 0; i < bindings.size(); ++i) {
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = set;
+		writes[i].dstBinding = bindings[i].binding;
+		writes[i].dstArrayElement = 0;
+		writes[i].descriptorType = bindings[i].type;
+		writes[i].descriptorCount = 1;
+		if (bindings[i].buffer_info.buffer != VK_NULL_HANDLE) {
+			writes[i].pBufferInfo = &bindings[i].buffer_info;
+		} else {
+			writes[i].pImageInfo = &bindings[i].image_info;
+		}
+	}
+	vkUpdateDescriptorSets(_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	_sets.emplace(std::move(key), set);
+	return set;
+}
+
+void DescriptorCache::forget(VkDescriptorSetLayout layout) {
+	auto& freeSets = _free_sets[layout];
+	std::erase_if(_sets, [layout, &freeSets](const auto& entry) {
+		if (entry.first.layout != layout) {
+			return false;
+		}
+		freeSets.push_back(entry.second);
+		return true;
+	});
+}
+
+void DescriptorCache::reset() {
+	_sets.clear();
+	_free_sets.clear();
+	_allocator->reset();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <unordered_map>
+
+// Hands out descriptor sets from pools that are sized per layout and grow on demand.
+// A full pool is never an error: the allocator moves on to a new, larger pool.
+class DescriptorAllocator {
+public:
+	void init(VkDevice device, uint32_t initial_sets = 16);
+	void destroy();
+
+	// pools for a layout are sized from its bindings, so every layout must be registered first
+	void register_layout(VkDescriptorSetLayout layout,
+		const VkDescriptorSetLayoutBinding* bindings,
+		uint32_t binding_count,
+		VkDescriptorPoolCreateFlags pool_flags = 0,
+		bool variable_count = false);
+
+	// variable_count is only used for layouts with a variable sized last binding
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout, uint32_t variable_count = 0);
+
+	// returns every set to its pool; pools are kept for reuse
+	void reset();
+
+private:
+	struct LayoutPools {
+		std::vector<VkDescriptorPoolSize> sizes_per_set;
+		VkDescriptorPoolCreateFlags flags = 0;
+		bool variable_count = false;
+		uint32_t sets_per_pool = 0;
+		std::vector<VkDescriptorPool> ready_pools;
+		std::vector<VkDescriptorPool> full_pools;
+	};
+
+	VkDescriptorPool grab_pool(LayoutPools& pools);
+	VkDescriptorPool create_pool(const LayoutPools& pools);
+	VkResult try_allocate(VkDescriptorPool pool, VkDescriptorSetLayout layout, uint32_t variable_count, bool variable, VkDescriptorSet& set);
+
+private:
+	VkDevice _device = VK_NULL_HANDLE;
+	uint32_t _initial_sets = 16;
+	std::unordered_map<VkDescriptorSetLayout, LayoutPools> _layouts;
+};
+
+struct DescriptorBinding {
+	uint32_t binding;
+	VkDescriptorType type;
+	VkDescriptorBufferInfo buffer_info;
+	VkDescriptorImageInfo image_info;
+
+	static DescriptorBinding buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+	static DescriptorBinding image(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout);
+
+	bool operator==(const DescriptorBinding& other) const;
+};
+
+// Caches fully written descriptor sets keyed by their layout and bindings, so asking
+// twice for the same resources returns the same set without touching the pools.
+class DescriptorCache {
+public:
+	void init(VkDevice device, DescriptorAllocator* allocator);
+
+	VkDescriptorSet get(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings);
+
+	// forgets the cached sets of layout, e.g. when buffers they point to were destroyed;
+	// get() rewrites and hands them out again, so none may still be in use by the device
+	void forget(VkDescriptorSetLayout layout);
+
+	// forgets every cached set and resets the backing allocator
+	void reset();
+
+private:
+	struct Key {
+		VkDescriptorSetLayout layout;
+		std::vector<DescriptorBinding> bindings;
+
+		bool operator==(const Key& other) const {
+			return layout == other.layout && bindings == other.bindings;
+		}
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key& key) const;
+	};
+
+private:
+	VkDevice _device = VK_NULL_HANDLE;
+	DescriptorAllocator* _allocator = nullptr;
+	std::unordered_map<Key, VkDescriptorSet, KeyHash> _sets;
+	// forgotten sets per layout, reused before allocating new ones
+	std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> _free_sets;
+};
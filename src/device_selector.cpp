@@ -0,0 +1,179 @@
+#include <stdexcept>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <cctype>
+#include <sstream>
+
+#include "device_selector.h"
+
+static const char* DEVICE_ENVIRONMENT_VARIABLE = "VULKAN_DEVICE";
+
+static std::string to_lower(std::string text) {
+	std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) {
+		return static_cast<char>(std::tolower(c));
+	});
+	return text;
+}
+
+static const char* type_name(VkPhysicalDeviceType type) {
+	switch (type) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+	case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+	default: return "other";
+	}
+}
+
+void DeviceSelector::rank(const std::vector<VkPhysicalDevice>& devices, const SuitableFunction& suitable) {
+	_candidates.clear();
+	for (uint32_t i = 0; i < devices.size(); ++i) {
+		DeviceCandidate candidate;
+		candidate.device = devices[i];
+		candidate.index = i;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(devices[i], &properties);
+		candidate.name = properties.deviceName;
+		candidate.type = properties.deviceType;
+		// dynamic rendering is core from 1.3; older devices with the extension just score lower
+		candidate.dynamic_rendering = properties.apiVersion >= VK_API_VERSION_1_3;
+
+		// integrated GPUs report system memory as device local, the type score keeps them behind
+		VkPhysicalDeviceMemoryProperties memory;
+		vkGetPhysicalDeviceMemoryProperties(devices[i], &memory);
+		for (uint32_t h = 0; h < memory.memoryHeapCount; ++h) {
+			if (memory.memoryHeaps[h].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+				candidate.device_local_bytes += memory.memoryHeaps[h].size;
+			}
+		}
+
+		uint32_t familyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &familyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> families(familyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &familyCount, families.data());
+		for (const auto& family : families) {
+			if ((family.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(family.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+				candidate.async_compute = true;
+			}
+		}
+
+		candidate.suitable = suitable(devices[i]);
+		candidate.score = score(candidate);
+		_candidates.push_back(candidate);
+	}
+
+	// stable, so equal scores keep the driver's order
+	std::stable_sort(_candidates.begin(), _candidates.end(), [](const DeviceCandidate& a, const DeviceCandidate& b) {
+		if (a.suitable != b.suitable) {
+			return a.suitable;
+		}
+		return a.score > b.score;
+	});
+}
+
+uint64_t DeviceSelector::score(const DeviceCandidate& candidate) {
+	uint64_t score = 0;
+	switch (candidate.type) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score += 100000; break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 50000; break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score += 25000; break;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU: score += 1000; break;
+	default: break;
+	}
+
+	// one point per 64 MiB, capped so memory never outweighs a device type
+	score += std::min<uint64_t>(candidate.device_local_bytes >> 26, 20000);
+
+	if (candidate.async_compute) {
+		score += 500;
+	}
+	if (candidate.dynamic_rendering) {
+		score += 250;
+	}
+	return score;
+}
+
+const DeviceCandidate* DeviceSelector::find(const std::string& override_value) const {
+	// an index refers to the enumeration order, everything else to the device name
+	bool numeric = !override_value.empty() && std::all_of(override_value.begin(), override_value.end(), [](unsigned char c) {
+		return std::isdigit(c);
+	});
+
+	for (const auto& candidate : _candidates) {
+		if (numeric) {
+			if (candidate.index == static_cast<uint32_t>(std::stoul(override_value))) {
+				return &candidate;
+			}
+		} else if (to_lower(candidate.name).find(to_lower(override_value)) != std::string::npos) {
+			return &candidate;
+		}
+	}
+	return nullptr;
+}
+
+const DeviceCandidate& DeviceSelector::select(const std::string& cli_override) {
+	std::string override_value = cli_override;
+	_reason = "--device";
+	if (override_value.empty()) {
+		const char* environment = std::getenv(DEVICE_ENVIRONMENT_VARIABLE);
+		override_value = environment != nullptr ? environment : "";
+		_reason = DEVICE_ENVIRONMENT_VARIABLE;
+	}
+
+	if (!override_value.empty()) {
+		auto candidate = find(override_value);
+		if (candidate == nullptr) {
+			throw std::runtime_error("no device matches " + _reason + "=" + override_value + "!");
+		}
+		if (!candidate->suitable) {
+			throw std::runtime_error("device " + candidate->name + " chosen by " + _reason + " is not suitable!");
+		}
+		return *candidate;
+	}
+
+	if (_candidates.empty() || !_candidates.front().suitable) {
+		throw std::runtime_error("no suitable device");
+	}
+	_reason = "highest score";
+	return _candidates.front();
+}
+
+std::vector<DeviceCandidate> DeviceSelector::select_many(const std::string& overrides) {
+	std::vector<DeviceCandidate> selected;
+	if (overrides.empty() || overrides == "all") {
+		for (const auto& candidate : _candidates) {
+			if (candidate.suitable) {
+				selected.push_back(candidate);
+			}
+		}
+		if (selected.empty()) {
+			throw std::runtime_error("no suitable device");
+		}
+		return selected;
+	}
+
+	std::stringstream stream(overrides);
+	std::string item;
+	while (std::getline(stream, item, ',')) {
+		selected.push_back(select(item));
+	}
+	return selected;
+}
+
+void DeviceSelector::log(const DeviceCandidate& chosen) const {
+	for (const auto& candidate : _candidates) {
+		std::cout << (candidate.device == chosen.device ? "* " : "  ")
+			<< "[" << candidate.index << "] " << candidate.name
+			<< " (" << type_name(candidate.type) << ", " << (candidate.device_local_bytes >> 20) << " MiB"
+			<< (candidate.async_compute ? ", async compute" : "")
+			<< (candidate.dynamic_rendering ? ", 1.3" : "") << ") ";
+		if (candidate.suitable) {
+			std::cout << "score " << candidate.score << std::endl;
+		} else {
+			std::cout << "not suitable" << std::endl;
+		}
+	}
+	std::cout << "using " << chosen.name << ", chosen by " << _reason << std::endl;
+}
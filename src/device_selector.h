@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+// One physical device as seen by the selector, with what its score was made of.
+struct DeviceCandidate {
+	VkPhysicalDevice device = VK_NULL_HANDLE;
+	// position in vkEnumeratePhysicalDevices order, what an index override refers to
+	uint32_t index = 0;
+	std::string name;
+	VkPhysicalDeviceType type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+	VkDeviceSize device_local_bytes = 0;
+	bool async_compute = false;
+	bool dynamic_rendering = false;
+	bool suitable = false;
+	uint64_t score = 0;
+};
+
+// Ranks the physical devices of an instance instead of taking the first one that
+// works, which on many machines is the integrated GPU or a software rasterizer.
+// The device type dominates the score, then device local memory, then queue and
+// feature extras. The choice can be overridden by the VULKAN_DEVICE environment
+// variable or a command line value, each either an enumeration index or part of
+// the device name.
+class DeviceSelector {
+public:
+	using SuitableFunction = std::function<bool(VkPhysicalDevice)>;
+
+	// scores every device, given in enumeration order; suitable ones come first, best first
+	void rank(const std::vector<VkPhysicalDevice>& devices, const SuitableFunction& suitable);
+
+	// the command line override wins over the environment; throws when an override
+	// matches nothing or an unsuitable device, and when no device is suitable at all
+	const DeviceCandidate& select(const std::string& cli_override = "");
+
+	// every suitable device matching the override, or all suitable devices for an
+	// empty override or "all"; a comma separated list picks several, for render workers
+	std::vector<DeviceCandidate> select_many(const std::string& overrides);
+
+	const std::vector<DeviceCandidate>& candidates() const { return _candidates; }
+
+	// prints the ranking and which device was taken and why
+	void log(const DeviceCandidate& chosen) const;
+
+private:
+	const DeviceCandidate* find(const std::string& override_value) const;
+	static uint64_t score(const DeviceCandidate& candidate);
+
+private:
+	std::vector<DeviceCandidate> _candidates;
+	std::string _reason;
+};
@@ -0,0 +1,220 @@
+#include <stdexcept>
+#include <iostream>
+
+#include "frame_capture.h"
+
+// Y4M needs a frame rate; players use it for timing only, the frames are not paced
+static const char* Y4M_FRAME_RATE = "60:1";
+
+FrameCapture::Format FrameCapture::format_for(const std::string& path) {
+	const std::string extension = ".y4m";
+	if (path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0) {
+		return Format::Y4M;
+	}
+	return Format::RAW_RGBA;
+}
+
+void FrameCapture::open(VkPhysicalDevice physical_device, VkDevice device, const std::string& path, VkExtent2D extent, uint32_t slot_count) {
+	_physical_device = physical_device;
+	_device = device;
+	_format = format_for(path);
+	_extent = extent;
+
+	VkDeviceSize pixels = static_cast<VkDeviceSize>(extent.width) * extent.height;
+	if (_format == Format::Y4M) {
+		_plane_stride = (pixels + 3) & ~VkDeviceSize(3);
+		_buffer_size = _plane_stride * 3;
+	} else {
+		_plane_stride = pixels * 4;
+		_buffer_size = _plane_stride;
+	}
+
+	for (uint32_t i = 0; i < slot_count; ++i) {
+		Slot& slot = _slots.emplace_back();
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = _buffer_size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(_device, &bufferInfo, nullptr, &slot.buffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create capture buffer!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(_device, slot.buffer, &memRequirements);
+
+		// cached memory makes the writer's reads fast, the copy into it is done by the GPU anyway
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = find_memory_type(memRequirements.memoryTypeBits,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
+		if (vkAllocateMemory(_device, &allocInfo, nullptr, &slot.memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate capture buffer memory!");
+		}
+		vkBindBufferMemory(_device, slot.buffer, slot.memory, 0);
+
+		// mapped for the lifetime of the stream, the writer reads straight from it
+		if (vkMapMemory(_device, slot.memory, 0, VK_WHOLE_SIZE, 0, &slot.mapped) != VK_SUCCESS) {
+			throw std::runtime_error("failed to map capture buffer memory!");
+		}
+	}
+
+	if (path == "-") {
+		_file = stdout;
+	} else {
+		_file = std::fopen(path.c_str(), "wb");
+		if (_file == nullptr) {
+			throw std::runtime_error("failed to open capture file " + path + "!");
+		}
+	}
+
+	if (_format == Format::Y4M) {
+		std::fprintf(_file, "YUV4MPEG2 W%u H%u F%s Ip A1:1 C444\n", extent.width, extent.height, Y4M_FRAME_RATE);
+	}
+
+	_closing = false;
+	_writer = std::thread(&FrameCapture::writer_loop, this);
+}
+
+void FrameCapture::close() {
+	if (_file == nullptr) {
+		return;
+	}
+
+	poll();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_closing = true;
+	}
+	_ready_changed.notify_all();
+	_writer.join();
+
+	for (auto& slot : _slots) {
+		vkUnmapMemory(_device, slot.memory);
+		vkDestroyBuffer(_device, slot.buffer, nullptr);
+		vkFreeMemory(_device, slot.memory, nullptr);
+	}
+	_slots.clear();
+	_recorded.clear();
+
+	if (_file == stdout) {
+		std::fflush(_file);
+	} else {
+		std::fclose(_file);
+	}
+	_file = nullptr;
+
+	// stdout may be the stream itself
+	std::cerr << "captured " << _written << " frames, dropped " << _dropped << std::endl;
+}
+
+std::optional<uint32_t> FrameCapture::acquire(VkFence fence) {
+	for (uint32_t i = 0; i < _slots.size(); ++i) {
+		if (_slots[i].state == SlotState::FREE) {
+			_slots[i].fence = fence;
+			_slots[i].state = SlotState::RECORDED;
+			_recorded.push_back(i);
+			return i;
+		}
+	}
+
+	// the writer is behind; waiting for it would stall rendering
+	++_dropped;
+	return std::nullopt;
+}
+
+void FrameCapture::poll() {
+	// in submission order, stopping at the first unfinished frame keeps the stream ordered
+	while (!_recorded.empty()) {
+		Slot& slot = _slots[_recorded.front()];
+		if (vkGetFenceStatus(_device, slot.fence) != VK_SUCCESS) {
+			break;
+		}
+
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = slot.memory;
+		range.offset = 0;
+		range.size = VK_WHOLE_SIZE;
+		vkInvalidateMappedMemoryRanges(_device, 1, &range);
+
+		slot.fence = VK_NULL_HANDLE;
+		slot.state = SlotState::WRITING;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_ready.push_back(_recorded.front());
+		}
+		_ready_changed.notify_one();
+		_recorded.pop_front();
+	}
+}
+
+void FrameCapture::writer_loop() {
+	bool failed = false;
+	while (true) {
+		uint32_t index;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_ready_changed.wait(lock, [this] { return _closing || !_ready.empty(); });
+			if (_ready.empty()) {
+				return;
+			}
+			index = _ready.front();
+			_ready.pop_front();
+		}
+
+		Slot& slot = _slots[index];
+		// after a failed write the frames are still consumed, so rendering goes on
+		if (!failed) {
+			failed = !write_frame(slot);
+			if (failed) {
+				std::cerr << "failed to write captured frame, capture stopped" << std::endl;
+			} else {
+				++_written;
+			}
+		}
+		slot.state = SlotState::FREE;
+	}
+}
+
+bool FrameCapture::write_frame(const Slot& slot) {
+	auto data = static_cast<const uint8_t*>(slot.mapped);
+	if (_format == Format::RAW_RGBA) {
+		return std::fwrite(data, 1, _buffer_size, _file) == _buffer_size;
+	}
+
+	if (std::fputs("FRAME\n", _file) < 0) {
+		return false;
+	}
+	size_t planeSize = static_cast<size_t>(_extent.width) * _extent.height;
+	for (uint32_t plane = 0; plane < 3; ++plane) {
+		if (std::fwrite(data + plane * _plane_stride, 1, planeSize, _file) != planeSize) {
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32_t FrameCapture::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred) const {
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(_physical_device, &memProperties);
+
+	auto wanted = properties | preferred;
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((type_filter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & wanted) == wanted) {
+			return i;
+		}
+	}
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((type_filter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
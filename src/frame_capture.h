@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+// Streams rendered frames to a file or pipe without stalling the render loop.
+// Frames are copied by the GPU into a ring of persistently mapped readback
+// buffers. The render loop never waits for them: poll() checks the fences of
+// earlier frames and hands finished buffers to a writer thread, which writes
+// straight from the mapped memory. When every buffer is busy the frame is
+// dropped rather than waited for.
+//
+// Y4M streams are 4:4:4 planar YUV (BT.601, limited range), converted on the GPU,
+// so the buffer already holds the bytes of a frame; raw streams are packed RGBA8.
+class FrameCapture {
+public:
+	enum class Format {
+		RAW_RGBA,
+		Y4M,
+	};
+
+	// ".y4m" files are Y4M, everything else raw RGBA
+	static Format format_for(const std::string& path);
+
+	// path "-" streams to stdout; the extent is fixed for the whole stream
+	void open(VkPhysicalDevice physical_device, VkDevice device, const std::string& path, VkExtent2D extent, uint32_t slot_count = 4);
+	// hands over what the GPU finished and waits for the writer; pending frames must be complete
+	void close();
+
+	bool is_open() const { return _file != nullptr; }
+	Format format() const { return _format; }
+	VkExtent2D extent() const { return _extent; }
+
+	// reserves a buffer for the frame being recorded, which signals fence when done;
+	// std::nullopt drops the frame
+	std::optional<uint32_t> acquire(VkFence fence);
+	VkBuffer buffer(uint32_t slot) const { return _slots[slot].buffer; }
+	VkDeviceSize buffer_size() const { return _buffer_size; }
+	// Y4M planes start at multiples of this, so each one is word aligned for the shader
+	VkDeviceSize plane_stride() const { return _plane_stride; }
+
+	// never blocks: frames whose fence signalled go to the writer thread
+	void poll();
+
+	uint64_t written() const { return _written; }
+	uint64_t dropped() const { return _dropped; }
+
+private:
+	enum class SlotState {
+		FREE,
+		RECORDED,
+		WRITING,
+	};
+
+	struct Slot {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+		VkFence fence = VK_NULL_HANDLE;
+		std::atomic<SlotState> state{SlotState::FREE};
+	};
+
+	void writer_loop();
+	bool write_frame(const Slot& slot);
+	uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred) const;
+
+private:
+	VkPhysicalDevice _physical_device = VK_NULL_HANDLE;
+	VkDevice _device = VK_NULL_HANDLE;
+	Format _format = Format::RAW_RGBA;
+	VkExtent2D _extent{};
+	VkDeviceSize _buffer_size = 0;
+	VkDeviceSize _plane_stride = 0;
+
+	// a deque, slots hold atomics and must not move
+	std::deque<Slot> _slots;
+	// recorded slots in submission order
+	std::deque<uint32_t> _recorded;
+
+	std::FILE* _file = nullptr;
+	std::thread _writer;
+	std::mutex _mutex;
+	std::condition_variable _ready_changed;
+	std::deque<uint32_t> _ready;
+	bool _closing = false;
+
+	std::atomic<uint64_t> _written{0};
+	uint64_t _dropped = 0;
+};
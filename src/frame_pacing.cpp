@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "frame_pacing.h"
+
+// weight of the newest sample in the moving averages
+static const double AVERAGE_WEIGHT = 0.1;
+// just in time, on top of the measured frame time, for frames a little slower than the average
+static const double JUST_IN_TIME_SLACK = 1.2;
+static const double JUST_IN_TIME_MARGIN_MS = 1.0;
+
+std::optional<VkPresentModeKHR> PresentPolicy::parse_mode(const std::string& name) {
+	if (name == "immediate") {
+		return VK_PRESENT_MODE_IMMEDIATE_KHR;
+	} else if (name == "mailbox") {
+		return VK_PRESENT_MODE_MAILBOX_KHR;
+	} else if (name == "fifo") {
+		return VK_PRESENT_MODE_FIFO_KHR;
+	} else if (name == "fifo_relaxed") {
+		return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+	}
+	return std::nullopt;
+}
+
+std::string PresentPolicy::mode_name(VkPresentModeKHR mode) {
+	switch (mode) {
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:
+		return "immediate";
+	case VK_PRESENT_MODE_MAILBOX_KHR:
+		return "mailbox";
+	case VK_PRESENT_MODE_FIFO_KHR:
+		return "fifo";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+		return "fifo_relaxed";
+	default:
+		return "unknown";
+	}
+}
+
+VkPresentModeKHR PresentPolicy::choose_mode(const std::vector<VkPresentModeKHR>& available) const {
+	std::vector<VkPresentModeKHR> preferred;
+	switch (mode.value_or(VK_PRESENT_MODE_MAILBOX_KHR)) {
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:
+		preferred = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+		break;
+	case VK_PRESENT_MODE_MAILBOX_KHR:
+		preferred = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+		// the default only takes MAILBOX, tearing is never picked unasked
+		if (!mode) {
+			preferred.pop_back();
+		}
+		break;
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+		preferred = {VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+		break;
+	default:
+		break;
+	}
+
+	for (auto candidate : preferred) {
+		if (std::find(available.begin(), available.end(), candidate) != available.end()) {
+			return candidate;
+		}
+	}
+	// the only mode every surface supports
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+void FrameLimiter::set_target(double fps, bool just_in_time) {
+	_period = fps > 0.0
+		? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps))
+		: Clock::duration::zero();
+	_just_in_time = just_in_time && fps > 0.0;
+	_due = Clock::time_point();
+}
+
+double FrameLimiter::target_fps() const {
+	if (_period == Clock::duration::zero()) {
+		return 0.0;
+	}
+	return 1.0 / std::chrono::duration<double>(_period).count();
+}
+
+void FrameLimiter::wait() {
+	if (_period == Clock::duration::zero()) {
+		return;
+	}
+
+	// the first frame, or a frame already late: the grid restarts from now rather
+	// than rushing frames out to catch up
+	auto now = Clock::now();
+	if (now > _due) {
+		_due = now + _period;
+	}
+
+	auto start = _due - _period;
+	if (_just_in_time) {
+		double frameMs = (_cpu_ms.load(std::memory_order_relaxed) + _gpu_ms.load(std::memory_order_relaxed)) * JUST_IN_TIME_SLACK
+			+ JUST_IN_TIME_MARGIN_MS;
+		auto frameTime = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(frameMs));
+		start = _due - std::min(frameTime, _period);
+	}
+
+	_due += _period;
+	sleep_until(start);
+}
+
+void FrameLimiter::record_cpu_time(double ms) {
+	double average = _cpu_ms.load(std::memory_order_relaxed);
+	_cpu_ms.store(average + AVERAGE_WEIGHT * (ms - average), std::memory_order_relaxed);
+}
+
+void FrameLimiter::record_gpu_time(double ms) {
+	double average = _gpu_ms.load(std::memory_order_relaxed);
+	_gpu_ms.store(average + AVERAGE_WEIGHT * (ms - average), std::memory_order_relaxed);
+}
+
+void FrameLimiter::sleep_until(Clock::time_point deadline) {
+	while (true) {
+		auto before = Clock::now();
+		double remainingMs = std::chrono::duration<double, std::milli>(deadline - before).count();
+		if (remainingMs <= _sleep_mean_ms + std::sqrt(_sleep_variance)) {
+			break;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		double sleptMs = std::chrono::duration<double, std::milli>(Clock::now() - before).count();
+		double delta = sleptMs - _sleep_mean_ms;
+		_sleep_mean_ms += AVERAGE_WEIGHT * delta;
+		_sleep_variance = (1.0 - AVERAGE_WEIGHT) * (_sleep_variance + AVERAGE_WEIGHT * delta * delta);
+	}
+
+	while (Clock::now() < deadline) {
+		std::this_thread::yield();
+	}
+}
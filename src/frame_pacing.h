@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <optional>
+#include <chrono>
+#include <atomic>
+
+// How frames reach the display: the present mode asked for and the frame rate cap.
+struct PresentPolicy {
+	// nullopt keeps the default, MAILBOX where supported and FIFO otherwise
+	std::optional<VkPresentModeKHR> mode;
+	// 0 for no cap; nullopt caps the modes that do not wait for vertical blank
+	// (IMMEDIATE, MAILBOX) at the display's refresh rate and leaves the others alone
+	std::optional<double> target_fps;
+	// starts each frame as late as its measured CPU and GPU time allow, needs a cap
+	bool just_in_time = false;
+
+	// "immediate", "mailbox", "fifo" or "fifo_relaxed"
+	static std::optional<VkPresentModeKHR> parse_mode(const std::string& name);
+	static std::string mode_name(VkPresentModeKHR mode);
+
+	// the requested mode if the surface has it, else the closest one it has: the tearing
+	// modes stand in for each other, FIFO_RELAXED for FIFO, and FIFO is always there
+	VkPresentModeKHR choose_mode(const std::vector<VkPresentModeKHR>& available) const;
+};
+
+// Caps the frame rate without burning a core. wait() is called before a frame's input
+// is sampled and sleeps until that frame should start: sleeps of a millisecond while
+// there is clearly time for one, judged by how long they really took so far, then a
+// yielding spin for the rest, which the OS scheduler is too coarse for.
+//
+// Frames are due on a fixed grid of target periods. Normally a frame starts when the
+// previous one was due; just in time, it starts the measured CPU plus GPU time of a
+// frame (with some slack) before it is due, so its input is as fresh as possible.
+class FrameLimiter {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// 0 turns the limiter off
+	void set_target(double fps, bool just_in_time);
+	double target_fps() const;
+	bool just_in_time() const { return _just_in_time; }
+
+	void wait();
+
+	// from the render stage: input sample to submission, and the frame's GPU time
+	void record_cpu_time(double ms);
+	void record_gpu_time(double ms);
+
+private:
+	void sleep_until(Clock::time_point deadline);
+
+private:
+	Clock::duration _period = Clock::duration::zero();
+	bool _just_in_time = false;
+	// when the frame about to start is due
+	Clock::time_point _due;
+
+	// moving averages of the recent frames
+	std::atomic<double> _cpu_ms{0.0};
+	std::atomic<double> _gpu_ms{0.0};
+
+	// moving mean and variance of what a 1 ms sleep really takes
+	double _sleep_mean_ms = 1.0;
+	double _sleep_variance = 0.0;
+};
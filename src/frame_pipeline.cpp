@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <sstream>
+
+#include "frame_pipeline.h"
+
+bool FrameInputQueue::wait_for_space() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_changed.wait(lock, [this] { return _closed || _inputs.size() < _capacity; });
+	return !_closed;
+}
+
+void FrameInputQueue::push(FrameInput&& input) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_inputs.push_back(std::move(input));
+	}
+	_changed.notify_all();
+}
+
+bool FrameInputQueue::pop(FrameInput& input) {
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_changed.wait(lock, [this] { return _closed || !_inputs.empty(); });
+		if (_inputs.empty()) {
+			return false;
+		}
+		input = std::move(_inputs.front());
+		_inputs.pop_front();
+	}
+	_changed.notify_all();
+	return true;
+}
+
+void FrameInputQueue::close() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_closed = true;
+	}
+	_changed.notify_all();
+}
+
+void FrameStats::start() {
+	_start = std::chrono::steady_clock::now();
+	_frames = 0;
+	_next_latency = 0;
+	_latency_count = 0;
+	_latency_sum_ms = 0.0;
+}
+
+void FrameStats::record_frame() {
+	++_frames;
+}
+
+void FrameStats::record_latency(std::chrono::steady_clock::time_point sampled, std::chrono::steady_clock::time_point completed) {
+	double latency = std::chrono::duration<double, std::milli>(completed - sampled).count();
+	_latencies_ms[_next_latency] = latency;
+	_next_latency = (_next_latency + 1) % LATENCY_SAMPLES;
+	++_latency_count;
+	_latency_sum_ms += latency;
+}
+
+std::string FrameStats::summary(const std::string& mode) const {
+	auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+	std::ostringstream out;
+	out << mode << ": " << _frames << " frames in " << seconds << " s, " << _frames / seconds << " fps";
+	if (_latency_count == 0) {
+		return out.str();
+	}
+
+	std::vector<double> recent(_latencies_ms.begin(), _latencies_ms.begin() + std::min<uint64_t>(_latency_count, LATENCY_SAMPLES));
+	auto percentile = [&recent](double p) {
+		auto nth = recent.begin() + std::min(recent.size() - 1, static_cast<size_t>(p * recent.size()));
+		std::nth_element(recent.begin(), nth, recent.end());
+		return *nth;
+	};
+	double mean = _latency_sum_ms / _latency_count;
+	out << ", input to photon " << mean << " ms mean, "
+		<< percentile(0.5) << " ms p50, " << percentile(0.99) << " ms p99";
+	return out.str();
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+// What the input/simulation stage hands to the render stage for one frame. It is
+// sampled on the main thread, the only thread allowed to talk to GLFW, so the
+// render stage never calls into GLFW itself.
+struct FrameInput {
+	uint64_t number = 0;
+	// when the input was sampled, the start of the input-to-photon latency
+	std::chrono::steady_clock::time_point sampled;
+	// simulation time of the frame, in seconds
+	float time = 0.0f;
+	glm::vec3 camera_eye{2.0f, 2.0f, 2.0f};
+	glm::vec3 camera_target{0.0f, 0.0f, 0.0f};
+	// keys pressed since the previous frame, in order
+	std::vector<int> pressed_keys;
+	VkExtent2D framebuffer_extent{};
+	bool framebuffer_resized = false;
+	// the loop idled before this frame, earlier frames finished at some unknown time
+	bool after_idle = false;
+};
+
+// Why the next frame has to be drawn when rendering on demand. Any thread may
+// invalidate; the main loop takes the reasons and draws one frame for them.
+class FrameInvalidation {
+public:
+	enum Reason : uint32_t {
+		SCENE = 1 << 0,
+		CAMERA = 1 << 1,
+		WINDOW = 1 << 2,
+		SWAP_CHAIN = 1 << 3,
+		SETTINGS = 1 << 4,
+	};
+
+	void invalidate(uint32_t reasons) { _reasons.fetch_or(reasons, std::memory_order_release); }
+	bool pending() const { return _reasons.load(std::memory_order_acquire) != 0; }
+	// the reasons since the last call, 0 when nothing changed
+	uint32_t take() { return _reasons.exchange(0, std::memory_order_acq_rel); }
+
+private:
+	// the first frame is always drawn
+	std::atomic<uint32_t> _reasons{SCENE};
+};
+
+// Bounded single producer, single consumer queue between the simulation and the
+// render stage. The bound keeps the simulation at most that many frames ahead.
+class FrameInputQueue {
+public:
+	explicit FrameInputQueue(size_t capacity = 1) : _capacity(capacity) {}
+
+	// blocks until there is room; false once closed. The producer samples its input
+	// only after this, so a queued frame is never older than it has to be.
+	bool wait_for_space();
+	void push(FrameInput&& input);
+	// blocks until there is a frame; false once closed and drained
+	bool pop(FrameInput& input);
+	// wakes both sides; frames already queued are still popped
+	void close();
+
+private:
+	size_t _capacity;
+	std::mutex _mutex;
+	std::condition_variable _changed;
+	std::deque<FrameInput> _inputs;
+	bool _closed = false;
+};
+
+// Frame throughput and input-to-photon latency of the main loop. The latency ends
+// when the frame's fence is seen signalled, which is when the image is complete and
+// queued for presentation; the display's own scan-out comes on top.
+class FrameStats {
+public:
+	void start();
+	void record_frame();
+	void record_latency(std::chrono::steady_clock::time_point sampled, std::chrono::steady_clock::time_point completed);
+
+	// frames per second and latency percentiles, one line
+	std::string summary(const std::string& mode) const;
+
+private:
+	// percentiles are over the most recent latencies, the mean over all since start()
+	static constexpr size_t LATENCY_SAMPLES = 4096;
+
+	std::chrono::steady_clock::time_point _start;
+	uint64_t _frames = 0;
+	// ring of the last LATENCY_SAMPLES latencies, next is where the next one goes
+	std::vector<double> _latencies_ms = std::vector<double>(LATENCY_SAMPLES);
+	size_t _next_latency = 0;
+	uint64_t _latency_count = 0;
+	double _latency_sum_ms = 0.0;
+};
@@ -0,0 +1,713 @@
+#include <stdexcept>
+#include <algorithm>
+#include <optional>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <utility>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "model_loader.h"
+
+static const uint32_t GLB_MAGIC = 0x46546C67;  // "glTF"
+static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+static const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+static const int GLTF_MODE_TRIANGLES = 4;
+static const uint32_t GLTF_BYTE = 5120;
+static const uint32_t GLTF_UNSIGNED_BYTE = 5121;
+static const uint32_t GLTF_SHORT = 5122;
+static const uint32_t GLTF_UNSIGNED_SHORT = 5123;
+static const uint32_t GLTF_UNSIGNED_INT = 5125;
+static const uint32_t GLTF_FLOAT = 5126;
+
+// deeper documents are rejected rather than overflowing the stack
+static const int JSON_MAX_DEPTH = 64;
+
+// Just enough JSON for a glTF header, parsed into a tree up front.
+struct JsonValue {
+	enum class Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+	Type type = Type::NUL;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> members;
+
+	// nullptr when this is not an object or has no such member
+	const JsonValue* find(std::string_view key) const {
+		for (const auto& [name, value] : members) {
+			if (name == key) {
+				return &value;
+			}
+		}
+		return nullptr;
+	}
+
+	const JsonValue& at(std::string_view key) const {
+		auto value = find(key);
+		if (value == nullptr) {
+			throw std::runtime_error("glTF property " + std::string(key) + " missing!");
+		}
+		return *value;
+	}
+
+	const JsonValue& at(size_t index) const {
+		if (type != Type::ARRAY || index >= array.size()) {
+			throw std::runtime_error("glTF index out of range!");
+		}
+		return array[index];
+	}
+
+	double number_or(std::string_view key, double fallback) const {
+		auto value = find(key);
+		return value != nullptr && value->type == Type::NUMBER ? value->number : fallback;
+	}
+
+	std::string string_or(std::string_view key, const std::string& fallback) const {
+		auto value = find(key);
+		return value != nullptr && value->type == Type::STRING ? value->string : fallback;
+	}
+
+	// a non-negative integer, the way glTF objects refer to each other
+	size_t as_index() const {
+		if (type != Type::NUMBER || !(number >= 0.0 && number < 4294967296.0) || number != static_cast<double>(static_cast<size_t>(number))) {
+			throw std::runtime_error("glTF index expected!");
+		}
+		return static_cast<size_t>(number);
+	}
+
+	size_t index(std::string_view key) const { return at(key).as_index(); }
+
+	// byte offsets and strides are non-negative integers as well
+	size_t index_or(std::string_view key, size_t fallback) const {
+		auto value = find(key);
+		return value != nullptr ? value->as_index() : fallback;
+	}
+
+	glm::vec3 as_vec3() const {
+		return {static_cast<float>(at(0).number), static_cast<float>(at(1).number), static_cast<float>(at(2).number)};
+	}
+
+	size_t size() const { return type == Type::ARRAY ? array.size() : 0; }
+};
+
+class JsonParser {
+public:
+	explicit JsonParser(std::string_view text) : _text(text) {}
+
+	JsonValue parse() {
+		auto value = parse_value(0);
+		skip_space();
+		if (_pos != _text.size()) {
+			fail();
+		}
+		return value;
+	}
+
+private:
+	[[noreturn]] void fail() const {
+		throw std::runtime_error("failed to parse glTF JSON at offset " + std::to_string(_pos) + "!");
+	}
+
+	void skip_space() {
+		while (_pos < _text.size() && (_text[_pos] == ' ' || _text[_pos] == '\t' || _text[_pos] == '\n' || _text[_pos] == '\r')) {
+			++_pos;
+		}
+	}
+
+	bool consume(std::string_view token) {
+		if (_text.substr(_pos, token.size()) != token) {
+			return false;
+		}
+		_pos += token.size();
+		return true;
+	}
+
+	void expect(char c) {
+		skip_space();
+		if (_pos >= _text.size() || _text[_pos] != c) {
+			fail();
+		}
+		++_pos;
+	}
+
+	JsonValue parse_value(int depth) {
+		if (depth > JSON_MAX_DEPTH) {
+			fail();
+		}
+		skip_space();
+		if (_pos >= _text.size()) {
+			fail();
+		}
+
+		JsonValue value;
+		char c = _text[_pos];
+		if (c == '{') {
+			value.type = JsonValue::Type::OBJECT;
+			++_pos;
+			skip_space();
+			if (consume("}")) {
+				return value;
+			}
+			do {
+				skip_space();
+				auto name = parse_string();
+				expect(':');
+				value.members.emplace_back(std::move(name), parse_value(depth + 1));
+				skip_space();
+			} while (consume(","));
+			expect('}');
+		} else if (c == '[') {
+			value.type = JsonValue::Type::ARRAY;
+			++_pos;
+			skip_space();
+			if (consume("]")) {
+				return value;
+			}
+			do {
+				value.array.push_back(parse_value(depth + 1));
+				skip_space();
+			} while (consume(","));
+			expect(']');
+		} else if (c == '"') {
+			value.type = JsonValue::Type::STRING;
+			value.string = parse_string();
+		} else if (consume("true")) {
+			value.type = JsonValue::Type::BOOLEAN;
+			value.boolean = true;
+		} else if (consume("false")) {
+			value.type = JsonValue::Type::BOOLEAN;
+		} else if (consume("null")) {
+			value.type = JsonValue::Type::NUL;
+		} else {
+			value.type = JsonValue::Type::NUMBER;
+			auto result = std::from_chars(_text.data() + _pos, _text.data() + _text.size(), value.number);
+			if (result.ec != std::errc()) {
+				fail();
+			}
+			_pos = result.ptr - _text.data();
+		}
+		return value;
+	}
+
+	std::string parse_string() {
+		if (_pos >= _text.size() || _text[_pos] != '"') {
+			fail();
+		}
+		++_pos;
+
+		std::string result;
+		while (_pos < _text.size() && _text[_pos] != '"') {
+			char c = _text[_pos++];
+			if (c != '\\') {
+				result += c;
+				continue;
+			}
+			if (_pos >= _text.size()) {
+				fail();
+			}
+			char escape = _text[_pos++];
+			switch (escape) {
+			case '"': result += '"'; break;
+			case '\\': result += '\\'; break;
+			case '/': result += '/'; break;
+			case 'b': result += '\b'; break;
+			case 'f': result += '\f'; break;
+			case 'n': result += '\n'; break;
+			case 'r': result += '\r'; break;
+			case 't': result += '\t'; break;
+			case 'u': append_utf8(result, parse_code_point()); break;
+			default: fail();
+			}
+		}
+		if (_pos >= _text.size()) {
+			fail();
+		}
+		++_pos;
+		return result;
+	}
+
+	uint32_t parse_hex4() {
+		uint32_t value = 0;
+		auto result = std::from_chars(_text.data() + _pos, _text.data() + std::min(_pos + 4, _text.size()), value, 16);
+		if (result.ec != std::errc() || result.ptr != _text.data() + _pos + 4) {
+			fail();
+		}
+		_pos += 4;
+		return value;
+	}
+
+	uint32_t parse_code_point() {
+		uint32_t high = parse_hex4();
+		if (high < 0xD800 || high > 0xDBFF) {
+			return high;
+		}
+		// the second half of a surrogate pair follows as its own escape
+		if (!consume("\\u")) {
+			fail();
+		}
+		uint32_t low = parse_hex4();
+		if (low < 0xDC00 || low > 0xDFFF) {
+			fail();
+		}
+		return 0x10000 + ((high - 0xD800) << 10) + (low - 0xDC00);
+	}
+
+	static void append_utf8(std::string& out, uint32_t code_point) {
+		if (code_point < 0x80) {
+			out += static_cast<char>(code_point);
+		} else if (code_point < 0x800) {
+			out += static_cast<char>(0xC0 | (code_point >> 6));
+			out += static_cast<char>(0x80 | (code_point & 0x3F));
+		} else if (code_point < 0x10000) {
+			out += static_cast<char>(0xE0 | (code_point >> 12));
+			out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code_point & 0x3F));
+		} else {
+			out += static_cast<char>(0xF0 | (code_point >> 18));
+			out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code_point & 0x3F));
+		}
+	}
+
+private:
+	std::string_view _text;
+	size_t _pos = 0;
+};
+
+// Elements of one accessor, inside the binary chunk.
+struct GltfAccessor {
+	const char* data = nullptr;
+	size_t count = 0;
+	size_t stride = 0;
+	uint32_t component_type = 0;
+	uint32_t components = 0;
+	bool normalized = false;
+
+	// component i of element, as a float; normalized integers are mapped to [0, 1] or [-1, 1]
+	float read_float(size_t element, uint32_t i) const {
+		const char* p = data + element * stride;
+		switch (component_type) {
+		case GLTF_FLOAT: {
+			float value;
+			memcpy(&value, p + i * sizeof(float), sizeof(value));
+			return value;
+		}
+		case GLTF_UNSIGNED_BYTE: {
+			uint8_t value = static_cast<uint8_t>(p[i]);
+			return normalized ? value / 255.0f : value;
+		}
+		case GLTF_BYTE: {
+			int8_t value = static_cast<int8_t>(p[i]);
+			return normalized ? std::max(value / 127.0f, -1.0f) : value;
+		}
+		case GLTF_UNSIGNED_SHORT: {
+			uint16_t value;
+			memcpy(&value, p + i * sizeof(value), sizeof(value));
+			return normalized ? value / 65535.0f : value;
+		}
+		case GLTF_SHORT: {
+			int16_t value;
+			memcpy(&value, p + i * sizeof(value), sizeof(value));
+			return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+		}
+		default:
+			throw std::runtime_error("unsupported glTF component type!");
+		}
+	}
+
+	uint32_t read_index(size_t element) const {
+		const char* p = data + element * stride;
+		switch (component_type) {
+		case GLTF_UNSIGNED_BYTE:
+			return static_cast<uint8_t>(*p);
+		case GLTF_UNSIGNED_SHORT: {
+			uint16_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		case GLTF_UNSIGNED_INT: {
+			uint32_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		default:
+			throw std::runtime_error("unsupported glTF index type!");
+		}
+	}
+};
+
+static size_t component_size(uint32_t component_type) {
+	switch (component_type) {
+	case GLTF_BYTE:
+	case GLTF_UNSIGNED_BYTE:
+		return 1;
+	case GLTF_SHORT:
+	case GLTF_UNSIGNED_SHORT:
+		return 2;
+	case GLTF_UNSIGNED_INT:
+	case GLTF_FLOAT:
+		return 4;
+	default:
+		throw std::runtime_error("unsupported glTF component type!");
+	}
+}
+
+static uint32_t component_count(const std::string& type) {
+	if (type == "SCALAR") {
+		return 1;
+	} else if (type == "VEC2") {
+		return 2;
+	} else if (type == "VEC3") {
+		return 3;
+	} else if (type == "VEC4") {
+		return 4;
+	}
+	throw std::runtime_error("unsupported glTF accessor type " + type + "!");
+}
+
+// Turns the default scene of a GLB into a Model, one node and primitive at a time.
+class GltfImporter {
+public:
+	GltfImporter(const JsonValue& document, std::span<const char> bin, const std::string& base_dir)
+		: _document(document), _bin(bin), _base_dir(base_dir) {}
+
+	Model import() {
+		load_materials();
+		_default_material = static_cast<uint32_t>(_model.materials.size());
+
+		const JsonValue* nodes = _document.find("nodes");
+		_visited.assign(nodes != nullptr ? nodes->size() : 0, false);
+
+		// glTF is Y up, the camera here looks at a Z up world
+		auto root = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+		for (auto node : scene_roots()) {
+			add_node(node, root);
+		}
+
+		if (std::any_of(_model.submeshes.begin(), _model.submeshes.end(), [this](const Submesh& submesh) {
+			return submesh.material == _default_material;
+		})) {
+			_model.materials.emplace_back().name = "default";
+		}
+		compute_bounds(_model);
+		return std::move(_model);
+	}
+
+private:
+	std::vector<size_t> scene_roots() const {
+		std::vector<size_t> roots;
+		const JsonValue* scenes = _document.find("scenes");
+		if (scenes != nullptr && scenes->size() > 0) {
+			const auto& scene = scenes->at(_document.find("scene") != nullptr ? _document.index("scene") : 0);
+			if (const JsonValue* sceneNodes = scene.find("nodes")) {
+				for (const auto& node : sceneNodes->array) {
+					roots.push_back(node.as_index());
+				}
+			}
+			return roots;
+		}
+
+		// no scenes: every node that is nobody's child
+		std::vector<bool> isChild(_visited.size(), false);
+		for (size_t node = 0; node < _visited.size(); ++node) {
+			if (const JsonValue* children = _document.at("nodes").at(node).find("children")) {
+				for (const auto& child : children->array) {
+					if (child.as_index() < isChild.size()) {
+						isChild[child.as_index()] = true;
+					}
+				}
+			}
+		}
+		for (size_t node = 0; node < isChild.size(); ++node) {
+			if (!isChild[node]) {
+				roots.push_back(node);
+			}
+		}
+		return roots;
+	}
+
+	void load_materials() {
+		const JsonValue* materials = _document.find("materials");
+		if (materials == nullptr) {
+			return;
+		}
+
+		for (const auto& source : materials->array) {
+			ModelMaterial material;
+			material.name = source.string_or("name", "");
+			if (const JsonValue* pbr = source.find("pbrMetallicRoughness")) {
+				if (const JsonValue* factor = pbr->find("baseColorFactor")) {
+					material.base_color = factor->as_vec3();
+				}
+				if (const JsonValue* texture = pbr->find("baseColorTexture")) {
+					load_texture(texture->index("index"), material);
+				}
+			}
+			material.vertex_color = material.base_color != glm::vec3(1.0f);
+			// there is no blending pipeline, BLEND is cut out like MASK
+			material.alpha_test = source.string_or("alphaMode", "OPAQUE") != "OPAQUE";
+			_model.materials.push_back(std::move(material));
+		}
+	}
+
+	void load_texture(size_t texture, ModelMaterial& material) {
+		const auto& source = _document.at("textures").at(texture);
+		// only an extension's image, e.g. KTX2, which is not decoded here
+		if (source.find("source") == nullptr) {
+			return;
+		}
+
+		const auto& image = _document.at("images").at(source.index("source"));
+		if (image.find("bufferView") != nullptr) {
+			auto bytes = buffer_view(image.index("bufferView"));
+			material.texture_data.assign(bytes.begin(), bytes.end());
+			return;
+		}
+		auto uri = image.string_or("uri", "");
+		// embedded base64 data is left untextured
+		if (!uri.empty() && uri.rfind("data:", 0) != 0) {
+			material.texture_path = _base_dir + uri;
+		}
+	}
+
+	std::span<const char> buffer_view(size_t index) const {
+		const auto& view = _document.at("bufferViews").at(index);
+		if (view.index("buffer") != 0 || _document.at("buffers").at(0).find("uri") != nullptr) {
+			throw std::runtime_error("glTF buffers outside the GLB binary chunk are not supported!");
+		}
+		auto offset = view.index_or("byteOffset", 0);
+		auto length = view.index("byteLength");
+		if (offset > _bin.size() || length > _bin.size() - offset) {
+			throw std::runtime_error("glTF buffer view out of range!");
+		}
+		return _bin.subspan(offset, length);
+	}
+
+	GltfAccessor accessor(size_t index) const {
+		const auto& source = _document.at("accessors").at(index);
+		if (source.find("sparse") != nullptr || source.find("bufferView") == nullptr) {
+			throw std::runtime_error("sparse glTF accessors are not supported!");
+		}
+
+		const auto& view = _document.at("bufferViews").at(source.index("bufferView"));
+		auto bytes = buffer_view(source.index("bufferView"));
+
+		GltfAccessor result;
+		result.count = source.index("count");
+		result.component_type = static_cast<uint32_t>(source.index("componentType"));
+		result.components = component_count(source.string_or("type", ""));
+		result.normalized = source.find("normalized") != nullptr && source.at("normalized").boolean;
+
+		size_t elementSize = component_size(result.component_type) * result.components;
+		result.stride = view.index_or("byteStride", 0);
+		if (result.stride == 0) {
+			result.stride = elementSize;
+		}
+
+		auto offset = source.index_or("byteOffset", 0);
+		if (result.count > 0 && (offset > bytes.size() || (result.count - 1) * result.stride + elementSize > bytes.size() - offset)) {
+			throw std::runtime_error("glTF accessor out of range!");
+		}
+		result.data = bytes.data() + offset;
+		return result;
+	}
+
+	static glm::mat4 local_transform(const JsonValue& node) {
+		glm::mat4 transform(1.0f);
+		if (const JsonValue* matrix = node.find("matrix")) {
+			// column major, like glm
+			for (int i = 0; i < 16; ++i) {
+				transform[i / 4][i % 4] = static_cast<float>(matrix->at(i).number);
+			}
+			return transform;
+		}
+
+		if (const JsonValue* t = node.find("translation")) {
+			transform = glm::translate(transform, t->as_vec3());
+		}
+		if (const JsonValue* r = node.find("rotation")) {
+			// stored x, y, z, w
+			glm::quat rotation(static_cast<float>(r->at(3).number), static_cast<float>(r->at(0).number),
+				static_cast<float>(r->at(1).number), static_cast<float>(r->at(2).number));
+			transform = transform * glm::mat4_cast(rotation);
+		}
+		if (const JsonValue* s = node.find("scale")) {
+			transform = glm::scale(transform, s->as_vec3());
+		}
+		return transform;
+	}
+
+	void add_node(size_t index, const glm::mat4& parent_world) {
+		if (index >= _visited.size() || _visited[index]) {
+			throw std::runtime_error("glTF node hierarchy is not a tree!");
+		}
+		_visited[index] = true;
+
+		const auto& node = _document.at("nodes").at(index);
+		auto world = parent_world * local_transform(node);
+
+		if (node.find("mesh") != nullptr) {
+			const auto& mesh = _document.at("meshes").at(node.index("mesh"));
+			for (const auto& primitive : mesh.at("primitives").array) {
+				add_primitive(primitive, world);
+			}
+		}
+
+		if (const JsonValue* children = node.find("children")) {
+			for (const auto& child : children->array) {
+				add_node(child.as_index(), world);
+			}
+		}
+	}
+
+	void add_primitive(const JsonValue& primitive, const glm::mat4& world) {
+		// points, lines and strips are not drawn
+		if (static_cast<int>(primitive.number_or("mode", GLTF_MODE_TRIANGLES)) != GLTF_MODE_TRIANGLES) {
+			return;
+		}
+
+		const auto& attributes = primitive.at("attributes");
+		auto positions = accessor(attributes.index("POSITION"));
+		if (positions.component_type != GLTF_FLOAT || positions.components != 3) {
+			throw std::runtime_error("glTF positions must be float triples!");
+		}
+		std::optional<GltfAccessor> texCoords, colors;
+		if (attributes.find("TEXCOORD_0") != nullptr) {
+			texCoords = accessor(attributes.index("TEXCOORD_0"));
+			if (texCoords->components != 2) {
+				throw std::runtime_error("glTF texture coordinates must be pairs!");
+			}
+		}
+		if (attributes.find("COLOR_0") != nullptr) {
+			colors = accessor(attributes.index("COLOR_0"));
+			// the alpha of RGBA colors is not used
+			if (colors->components != 3 && colors->components != 4) {
+				throw std::runtime_error("glTF colors must be RGB or RGBA!");
+			}
+		}
+
+		Submesh submesh;
+		submesh.first_index = static_cast<uint32_t>(_model.indices.size());
+		submesh.material = _default_material;
+		if (primitive.find("material") != nullptr) {
+			submesh.material = static_cast<uint32_t>(primitive.index("material"));
+			if (submesh.material >= _default_material) {
+				throw std::runtime_error("glTF material index out of range!");
+			}
+		}
+		glm::vec3 baseColor = submesh.material == _default_material ? glm::vec3(1.0f) : _model.materials[submesh.material].base_color;
+		if (colors && submesh.material != _default_material) {
+			_model.materials[submesh.material].vertex_color = true;
+		}
+
+		auto baseVertex = static_cast<uint32_t>(_model.vertices.size());
+		for (size_t i = 0; i < positions.count; ++i) {
+			Vertex vertex{};
+			auto position = world * glm::vec4(positions.read_float(i, 0), positions.read_float(i, 1), positions.read_float(i, 2), 1.0f);
+			vertex.pos = {position.x, position.y, position.z};
+			// glTF's texture origin is the top left corner already
+			if (texCoords && i < texCoords->count) {
+				vertex.texCoord = {texCoords->read_float(i, 0), texCoords->read_float(i, 1)};
+			}
+			vertex.color = baseColor;
+			if (colors && i < colors->count) {
+				vertex.color = vertex.color * glm::vec3(colors->read_float(i, 0), colors->read_float(i, 1), colors->read_float(i, 2));
+			}
+			_model.vertices.push_back(vertex);
+		}
+
+		std::vector<uint32_t> indices;
+		if (primitive.find("indices") != nullptr) {
+			auto source = accessor(primitive.index("indices"));
+			if (source.components != 1) {
+				throw std::runtime_error("glTF indices must be scalars!");
+			}
+			indices.resize(source.count);
+			for (size_t i = 0; i < source.count; ++i) {
+				indices[i] = source.read_index(i);
+				if (indices[i] >= positions.count) {
+					throw std::runtime_error("glTF index out of range!");
+				}
+			}
+		} else {
+			indices.resize(positions.count);
+			for (size_t i = 0; i < indices.size(); ++i) {
+				indices[i] = static_cast<uint32_t>(i);
+			}
+		}
+
+		// a mirroring transform turns the triangles inside out, swapping two corners turns them back
+		glm::vec3 x(world[0].x, world[0].y, world[0].z);
+		glm::vec3 y(world[1].x, world[1].y, world[1].z);
+		glm::vec3 z(world[2].x, world[2].y, world[2].z);
+		bool mirrored = glm::dot(glm::cross(x, y), z) < 0.0f;
+
+		size_t triangleCount = indices.size() / 3;
+		for (size_t triangle = 0; triangle < triangleCount; ++triangle) {
+			uint32_t a = indices[3 * triangle], b = indices[3 * triangle + 1], c = indices[3 * triangle + 2];
+			if (mirrored) {
+				std::swap(b, c);
+			}
+			_model.indices.push_back(baseVertex + a);
+			_model.indices.push_back(baseVertex + b);
+			_model.indices.push_back(baseVertex + c);
+		}
+
+		submesh.index_count = static_cast<uint32_t>(_model.indices.size()) - submesh.first_index;
+		if (submesh.index_count > 0) {
+			_model.submeshes.push_back(submesh);
+		}
+	}
+
+private:
+	const JsonValue& _document;
+	std::span<const char> _bin;
+	std::string _base_dir;
+	Model _model;
+	uint32_t _default_material = 0;
+	std::vector<bool> _visited;
+};
+
+Model load_glb_model(std::span<const char> glb, const std::string& base_dir) {
+	auto read_u32 = [&glb](size_t offset) {
+		uint32_t value;
+		memcpy(&value, glb.data() + offset, sizeof(value));
+		return value;
+	};
+
+	if (glb.size() < 12 || read_u32(0) != GLB_MAGIC || read_u32(4) != 2) {
+		throw std::runtime_error("not a glTF 2.0 binary file!");
+	}
+
+	// the JSON chunk comes first, an optional binary chunk second; others are skipped
+	std::string_view json;
+	std::span<const char> bin;
+	size_t length = std::min<size_t>(read_u32(8), glb.size());
+	for (size_t offset = 12; offset + 8 <= length; ) {
+		size_t chunkLength = read_u32(offset);
+		uint32_t chunkType = read_u32(offset + 4);
+		if (chunkLength > length - offset - 8) {
+			throw std::runtime_error("glTF chunk out of range!");
+		}
+		const char* data = glb.data() + offset + 8;
+		if (chunkType == GLB_CHUNK_JSON && json.empty()) {
+			json = std::string_view(data, chunkLength);
+		} else if (chunkType == GLB_CHUNK_BIN && bin.empty()) {
+			bin = std::span<const char>(data, chunkLength);
+		}
+		// chunks are padded to four bytes
+		offset += 8 + ((chunkLength + 3) & ~size_t(3));
+	}
+	if (json.empty()) {
+		throw std::runtime_error("glTF file has no JSON chunk!");
+	}
+
+	auto document = JsonParser(json).parse();
+	return GltfImporter(document, bin, base_dir).import();
+}
@@ -0,0 +1,134 @@
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#include "golden_compare.h"
+#include "batch_renderer.h"
+
+// differences are small where it matters, amplified they show up in the diff image
+static const uint32_t DIFF_GAIN = 4;
+
+ImageComparison compare_images(const std::vector<uint8_t>& image, const std::vector<uint8_t>& golden,
+		uint32_t width, uint32_t height, uint32_t pixel_tolerance, std::vector<uint8_t>* diff) {
+	ImageComparison result;
+	result.pixel_count = static_cast<size_t>(width) * height;
+	if (image.size() != result.pixel_count * 4 || golden.size() != result.pixel_count * 4) {
+		result.error = "size mismatch";
+		return result;
+	}
+	if (diff != nullptr) {
+		diff->assign(result.pixel_count * 4, 0);
+	}
+
+	// alpha is ignored, the scene is opaque and the swap chain does not blend
+	uint64_t squaredError = 0;
+	for (size_t pixel = 0; pixel < result.pixel_count; ++pixel) {
+		uint32_t pixelDifference = 0;
+		for (size_t channel = 0; channel < 3; ++channel) {
+			size_t i = pixel * 4 + channel;
+			uint32_t difference = static_cast<uint32_t>(std::abs(int(image[i]) - int(golden[i])));
+			squaredError += difference * difference;
+			pixelDifference = std::max(pixelDifference, difference);
+		}
+		result.max_difference = std::max(result.max_difference, pixelDifference);
+
+		bool differs = pixelDifference > pixel_tolerance;
+		if (differs) {
+			++result.differing_pixels;
+		}
+		if (diff != nullptr) {
+			uint8_t* out = diff->data() + pixel * 4;
+			uint8_t amplified = static_cast<uint8_t>(std::min<uint32_t>(pixelDifference * DIFF_GAIN, 255));
+			out[0] = differs ? 255 : amplified;
+			out[1] = differs ? 0 : amplified;
+			out[2] = differs ? 0 : amplified;
+			out[3] = 255;
+		}
+	}
+
+	double meanSquaredError = static_cast<double>(squaredError) / (result.pixel_count * 3);
+	result.psnr = meanSquaredError == 0.0
+		? std::numeric_limits<double>::infinity()
+		: 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+	result.compared = true;
+	return result;
+}
+
+static bool load_rgba(const std::string& path, std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height) {
+	int w, h, channels;
+	stbi_uc* data = stbi_load(path.c_str(), &w, &h, &channels, STBI_rgb_alpha);
+	if (data == nullptr) {
+		return false;
+	}
+	width = static_cast<uint32_t>(w);
+	height = static_cast<uint32_t>(h);
+	pixels.assign(data, data + static_cast<size_t>(w) * h * 4);
+	stbi_image_free(data);
+	return true;
+}
+
+size_t compare_with_goldens(const std::vector<BatchView>& views, const GoldenSettings& settings) {
+	namespace fs = std::filesystem;
+
+	size_t failures = 0;
+	for (const auto& view : views) {
+		fs::path output(view.output);
+		fs::path golden = fs::path(settings.golden_dir) / output.filename();
+
+		if (settings.update) {
+			std::error_code error;
+			fs::create_directories(golden.parent_path(), error);
+			fs::copy_file(output, golden, fs::copy_options::overwrite_existing, error);
+			if (error) {
+				std::cout << "FAIL " << golden.string() << ": " << error.message() << std::endl;
+				++failures;
+			} else {
+				std::cout << "updated " << golden.string() << std::endl;
+			}
+			continue;
+		}
+
+		std::vector<uint8_t> image, reference;
+		uint32_t width, height, goldenWidth, goldenHeight;
+		ImageComparison result;
+		if (!load_rgba(output.string(), image, width, height)) {
+			result.error = "no rendered image";
+		} else if (!load_rgba(golden.string(), reference, goldenWidth, goldenHeight)) {
+			result.error = "no golden, rerun with --golden-update to create it";
+		} else if (width != goldenWidth || height != goldenHeight) {
+			result.error = "golden is " + std::to_string(goldenWidth) + "x" + std::to_string(goldenHeight);
+		} else {
+			std::vector<uint8_t> diff;
+			result = compare_images(image, reference, width, height, settings.pixel_tolerance, &diff);
+			if (result.compared && result.psnr < settings.min_psnr) {
+				fs::path diffPath = output;
+				diffPath.replace_extension(".diff.png");
+				stbi_write_png(diffPath.string().c_str(), static_cast<int>(width), static_cast<int>(height), 4, diff.data(), static_cast<int>(width) * 4);
+			}
+		}
+
+		bool passed = result.compared && result.psnr >= settings.min_psnr;
+		if (!passed) {
+			++failures;
+		}
+		std::cout << (passed ? "PASS " : "FAIL ") << output.filename().string();
+		if (result.compared) {
+			std::cout << ": psnr " << result.psnr << " dB, max difference " << result.max_difference
+				<< ", " << result.differing_pixels << " of " << result.pixel_count << " pixels differ";
+		} else {
+			std::cout << ": " << result.error;
+		}
+		std::cout << std::endl;
+	}
+
+	if (!settings.update) {
+		std::cout << views.size() - failures << " of " << views.size() << " images match their goldens" << std::endl;
+	}
+	return failures;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BatchView;
+
+// How far a rendered image is from its golden. PSNR is over the RGB channels and
+// infinite for identical images; a pixel differs when any channel is off by more
+// than the comparison's pixel tolerance.
+struct ImageComparison {
+	bool compared = false;
+	std::string error;
+	double psnr = 0.0;
+	uint32_t max_difference = 0;
+	size_t differing_pixels = 0;
+	size_t pixel_count = 0;
+};
+
+struct GoldenSettings {
+	// empty disables the comparison
+	std::string golden_dir;
+	// below this the image fails; 40 dB passes driver rounding but not a missing draw
+	double min_psnr = 40.0;
+	// per channel difference still counted as equal, and marked in the diff image above it
+	uint32_t pixel_tolerance = 8;
+	// copies the rendered images over the goldens instead of comparing
+	bool update = false;
+};
+
+// rgba buffers hold width * height tightly packed RGBA8 pixels; the diff image gets
+// the amplified difference, with the pixels above the tolerance in red
+ImageComparison compare_images(const std::vector<uint8_t>& image, const std::vector<uint8_t>& golden,
+	uint32_t width, uint32_t height, uint32_t pixel_tolerance, std::vector<uint8_t>* diff);
+
+// Compares the rendered image of every view with the golden of the same file name
+// and writes <output>.diff.png next to each one that fails. Prints one line per
+// view and returns the number of failures.
+size_t compare_with_goldens(const std::vector<BatchView>& views, const GoldenSettings& settings);
@@ -0,0 +1,302 @@
+#include <algorithm>
+
+#include "job_system.h"
+
+struct Job {
+	JobSystem::Function function;
+	JobCounter* counter = nullptr;
+	bool main_thread = false;
+};
+
+// the system and deque index of a worker thread
+static thread_local const JobSystem* t_system = nullptr;
+static thread_local size_t t_index = 0;
+
+// tries before a worker without work goes to sleep
+static const int IDLE_SPINS = 64;
+
+WorkStealingDeque::WorkStealingDeque(int64_t capacity) {
+	_arrays.push_back(std::make_unique<Array>(capacity));
+	_array.store(_arrays.back().get(), std::memory_order_relaxed);
+}
+
+WorkStealingDeque::~WorkStealingDeque() = default;
+
+void WorkStealingDeque::push(Job* job) {
+	int64_t bottom = _bottom.load(std::memory_order_relaxed);
+	int64_t top = _top.load(std::memory_order_acquire);
+	Array* array = _array.load(std::memory_order_relaxed);
+
+	if (bottom - top > array->capacity() - 1) {
+		auto grown = std::make_unique<Array>(array->capacity() * 2);
+		for (int64_t i = top; i < bottom; ++i) {
+			grown->put(i, array->get(i));
+		}
+		array = grown.get();
+		_arrays.push_back(std::move(grown));
+		_array.store(array, std::memory_order_release);
+	}
+
+	array->put(bottom, job);
+	std::atomic_thread_fence(std::memory_order_release);
+	_bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+Job* WorkStealingDeque::take() {
+	int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+	Array* array = _array.load(std::memory_order_relaxed);
+	_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = _top.load(std::memory_order_relaxed);
+
+	if (top > bottom) {
+		// empty
+		_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = array->get(bottom);
+	if (top == bottom) {
+		// the last job, thieves may be after it too
+		if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			job = nullptr;
+		}
+		_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* WorkStealingDeque::steal() {
+	int64_t top = _top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = _bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom) {
+		return nullptr;
+	}
+
+	Array* array = _array.load(std::memory_order_acquire);
+	Job* job = array->get(top);
+	if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return nullptr;
+	}
+	return job;
+}
+
+JobSystem::JobSystem(size_t thread_count)
+	: _main_thread(std::this_thread::get_id()) {
+	if (thread_count == 0) {
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (size_t i = 0; i < thread_count; ++i) {
+		_deques.push_back(std::make_unique<WorkStealingDeque>());
+	}
+	// deque 0 belongs to the main thread
+	for (size_t i = 1; i < thread_count; ++i) {
+		_threads.emplace_back(&JobSystem::worker_loop, this, i);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(_sleep_mutex);
+		_stopping = true;
+	}
+	_work_ready.notify_all();
+	for (auto& thread : _threads) {
+		thread.join();
+	}
+
+	for (auto& deque : _deques) {
+		while (Job* job = deque->take()) {
+			delete job;
+		}
+	}
+	for (Job* job : _shared_jobs) {
+		delete job;
+	}
+	for (Job* job : _main_jobs) {
+		delete job;
+	}
+}
+
+size_t JobSystem::current_index() const {
+	if (on_main_thread()) {
+		return 0;
+	}
+	return t_system == this ? t_index : _deques.size();
+}
+
+void JobSystem::submit(Function function, JobCounter* counter, JobCounter* dependency) {
+	enqueue(new Job{std::move(function), counter, false}, dependency);
+}
+
+void JobSystem::submit_main(Function function, JobCounter* counter, JobCounter* dependency) {
+	enqueue(new Job{std::move(function), counter, true}, dependency);
+}
+
+void JobSystem::enqueue(Job* job, JobCounter* dependency) {
+	if (job->counter != nullptr) {
+		job->counter->_value.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (dependency != nullptr) {
+		std::lock_guard<std::mutex> lock(dependency->_mutex);
+		if (dependency->_value.load(std::memory_order_acquire) != 0) {
+			// scheduled by the job that brings the dependency to zero
+			dependency->_waiting.push_back(job);
+			return;
+		}
+	}
+	schedule(job);
+}
+
+void JobSystem::schedule(Job* job) {
+	if (job->main_thread) {
+		std::lock_guard<std::mutex> lock(_main_mutex);
+		_main_jobs.push_back(job);
+		return;
+	}
+
+	size_t index = current_index();
+	if (index < _deques.size()) {
+		_deques[index]->push(job);
+	} else {
+		std::lock_guard<std::mutex> lock(_shared_mutex);
+		_shared_jobs.push_back(job);
+	}
+	_queued.fetch_add(1);
+	wake_one();
+}
+
+void JobSystem::wake_one() {
+	// pairs with the sleeper raising _sleepers before it checks _queued
+	if (_sleepers.load() > 0) {
+		{
+			std::lock_guard<std::mutex> lock(_sleep_mutex);
+		}
+		_work_ready.notify_one();
+	}
+}
+
+Job* JobSystem::find_job(size_t index, bool main_thread) {
+	if (main_thread) {
+		std::lock_guard<std::mutex> lock(_main_mutex);
+		if (!_main_jobs.empty()) {
+			Job* job = _main_jobs.front();
+			_main_jobs.pop_front();
+			return job;
+		}
+	}
+
+	if (_queued.load(std::memory_order_relaxed) == 0) {
+		return nullptr;
+	}
+
+	Job* job = nullptr;
+	if (index < _deques.size()) {
+		job = _deques[index]->take();
+	}
+	if (job == nullptr) {
+		std::lock_guard<std::mutex> lock(_shared_mutex);
+		if (!_shared_jobs.empty()) {
+			job = _shared_jobs.front();
+			_shared_jobs.pop_front();
+		}
+	}
+	// victims are tried starting after the thief, so thieves spread over the deques
+	for (size_t i = 1; job == nullptr && i <= _deques.size(); ++i) {
+		size_t victim = (index + i) % _deques.size();
+		if (victim != index) {
+			job = _deques[victim]->steal();
+		}
+	}
+
+	if (job != nullptr) {
+		_queued.fetch_sub(1);
+	}
+	return job;
+}
+
+void JobSystem::execute(Job* job) {
+	job->function();
+
+	JobCounter* counter = job->counter;
+	delete job;
+	if (counter == nullptr) {
+		return;
+	}
+
+	// under the lock, which wait() takes before it returns, so the counter outlives this
+	std::vector<Job*> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->_mutex);
+		if (counter->_value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			ready.swap(counter->_waiting);
+		}
+	}
+	for (Job* waiting : ready) {
+		schedule(waiting);
+	}
+}
+
+void JobSystem::worker_loop(size_t index) {
+	t_system = this;
+	t_index = index;
+
+	int idle = 0;
+	while (!_stopping.load(std::memory_order_relaxed)) {
+		if (Job* job = find_job(index, false)) {
+			execute(job);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < IDLE_SPINS) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_sleep_mutex);
+		_sleepers.fetch_add(1);
+		_work_ready.wait(lock, [this]() { return _stopping.load() || _queued.load() > 0; });
+		_sleepers.fetch_sub(1);
+		idle = 0;
+	}
+}
+
+void JobSystem::wait(JobCounter& counter) {
+	size_t index = current_index();
+	bool mainThread = on_main_thread();
+	while (!counter.done()) {
+		if (Job* job = find_job(index, mainThread)) {
+			execute(job);
+		} else {
+			std::this_thread::yield();
+		}
+	}
+	// the job that brought it to zero may still hold the lock
+	std::lock_guard<std::mutex> lock(counter._mutex);
+}
+
+void JobSystem::run_main_thread_jobs() {
+	std::deque<Job*> jobs;
+	{
+		std::lock_guard<std::mutex> lock(_main_mutex);
+		jobs.swap(_main_jobs);
+	}
+	for (Job* job : jobs) {
+		execute(job);
+	}
+}
+
+void JobSystem::parallel_for(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body) {
+	grain = std::max<size_t>(grain, 1);
+	JobCounter counter;
+	for (size_t begin = 0; begin < count; begin += grain) {
+		size_t end = std::min(count, begin + grain);
+		submit([&body, begin, end]() { body(begin, end); }, &counter);
+	}
+	wait(counter);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+
+class JobSystem;
+struct Job;
+
+// Counts unfinished jobs. A job submitted with a counter increments it right away
+// and decrements it when it finished; jobs depending on the counter start once it
+// is back at zero. A counter must outlive the jobs referring to it, so destroy it
+// only after JobSystem::wait() returned for it.
+class JobCounter {
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool done() const { return _value.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int> _value{0};
+	// jobs waiting for zero; the mutex orders adding one against the final decrement
+	std::mutex _mutex;
+	std::vector<Job*> _waiting;
+};
+
+// Chase-Lev work stealing deque of one worker: the owner pushes and takes at the
+// bottom, other threads steal from the top. Grows when full; the arrays it grew
+// out of are kept until destruction, since a thief may still be reading one.
+class WorkStealingDeque {
+public:
+	explicit WorkStealingDeque(int64_t capacity = 256);
+	~WorkStealingDeque();
+
+	WorkStealingDeque(const WorkStealingDeque&) = delete;
+	WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+	// owner only
+	void push(Job* job);
+	Job* take();
+	// any thread; nullptr when empty or when it lost the race for the last job
+	Job* steal();
+
+private:
+	struct Array {
+		explicit Array(int64_t capacity) : mask(capacity - 1), slots(capacity) {}
+		int64_t capacity() const { return mask + 1; }
+		Job* get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+		void put(int64_t i, Job* job) { slots[i & mask].store(job, std::memory_order_relaxed); }
+
+		int64_t mask;
+		std::vector<std::atomic<Job*>> slots;
+	};
+
+	alignas(64) std::atomic<int64_t> _top{0};
+	alignas(64) std::atomic<int64_t> _bottom{0};
+	std::atomic<Array*> _array;
+	std::vector<std::unique_ptr<Array>> _arrays;
+};
+
+// Worker threads with one work stealing deque each. The thread constructing the
+// system is its main thread: it runs jobs while it waits, and it is the only
+// thread running jobs submitted with submit_main(), e.g. GLFW calls, which must
+// stay on the main thread. Jobs must not throw.
+class JobSystem {
+public:
+	using Function = std::function<void()>;
+
+	// threads running jobs, the main thread included; 0 for one per hardware thread
+	explicit JobSystem(size_t thread_count = 0);
+	// jobs still queued are dropped, wait for their counters first
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// from any thread; the job starts once dependency, if given, is at zero
+	void submit(Function function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+	void submit_main(Function function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+	// runs other jobs until the counter is at zero, so jobs may wait for jobs
+	void wait(JobCounter& counter);
+	// for the main thread's loop, runs the main thread jobs queued so far
+	void run_main_thread_jobs();
+
+	// calls body on about grain sized ranges of [0, count) in parallel and waits for them
+	void parallel_for(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+
+	size_t thread_count() const { return _deques.size(); }
+	bool on_main_thread() const { return std::this_thread::get_id() == _main_thread; }
+
+private:
+	void worker_loop(size_t index);
+	// ready to run: to the calling worker's deque, the main queue or the shared queue
+	void schedule(Job* job);
+	void enqueue(Job* job, JobCounter* dependency);
+	Job* find_job(size_t index, bool main_thread);
+	void execute(Job* job);
+	void wake_one();
+	// index of the calling thread's deque, or thread_count() for threads of other systems
+	size_t current_index() const;
+
+private:
+	std::thread::id _main_thread;
+	std::vector<std::unique_ptr<WorkStealingDeque>> _deques;
+	std::vector<std::thread> _threads;
+
+	// submissions from threads without a deque of this system
+	std::mutex _shared_mutex;
+	std::deque<Job*> _shared_jobs;
+	std::mutex _main_mutex;
+	std::deque<Job*> _main_jobs;
+
+	// ready jobs not yet taken by a worker, sleeping workers wait for it to rise
+	std::atomic<int64_t> _queued{0};
+	std::atomic<int> _sleepers{0};
+	std::mutex _sleep_mutex;
+	std::condition_variable _work_ready;
+	std::atomic<bool> _stopping{false};
+};
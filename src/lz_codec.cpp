@@ -0,0 +1,190 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "lz_codec.h"
+
+static const size_t MIN_MATCH = 4;
+static const size_t MAX_OFFSET = 65535;
+// the format ends with literals: no match starts in the last 12 bytes or covers the last 5
+static const size_t MATCH_SAFE_DISTANCE = 12;
+static const size_t LAST_LITERALS = 5;
+static const uint32_t HASH_BITS = 16;
+
+static uint32_t read32(const char* p) {
+	uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static uint32_t hash4(uint32_t sequence) {
+	return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+size_t lz_compress_bound(size_t size) {
+	return size + size / 255 + 16;
+}
+
+// lengths from 15 on continue in extra bytes of 255 each
+static bool write_length(size_t length, char*& out, const char* end) {
+	for (; length >= 255; length -= 255) {
+		if (out == end) {
+			return false;
+		}
+		*out++ = static_cast<char>(255);
+	}
+	if (out == end) {
+		return false;
+	}
+	*out++ = static_cast<char>(length);
+	return true;
+}
+
+static bool write_sequence(const char* literals, size_t literalCount, size_t offset, size_t matchLength, char*& out, const char* end) {
+	if (out == end) {
+		return false;
+	}
+	char* token = out++;
+	uint8_t literalNibble = static_cast<uint8_t>(literalCount < 15 ? literalCount : 15);
+	if (literalCount >= 15 && !write_length(literalCount - 15, out, end)) {
+		return false;
+	}
+	if (static_cast<size_t>(end - out) < literalCount) {
+		return false;
+	}
+	if (literalCount > 0) {
+		std::memcpy(out, literals, literalCount);
+		out += literalCount;
+	}
+
+	// the last sequence has literals only
+	if (matchLength == 0) {
+		*token = static_cast<char>(literalNibble << 4);
+		return true;
+	}
+
+	if (end - out < 2) {
+		return false;
+	}
+	*out++ = static_cast<char>(offset & 0xff);
+	*out++ = static_cast<char>(offset >> 8);
+
+	size_t matchExtra = matchLength - MIN_MATCH;
+	uint8_t matchNibble = static_cast<uint8_t>(matchExtra < 15 ? matchExtra : 15);
+	if (matchExtra >= 15 && !write_length(matchExtra - 15, out, end)) {
+		return false;
+	}
+	*token = static_cast<char>((literalNibble << 4) | matchNibble);
+	return true;
+}
+
+size_t lz_compress(const char* source, size_t size, char* destination, size_t capacity) {
+	char* out = destination;
+	const char* end = destination + capacity;
+	const char* anchor = source;
+
+	if (size > MATCH_SAFE_DISTANCE) {
+		// positions of the last occurrence of each hashed 4 byte sequence
+		std::vector<uint32_t> table(size_t(1) << HASH_BITS, UINT32_MAX);
+		const char* matchLimit = source + size - LAST_LITERALS;
+		const char* searchLimit = source + size - MATCH_SAFE_DISTANCE;
+
+		for (const char* p = source; p < searchLimit; ) {
+			uint32_t sequence = read32(p);
+			uint32_t& slot = table[hash4(sequence)];
+			uint32_t candidate = slot;
+			slot = static_cast<uint32_t>(p - source);
+
+			size_t offset = candidate == UINT32_MAX ? 0 : static_cast<size_t>(p - source) - candidate;
+			if (offset == 0 || offset > MAX_OFFSET || read32(source + candidate) != sequence) {
+				++p;
+				continue;
+			}
+
+			const char* match = source + candidate;
+			size_t length = MIN_MATCH;
+			while (p + length < matchLimit && p[length] == match[length]) {
+				++length;
+			}
+
+			if (!write_sequence(anchor, static_cast<size_t>(p - anchor), offset, length, out, end)) {
+				return 0;
+			}
+			p += length;
+			anchor = p;
+		}
+	}
+
+	if (!write_sequence(anchor, static_cast<size_t>(source + size - anchor), 0, 0, out, end)) {
+		return 0;
+	}
+	return static_cast<size_t>(out - destination);
+}
+
+static bool read_length(size_t& length, const char*& in, const char* end) {
+	uint8_t byte;
+	do {
+		if (in == end) {
+			return false;
+		}
+		byte = static_cast<uint8_t>(*in++);
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+bool lz_decompress(const char* source, size_t size, char* destination, size_t raw_size) {
+	const char* in = source;
+	const char* inEnd = source + size;
+	char* out = destination;
+	char* outEnd = destination + raw_size;
+
+	while (in < inEnd) {
+		uint8_t token = static_cast<uint8_t>(*in++);
+
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !read_length(literalCount, in, inEnd)) {
+			return false;
+		}
+		if (static_cast<size_t>(inEnd - in) < literalCount || static_cast<size_t>(outEnd - out) < literalCount) {
+			return false;
+		}
+		if (literalCount > 0) {
+			std::memcpy(out, in, literalCount);
+			in += literalCount;
+			out += literalCount;
+		}
+
+		// the last sequence ends after its literals
+		if (in == inEnd) {
+			break;
+		}
+
+		if (inEnd - in < 2) {
+			return false;
+		}
+		size_t offset = static_cast<uint8_t>(in[0]) | (static_cast<size_t>(static_cast<uint8_t>(in[1])) << 8);
+		in += 2;
+
+		size_t matchLength = token & 0x0f;
+		if (matchLength == 15 && !read_length(matchLength, in, inEnd)) {
+			return false;
+		}
+		matchLength += MIN_MATCH;
+
+		if (offset == 0 || offset > static_cast<size_t>(out - destination) || static_cast<size_t>(outEnd - out) < matchLength) {
+			return false;
+		}
+		// byte by byte where the match overlaps what it writes, e.g. runs of one byte
+		const char* match = out - offset;
+		if (offset >= matchLength) {
+			std::memcpy(out, match, matchLength);
+			out += matchLength;
+		} else {
+			for (size_t i = 0; i < matchLength; ++i) {
+				*out++ = *match++;
+			}
+		}
+	}
+	return out == outEnd;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+// Byte oriented LZ77 in the LZ4 block format: sequences of a token, literals and a
+// 16 bit back reference. Decoding is a loop of copies, fast enough that reading
+// compressed data beats reading more bytes from a slow disk or network mount.
+
+// worst case size of compressing size bytes
+size_t lz_compress_bound(size_t size);
+
+// Returns the compressed size, or 0 when the result would not fit capacity.
+size_t lz_compress(const char* source, size_t size, char* destination, size_t capacity);
+
+// Decodes exactly raw_size bytes; false when the input is malformed or does not
+// decode to raw_size bytes. Never reads or writes outside the given ranges.
+bool lz_decompress(const char* source, size_t size, char* destination, size_t raw_size);
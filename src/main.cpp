@@ -1,12 +1,134 @@
 #include <iostream>
 #include <cstdlib>
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdexcept>
 
 #include "application.h"
+#include "batch_renderer.h"
 
-int main() {
-	Application app;
+static const char* USAGE =
+	"usage: vulkan [options]\n"
+	"  --model <path>             model to show, OBJ or glTF binary\n"
+	"  --assets <path>            asset archive to load from\n"
+	"  --device <name>            physical device to use\n"
+	"  --present-mode <mode>      present mode policy\n"
+	"  --fps <rate>               frame rate limit, 0 for none\n"
+	"  --aa <mode>                anti-aliasing mode\n"
+	"  --depth-prepass            lay down depth before shading\n"
+	"  --no-dynamic-rendering     use render pass objects\n"
+	"  --no-async-compute         cull on the graphics queue\n"
+	"  --just-in-time             start frames as late as the limit allows\n"
+	"  --on-demand                only render when something changes\n"
+	"  --pipelined                simulate the next frame while this one is recorded\n"
+	"  --bench-prepass            measure the depth pre-pass and exit\n"
+	"  --capture <path>           stream presented frames to path\n"
+	"  --batch <views>            render the views to PNG files and exit\n"
+	"  --batch-output <dir>       directory of the batch renders\n"
+	"  --batch-devices <list>     all, or comma separated device indices and names\n"
+	"  --golden <dir>             compare the batch renders with the goldens in dir\n"
+	"  --golden-psnr <db>         lowest PSNR that still matches a golden\n"
+	"  --golden-update            rewrite the goldens instead\n";
 
+// the whole argument has to be a number
+static double parse_number(const std::string& flag, const std::string& value) {
+	size_t end = 0;
+	double number = 0.0;
 	try {
+		number = std::stod(value, &end);
+	} catch (const std::exception&) {
+		end = 0;
+	}
+	if (end == 0 || end != value.size()) {
+		throw std::runtime_error("invalid number " + value + " for " + flag + "!");
+	}
+	return number;
+}
+
+int main(int argc, char** argv) {
+	try {
+		// collected first, a batch applies them to every render worker
+		std::vector<std::function<void(Application&)>> options;
+		BatchSettings batch;
+
+		for (int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			if (arg == "--depth-prepass") {
+				options.push_back([](Application& app) { app.set_depth_prepass(true); });
+			} else if (arg == "--no-dynamic-rendering") {
+				options.push_back([](Application& app) { app.set_dynamic_rendering_allowed(false); });
+			} else if (arg == "--device" && i + 1 < argc) {
+				std::string device = argv[++i];
+				options.push_back([device](Application& app) { app.set_device(device); });
+			} else if (arg == "--no-async-compute") {
+				options.push_back([](Application& app) { app.set_async_compute_allowed(false); });
+			} else if (arg == "--present-mode" && i + 1 < argc) {
+				auto mode = PresentPolicy::parse_mode(argv[++i]);
+				if (!mode) {
+					std::cout << "unknown present mode " << argv[i] << std::endl;
+					return EXIT_FAILURE;
+				}
+				options.push_back([mode = *mode](Application& app) { app.set_present_mode(mode); });
+			} else if (arg == "--fps" && i + 1 < argc) {
+				double fps = parse_number(arg, argv[++i]);
+				options.push_back([fps](Application& app) { app.set_frame_rate_limit(fps); });
+			} else if (arg == "--just-in-time") {
+				options.push_back([](Application& app) { app.set_just_in_time(true); });
+			} else if (arg == "--on-demand") {
+				options.push_back([](Application& app) { app.set_on_demand(true); });
+			} else if (arg == "--pipelined") {
+				options.push_back([](Application& app) { app.set_frame_pipelining(true); });
+			} else if (arg == "--bench-prepass") {
+				options.push_back([](Application& app) { app.set_prepass_benchmark(true); });
+			} else if (arg == "--aa" && i + 1 < argc) {
+				auto policy = AntiAliasingPolicy::parse(argv[++i]);
+				if (!policy) {
+					std::cout << "unknown anti-aliasing mode " << argv[i] << std::endl;
+					return EXIT_FAILURE;
+				}
+				options.push_back([policy = *policy](Application& app) { app.set_anti_aliasing(policy); });
+			} else if (arg == "--model" && i + 1 < argc) {
+				std::string path = argv[++i];
+				options.push_back([path](Application& app) { app.set_model(path); });
+			} else if (arg == "--assets" && i + 1 < argc) {
+				std::string path = argv[++i];
+				options.push_back([path](Application& app) { app.set_asset_archive(path); });
+			} else if (arg == "--capture" && i + 1 < argc) {
+				std::string path = argv[++i];
+				options.push_back([path](Application& app) { app.set_capture(path); });
+			} else if (arg == "--batch" && i + 1 < argc) {
+				batch.views_path = argv[++i];
+			} else if (arg == "--batch-output" && i + 1 < argc) {
+				batch.output_dir = argv[++i];
+			} else if (arg == "--batch-devices" && i + 1 < argc) {
+				batch.devices = argv[++i];
+			} else if (arg == "--golden" && i + 1 < argc) {
+				batch.golden.golden_dir = argv[++i];
+			} else if (arg == "--golden-psnr" && i + 1 < argc) {
+				batch.golden.min_psnr = parse_number(arg, argv[++i]);
+			} else if (arg == "--golden-update") {
+				batch.golden.update = true;
+			} else {
+				// unknown, or missing its value
+				std::cout << "unknown argument " << arg << "\n" << USAGE;
+				return EXIT_FAILURE;
+			}
+		}
+
+		auto configure = [&options](Application& app) {
+			for (const auto& option : options) {
+				option(app);
+			}
+		};
+
+		if (!batch.views_path.empty()) {
+			batch.configure = configure;
+			return run_batch(batch);
+		}
+
+		Application app;
+		configure(app);
 		app.run();
 	} catch (std::exception& e) {
 		std::cout << e.what() << std::endl;
@@ -14,4 +136,4 @@ int main() {
 	}
 
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,356 @@
+#include <stdexcept>
+#include <unordered_map>
+#include <istream>
+#include <streambuf>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+#include <atomic>
+#include <functional>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include "model_loader.h"
+#include "blob_cache.h"
+#include "job_system.h"
+#include "obj_parser.h"
+
+// an istream over memory it does not own, so the parser reads a mapped file in place
+class SpanStreamBuffer : public std::streambuf {
+public:
+	explicit SpanStreamBuffer(std::span<const char> data) {
+		// only read; putting back the character just read moves the pointer without writing
+		char* begin = const_cast<char*>(data.data());
+		setg(begin, begin, begin + data.size());
+	}
+};
+
+void compute_bounds(Model& model) {
+	for (auto& submesh : model.submeshes) {
+		if (submesh.index_count == 0) {
+			continue;
+		}
+		submesh.bounds_min = submesh.bounds_max = model.vertices[model.indices[submesh.first_index]].pos;
+		for (uint32_t i = submesh.first_index; i < submesh.first_index + submesh.index_count; ++i) {
+			submesh.bounds_min = glm::min(submesh.bounds_min, model.vertices[model.indices[i]].pos);
+			submesh.bounds_max = glm::max(submesh.bounds_max, model.vertices[model.indices[i]].pos);
+		}
+	}
+
+	if (!model.vertices.empty()) {
+		model.bounds_min = model.bounds_max = model.vertices[0].pos;
+		for (const auto& vertex : model.vertices) {
+			model.bounds_min = glm::min(model.bounds_min, vertex.pos);
+			model.bounds_max = glm::max(model.bounds_max, vertex.pos);
+		}
+	}
+}
+
+Model load_model_file(const std::string& path, std::span<const char> contents, JobSystem* jobs) {
+	auto extension = std::filesystem::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {
+		return static_cast<char>(std::tolower(c));
+	});
+	// tinyobj's material reader appends the file name to the directory as it is
+	auto directory = std::filesystem::path(path).parent_path().string();
+	directory = directory.empty() ? "" : directory + "/";
+
+	if (extension == ".obj") {
+		return jobs != nullptr ? load_obj_model(contents, directory, *jobs) : load_obj_model(contents, directory);
+	} else if (extension == ".glb") {
+		return load_glb_model(contents, directory);
+	}
+	throw std::runtime_error("unsupported model format " + path + "!");
+}
+
+Model load_obj_model(const std::string& path) {
+	FileBlob blob(path);
+	// tinyobj's material reader appends the file name to the directory as it is
+	auto directory = std::filesystem::path(path).parent_path().string();
+	return load_obj_model(blob.span(), directory.empty() ? "" : directory + "/");
+}
+
+// corners handed to one job when building and deduplicating vertices
+static const size_t OBJ_CORNER_GRAIN = 1 << 16;
+// fewer corners are deduplicated with one hash map even when a job system is given
+static const size_t PARALLEL_DEDUP_MIN_CORNERS = 1 << 18;
+// dedup partitions per thread, so partitions of many distinct vertices even out
+static const size_t DEDUP_PARTITIONS_PER_THREAD = 4;
+
+static void run_ranges(JobSystem* jobs, size_t count, const std::function<void(size_t, size_t)>& fn) {
+	if (jobs != nullptr) {
+		jobs->parallel_for(count, OBJ_CORNER_GRAIN, fn);
+	} else {
+		fn(0, count);
+	}
+}
+
+// The distinct vertices of corners numbered in the order they first appear, as one hash
+// map filled front to back numbers them. With a job system, corners are partitioned by
+// hash so each partition finds its duplicates alone; a vertex's number is then the count
+// of first appearances before its own, a prefix sum over the stream.
+static void deduplicate(const std::vector<Vertex>& corners, JobSystem* jobs, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	indices.resize(corners.size());
+	if (jobs == nullptr || corners.size() < PARALLEL_DEDUP_MIN_CORNERS) {
+		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+		for (size_t i = 0; i < corners.size(); ++i) {
+			auto [it, inserted] = uniqueVertices.emplace(corners[i], static_cast<uint32_t>(vertices.size()));
+			if (inserted) {
+				vertices.push_back(corners[i]);
+			}
+			indices[i] = it->second;
+		}
+		return;
+	}
+
+	size_t cornerCount = corners.size();
+	size_t partitions = std::min<size_t>(jobs->thread_count() * DEDUP_PARTITIONS_PER_THREAD, 256);
+	size_t blocks = (cornerCount + OBJ_CORNER_GRAIN - 1) / OBJ_CORNER_GRAIN;
+	auto blockRange = [&](size_t block) {
+		return std::pair(block * OBJ_CORNER_GRAIN, std::min(cornerCount, (block + 1) * OBJ_CORNER_GRAIN));
+	};
+
+	// the corners of each partition grouped together, in stream order within it
+	std::vector<uint8_t> partitionOf(cornerCount);
+	std::vector<uint32_t> cursors(blocks * partitions, 0);
+	jobs->parallel_for(blocks, 1, [&](size_t begin, size_t end) {
+		std::hash<Vertex> hasher;
+		for (size_t block = begin; block < end; ++block) {
+			auto [first, last] = blockRange(block);
+			for (size_t i = first; i < last; ++i) {
+				partitionOf[i] = static_cast<uint8_t>(hasher(corners[i]) % partitions);
+				++cursors[block * partitions + partitionOf[i]];
+			}
+		}
+	});
+	std::vector<size_t> partitionStarts(partitions + 1, 0);
+	uint32_t offset = 0;
+	for (size_t partition = 0; partition < partitions; ++partition) {
+		partitionStarts[partition] = offset;
+		for (size_t block = 0; block < blocks; ++block) {
+			uint32_t count = cursors[block * partitions + partition];
+			cursors[block * partitions + partition] = offset;
+			offset += count;
+		}
+	}
+	partitionStarts[partitions] = offset;
+
+	std::vector<uint32_t> grouped(cornerCount);
+	jobs->parallel_for(blocks, 1, [&](size_t begin, size_t end) {
+		for (size_t block = begin; block < end; ++block) {
+			auto [first, last] = blockRange(block);
+			for (size_t i = first; i < last; ++i) {
+				grouped[cursors[block * partitions + partitionOf[i]]++] = static_cast<uint32_t>(i);
+			}
+		}
+	});
+
+	// per corner, where its vertex first appears
+	std::vector<uint32_t> firstCorner(cornerCount);
+	std::vector<uint8_t> isFirst(cornerCount, 0);
+	jobs->parallel_for(partitions, 1, [&](size_t begin, size_t end) {
+		for (size_t partition = begin; partition < end; ++partition) {
+			std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+			for (size_t j = partitionStarts[partition]; j < partitionStarts[partition + 1]; ++j) {
+				uint32_t i = grouped[j];
+				auto [it, inserted] = uniqueVertices.emplace(corners[i], i);
+				isFirst[i] = inserted;
+				firstCorner[i] = it->second;
+			}
+		}
+	});
+
+	std::vector<uint32_t> blockStarts(blocks + 1, 0);
+	jobs->parallel_for(blocks, 1, [&](size_t begin, size_t end) {
+		for (size_t block = begin; block < end; ++block) {
+			auto [first, last] = blockRange(block);
+			blockStarts[block + 1] = static_cast<uint32_t>(std::count(isFirst.begin() + first, isFirst.begin() + last, 1));
+		}
+	});
+	for (size_t block = 0; block < blocks; ++block) {
+		blockStarts[block + 1] += blockStarts[block];
+	}
+
+	// the numbers go where grouped was, it is no longer needed
+	auto& numbers = grouped;
+	vertices.resize(blockStarts[blocks]);
+	jobs->parallel_for(blocks, 1, [&](size_t begin, size_t end) {
+		for (size_t block = begin; block < end; ++block) {
+			auto [first, last] = blockRange(block);
+			uint32_t number = blockStarts[block];
+			for (size_t i = first; i < last; ++i) {
+				if (isFirst[i]) {
+					vertices[number] = corners[i];
+					numbers[i] = number++;
+				}
+			}
+		}
+	});
+	jobs->parallel_for(cornerCount, OBJ_CORNER_GRAIN, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			indices[i] = numbers[firstCorner[i]];
+		}
+	});
+}
+
+// Groups the triangles of every shape by material, in the order the shape first uses
+// them, and stores each distinct vertex once. Shared by tinyobj's and the parallel
+// parser's output, so both give the same model.
+static Model build_obj_model(const ObjGeometry& geometry, const std::string& material_dir, JobSystem* jobs) {
+	Model model;
+	for (const auto& source : geometry.materials) {
+		ModelMaterial material;
+		material.name = source.name;
+		material.base_color = {source.diffuse[0], source.diffuse[1], source.diffuse[2]};
+		material.vertex_color = material.base_color != glm::vec3(1.0f);
+		// the cut out is read from the diffuse texture's alpha, where exporters put it as well
+		material.alpha_test = !source.alpha_texname.empty();
+		if (!source.diffuse_texname.empty()) {
+			material.texture_path = material_dir + source.diffuse_texname;
+		}
+		model.materials.push_back(std::move(material));
+	}
+	// faces without a material share a white one, added when there are any
+	auto defaultMaterial = static_cast<uint32_t>(model.materials.size());
+	auto materialOf = [&](size_t face) {
+		int32_t id = geometry.face_materials[face];
+		return id >= 0 && static_cast<size_t>(id) < geometry.materials.size() ? static_cast<uint32_t>(id) : defaultMaterial;
+	};
+
+	// triangles in output order, sorted by counting within each shape
+	std::vector<uint32_t> order(geometry.position_indices.size() / 3);
+	std::vector<uint32_t> bucketOf(defaultMaterial + 1, UINT32_MAX);
+	for (size_t shape = 0; shape + 1 < geometry.shape_starts.size(); ++shape) {
+		size_t shapeBegin = geometry.shape_starts[shape], shapeEnd = geometry.shape_starts[shape + 1];
+
+		// materials in the order the shape first uses them, one submesh each
+		std::vector<uint32_t> shapeMaterials;
+		std::vector<size_t> counts;
+		for (size_t face = shapeBegin; face < shapeEnd; ++face) {
+			uint32_t material = materialOf(face);
+			if (bucketOf[material] == UINT32_MAX) {
+				bucketOf[material] = static_cast<uint32_t>(shapeMaterials.size());
+				shapeMaterials.push_back(material);
+				counts.push_back(0);
+			}
+			++counts[bucketOf[material]];
+		}
+
+		std::vector<size_t> next(shapeMaterials.size());
+		size_t start = shapeBegin;
+		for (size_t bucket = 0; bucket < shapeMaterials.size(); ++bucket) {
+			Submesh submesh;
+			submesh.first_index = static_cast<uint32_t>(3 * start);
+			submesh.index_count = static_cast<uint32_t>(3 * counts[bucket]);
+			submesh.material = shapeMaterials[bucket];
+			model.submeshes.push_back(submesh);
+
+			next[bucket] = start;
+			start += counts[bucket];
+		}
+		for (size_t face = shapeBegin; face < shapeEnd; ++face) {
+			order[next[bucketOf[materialOf(face)]]++] = static_cast<uint32_t>(face);
+		}
+		for (auto material : shapeMaterials) {
+			bucketOf[material] = UINT32_MAX;
+		}
+	}
+
+	// every corner's vertex in output order, duplicates included
+	std::vector<Vertex> corners(3 * order.size());
+	std::atomic<bool> outOfRange{false};
+	auto positionCount = static_cast<int64_t>(geometry.positions.size() / 3);
+	auto texcoordCount = static_cast<int64_t>(geometry.texcoords.size() / 2);
+	run_ranges(jobs, order.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			uint32_t material = materialOf(order[i]);
+			glm::vec3 color = material == defaultMaterial ? glm::vec3(1.0f) : model.materials[material].base_color;
+			for (size_t corner = 0; corner < 3; ++corner) {
+				int32_t position = geometry.position_indices[3 * order[i] + corner];
+				int32_t texcoord = geometry.texcoord_indices[3 * order[i] + corner];
+				if (position < 0 || position >= positionCount || texcoord < -1 || texcoord >= texcoordCount) {
+					outOfRange.store(true, std::memory_order_relaxed);
+					continue;
+				}
+
+				Vertex vertex{};
+
+				vertex.pos = {
+					geometry.positions[3 * position + 0],
+					geometry.positions[3 * position + 1],
+					geometry.positions[3 * position + 2]
+				};
+
+				if (texcoord >= 0) {
+					vertex.texCoord = {
+						geometry.texcoords[2 * texcoord + 0],
+						1.0f - geometry.texcoords[2 * texcoord + 1]
+					};
+				}
+
+				vertex.color = color;
+				corners[3 * i + corner] = vertex;
+			}
+		}
+	});
+	if (outOfRange) {
+		throw std::runtime_error("OBJ face index out of range!");
+	}
+
+	deduplicate(corners, jobs, model.vertices, model.indices);
+
+	if (std::any_of(model.submeshes.begin(), model.submeshes.end(), [defaultMaterial](const Submesh& submesh) {
+		return submesh.material == defaultMaterial;
+	})) {
+		model.materials.emplace_back().name = "default";
+	}
+	compute_bounds(model);
+	return model;
+}
+
+static Model load_obj_with_tinyobj(std::span<const char> obj, const std::string& material_dir, JobSystem* jobs) {
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	ObjGeometry geometry;
+	std::string warn, err;
+
+	SpanStreamBuffer buffer(obj);
+	std::istream stream(&buffer);
+	tinyobj::MaterialFileReader materialReader(material_dir);
+	if (!tinyobj::LoadObj(&attrib, &shapes, &geometry.materials, &warn, &err, &stream, &materialReader)) {
+		throw std::runtime_error(warn + err);
+	}
+
+	geometry.positions = std::move(attrib.vertices);
+	geometry.texcoords = std::move(attrib.texcoords);
+	geometry.shape_starts.push_back(0);
+	for (const auto& shape : shapes) {
+		// LoadObj triangulates, every face has three indices
+		size_t faceCount = shape.mesh.indices.size() / 3;
+		for (size_t corner = 0; corner < 3 * faceCount; ++corner) {
+			geometry.position_indices.push_back(shape.mesh.indices[corner].vertex_index);
+			geometry.texcoord_indices.push_back(std::max(shape.mesh.indices[corner].texcoord_index, -1));
+		}
+		for (size_t face = 0; face < faceCount; ++face) {
+			geometry.face_materials.push_back(face < shape.mesh.material_ids.size() ? shape.mesh.material_ids[face] : -1);
+		}
+		if (faceCount > 0) {
+			geometry.shape_starts.push_back(geometry.face_materials.size());
+		}
+	}
+	return build_obj_model(geometry, material_dir, jobs);
+}
+
+Model load_obj_model(std::span<const char> obj, const std::string& material_dir) {
+	return load_obj_with_tinyobj(obj, material_dir, nullptr);
+}
+
+Model load_obj_model(std::span<const char> obj, const std::string& material_dir, JobSystem& jobs) {
+	ObjGeometry geometry;
+	if (!parse_obj(obj, material_dir, jobs, geometry)) {
+		// faces of more than three corners are left to tinyobj's triangulation
+		return load_obj_with_tinyobj(obj, material_dir, &jobs);
+	}
+	return build_obj_model(geometry, material_dir, &jobs);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <span>
+#include <vector>
+
+#include "vertex.h"
+
+class JobSystem;
+
+// Surface of a part of a model. The base color is baked into the vertex colors.
+struct ModelMaterial {
+	std::string name;
+	glm::vec3 base_color{1.0f};
+	// vertices of this material are not all white, so the vertex colors must be applied
+	bool vertex_color = false;
+	// fragments below half opacity are discarded: OBJ materials with an alpha map, glTF MASK and BLEND
+	bool alpha_test = false;
+	// the base color texture, a file or an image embedded in the model file; neither when untextured
+	std::string texture_path;
+	std::vector<char> texture_data;
+
+	bool textured() const { return !texture_path.empty() || !texture_data.empty(); }
+};
+
+// A range of the model's index buffer drawn with one material.
+struct Submesh {
+	uint32_t first_index = 0;
+	uint32_t index_count = 0;
+	// into Model::materials
+	uint32_t material = 0;
+	// model space bounds, for culling
+	glm::vec3 bounds_min{0.0f};
+	glm::vec3 bounds_max{0.0f};
+};
+
+// Indexed mesh of a model file, with every distinct vertex stored once. All submeshes
+// share the vertex and index arrays; their indices are absolute.
+struct Model {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<Submesh> submeshes;
+	// parts the file gives no material get a plain white one
+	std::vector<ModelMaterial> materials;
+	// model space bounds, for culling
+	glm::vec3 bounds_min{0.0f};
+	glm::vec3 bounds_max{0.0f};
+};
+
+// An OBJ file with a submesh per shape and material, throws when the file can not be read.
+Model load_obj_model(const std::string& path);
+// the same from OBJ text in memory, e.g. a mapped file; material libraries are looked up in material_dir
+Model load_obj_model(std::span<const char> obj, const std::string& material_dir);
+// the same model, parsed and deduplicated on the job system's workers; for large files
+Model load_obj_model(std::span<const char> obj, const std::string& material_dir, JobSystem& jobs);
+// The default scene of a binary glTF 2.0 file, with a submesh per triangle primitive.
+// Accessors are read in place from the file's binary chunk. Node transforms are baked
+// into the vertices, and glTF's Y up is turned into the Z up of the renderer. Image
+// files the materials refer to are looked up in base_dir; buffers must be in the file.
+Model load_glb_model(std::span<const char> glb, const std::string& base_dir);
+// sets the bounds of every submesh and of the whole model from its vertices
+void compute_bounds(Model& model);
+// by the extension of path, ".obj" or ".glb"; contents are the file's bytes. OBJ files
+// are parsed in parallel when a job system is given.
+Model load_model_file(const std::string& path, std::span<const char> contents, JobSystem* jobs = nullptr);
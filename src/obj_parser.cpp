@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+#include "obj_parser.h"
+#include "job_system.h"
+
+// smaller files are one chunk, larger ones are split into about this much text per chunk at least
+static const size_t OBJ_MIN_CHUNK_SIZE = 1 << 20;
+// more chunks than threads, so chunks of slower lines even out
+static const size_t OBJ_CHUNKS_PER_THREAD = 4;
+
+// The lines of one chunk. Indices counting back from the end are resolved against
+// the chunk's own counts, and the counts of earlier chunks are added when merging.
+struct ObjChunk {
+	enum class DirectiveType { MTLLIB, USEMTL, GROUP };
+
+	// applied in file order while merging: they depend on the lines before them
+	struct Directive {
+		DirectiveType type;
+		// triangles of the chunk before it
+		size_t face;
+		std::string argument;
+	};
+
+	std::vector<float> positions;
+	std::vector<float> texcoords;
+	std::vector<int32_t> position_indices;
+	std::vector<int32_t> texcoord_indices;
+	// corners whose index is relative to the chunk
+	std::vector<size_t> relative_positions;
+	std::vector<size_t> relative_texcoords;
+	std::vector<Directive> directives;
+	// jobs must not throw, the first error is kept instead
+	std::string error;
+};
+
+static bool is_space(char c) {
+	return c == ' ' || c == '\t';
+}
+
+static void skip_spaces(const char*& p, const char* end) {
+	while (p < end && is_space(*p)) {
+		++p;
+	}
+}
+
+// tinyobj's parseReal: the token up to the next space, read as a double and
+// rounded to float; the default when it does not start like a number
+static float parse_float(const char*& p, const char* end, float default_value = 0.0f) {
+	skip_spaces(p, end);
+	const char* begin = p;
+	while (p < end && !is_space(*p)) {
+		++p;
+	}
+
+	if (begin < p && *begin == '+') {
+		++begin;
+	}
+	// from_chars would also take inf and nan, tinyobj does not
+	const char* digits = begin < p && *begin == '-' ? begin + 1 : begin;
+	if (digits == p || !(std::isdigit(static_cast<unsigned char>(*digits)) || *digits == '.')) {
+		return default_value;
+	}
+
+	double value = default_value;
+	std::from_chars(begin, p, value);
+	return static_cast<float>(value);
+}
+
+// tinyobj's atoi of a face index: the token up to the next '/' or space, 0 when it is no number
+static int parse_index(const char*& p, const char* end) {
+	const char* begin = p;
+	while (p < end && *p != '/' && !is_space(*p)) {
+		++p;
+	}
+
+	if (begin < p && *begin == '+') {
+		++begin;
+	}
+	int value = 0;
+	std::from_chars(begin, p, value);
+	return value;
+}
+
+// positive indices count from 1, negative ones back from the last element read so far
+static void add_index(int index, size_t count, std::vector<int32_t>& indices, std::vector<size_t>& relative) {
+	if (index > 0) {
+		indices.push_back(index - 1);
+	} else {
+		relative.push_back(indices.size());
+		indices.push_back(static_cast<int32_t>(count) + index);
+	}
+}
+
+// v, v/vt, v//vn or v/vt/vn per corner; normals are checked but not kept. Returns the corner count.
+static size_t parse_face(const char* p, const char* end, ObjChunk& chunk) {
+	int positions[3], texcoords[3];
+	size_t corners = 0;
+
+	skip_spaces(p, end);
+	while (p < end) {
+		int position = parse_index(p, end);
+		bool hasTexcoord = false, hasNormal = false;
+		int texcoord = 0, normal = 0;
+		if (p < end && *p == '/') {
+			++p;
+			if (p < end && *p == '/') {
+				++p;
+				hasNormal = true;
+				normal = parse_index(p, end);
+			} else {
+				hasTexcoord = true;
+				texcoord = parse_index(p, end);
+				if (p < end && *p == '/') {
+					++p;
+					hasNormal = true;
+					normal = parse_index(p, end);
+				}
+			}
+		}
+
+		// the indices count from 1, like tinyobj a zero fails the whole file
+		if (position == 0 || (hasTexcoord && texcoord == 0) || (hasNormal && normal == 0)) {
+			chunk.error = "failed to parse OBJ face, zero index!";
+			return 0;
+		}
+		if (corners < 3) {
+			positions[corners] = position;
+			texcoords[corners] = hasTexcoord ? texcoord : 0;
+		}
+		++corners;
+		skip_spaces(p, end);
+	}
+
+	if (corners != 3) {
+		return corners;
+	}
+
+	size_t positionCount = chunk.positions.size() / 3;
+	size_t texcoordCount = chunk.texcoords.size() / 2;
+	for (size_t corner = 0; corner < 3; ++corner) {
+		add_index(positions[corner], positionCount, chunk.position_indices, chunk.relative_positions);
+		if (texcoords[corner] == 0) {
+			chunk.texcoord_indices.push_back(-1);
+		} else {
+			add_index(texcoords[corner], texcoordCount, chunk.texcoord_indices, chunk.relative_texcoords);
+		}
+	}
+	return corners;
+}
+
+static bool starts_with_keyword(const char* p, const char* end, const char* keyword) {
+	size_t length = strlen(keyword);
+	return static_cast<size_t>(end - p) > length && memcmp(p, keyword, length) == 0 && is_space(p[length]);
+}
+
+// the keywords tinyobj tells apart, everything else is skipped the same way it is there;
+// false when the chunk can not be read as triangles only
+static bool parse_line(const char* p, const char* end, ObjChunk& chunk) {
+	skip_spaces(p, end);
+	if (end - p < 2) {
+		return true;
+	}
+
+	if (p[0] == 'v' && is_space(p[1])) {
+		p += 2;
+		float x = parse_float(p, end);
+		float y = parse_float(p, end);
+		float z = parse_float(p, end);
+		chunk.positions.insert(chunk.positions.end(), {x, y, z});
+	} else if (starts_with_keyword(p, end, "vt")) {
+		p += 3;
+		float u = parse_float(p, end);
+		float v = parse_float(p, end);
+		chunk.texcoords.insert(chunk.texcoords.end(), {u, v});
+	} else if (p[0] == 'f' && is_space(p[1])) {
+		return parse_face(p + 2, end, chunk) == 3 || !chunk.error.empty();
+	} else if (starts_with_keyword(p, end, "usemtl")) {
+		// the first word only, as tinyobj reads it
+		p += 7;
+		skip_spaces(p, end);
+		const char* name = p;
+		while (p < end && !is_space(*p)) {
+			++p;
+		}
+		chunk.directives.push_back({ObjChunk::DirectiveType::USEMTL, chunk.position_indices.size() / 3, std::string(name, p)});
+	} else if (starts_with_keyword(p, end, "mtllib")) {
+		chunk.directives.push_back({ObjChunk::DirectiveType::MTLLIB, chunk.position_indices.size() / 3, std::string(p + 7, end)});
+	} else if ((p[0] == 'g' || p[0] == 'o') && is_space(p[1])) {
+		chunk.directives.push_back({ObjChunk::DirectiveType::GROUP, chunk.position_indices.size() / 3, {}});
+	}
+	return true;
+}
+
+// stops early once another chunk found a face that is not a triangle
+static void parse_chunk(const char* begin, const char* end, ObjChunk& chunk, std::atomic<bool>& triangles_only) {
+	for (const char* line = begin; line < end && triangles_only.load(std::memory_order_relaxed); ) {
+		// lines end in \n, \r\n or a lone \r, like tinyobj's getline
+		auto newline = static_cast<const char*>(memchr(line, '\n', end - line));
+		const char* lineEnd = newline != nullptr ? newline : end;
+		auto carriageReturn = static_cast<const char*>(memchr(line, '\r', lineEnd - line));
+		if (carriageReturn != nullptr) {
+			lineEnd = carriageReturn;
+		}
+
+		if (!parse_line(line, lineEnd, chunk)) {
+			triangles_only.store(false, std::memory_order_relaxed);
+		}
+		if (!chunk.error.empty()) {
+			return;
+		}
+		line = lineEnd + 1;
+	}
+}
+
+bool parse_obj(std::span<const char> obj, const std::string& material_dir, JobSystem& jobs, ObjGeometry& geometry) {
+	// chunk boundaries move forward to just after a line end
+	size_t chunkCount = std::clamp<size_t>(obj.size() / OBJ_MIN_CHUNK_SIZE, 1, jobs.thread_count() * OBJ_CHUNKS_PER_THREAD);
+	std::vector<size_t> bounds = {0};
+	for (size_t i = 1; i < chunkCount; ++i) {
+		size_t position = std::max(bounds.back(), obj.size() / chunkCount * i);
+		auto newline = static_cast<const char*>(memchr(obj.data() + position, '\n', obj.size() - position));
+		position = newline != nullptr ? static_cast<size_t>(newline - obj.data()) + 1 : obj.size();
+		if (position > bounds.back() && position < obj.size()) {
+			bounds.push_back(position);
+		}
+	}
+	bounds.push_back(obj.size());
+
+	std::vector<ObjChunk> chunks(bounds.size() - 1);
+	std::atomic<bool> trianglesOnly{true};
+	jobs.parallel_for(chunks.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			parse_chunk(obj.data() + bounds[i], obj.data() + bounds[i + 1], chunks[i], trianglesOnly);
+		}
+	});
+
+	for (const auto& chunk : chunks) {
+		if (!chunk.error.empty()) {
+			throw std::runtime_error(chunk.error);
+		}
+	}
+	if (!trianglesOnly) {
+		return false;
+	}
+
+	// where each chunk's elements go in the merged arrays
+	std::vector<size_t> positionBase(chunks.size() + 1, 0), texcoordBase(chunks.size() + 1, 0), cornerBase(chunks.size() + 1, 0);
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		positionBase[i + 1] = positionBase[i] + chunks[i].positions.size();
+		texcoordBase[i + 1] = texcoordBase[i] + chunks[i].texcoords.size();
+		cornerBase[i + 1] = cornerBase[i] + chunks[i].position_indices.size();
+	}
+
+	geometry = ObjGeometry();
+	geometry.positions.resize(positionBase.back());
+	geometry.texcoords.resize(texcoordBase.back());
+	geometry.position_indices.resize(cornerBase.back());
+	geometry.texcoord_indices.resize(cornerBase.back());
+	jobs.parallel_for(chunks.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			auto& chunk = chunks[i];
+			std::copy(chunk.positions.begin(), chunk.positions.end(), geometry.positions.begin() + positionBase[i]);
+			std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), geometry.texcoords.begin() + texcoordBase[i]);
+
+			auto positionOffset = static_cast<int32_t>(positionBase[i] / 3);
+			auto texcoordOffset = static_cast<int32_t>(texcoordBase[i] / 2);
+			for (auto corner : chunk.relative_positions) {
+				chunk.position_indices[corner] += positionOffset;
+			}
+			for (auto corner : chunk.relative_texcoords) {
+				chunk.texcoord_indices[corner] += texcoordOffset;
+			}
+			std::copy(chunk.position_indices.begin(), chunk.position_indices.end(), geometry.position_indices.begin() + cornerBase[i]);
+			std::copy(chunk.texcoord_indices.begin(), chunk.texcoord_indices.end(), geometry.texcoord_indices.begin() + cornerBase[i]);
+
+			// the chunk's arrays are merged, free them while the others are copied
+			chunk.positions = {};
+			chunk.texcoords = {};
+			chunk.position_indices = {};
+			chunk.texcoord_indices = {};
+		}
+	});
+
+	// materials and shapes in file order: a usemtl applies to the faces after it, up to the next
+	tinyobj::MaterialFileReader materialReader(material_dir);
+	std::map<std::string, int> materialMap;
+	int32_t material = -1;
+	size_t faceCount = cornerBase.back() / 3;
+	size_t assigned = 0;
+	geometry.face_materials.resize(faceCount);
+	geometry.shape_starts = {0};
+
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		for (const auto& directive : chunks[i].directives) {
+			size_t face = cornerBase[i] / 3 + directive.face;
+			std::fill(geometry.face_materials.begin() + assigned, geometry.face_materials.begin() + face, material);
+			assigned = face;
+
+			switch (directive.type) {
+			case ObjChunk::DirectiveType::MTLLIB: {
+				// the first of the listed files that loads
+				size_t start = 0;
+				while (start < directive.argument.size()) {
+					size_t stop = std::min(directive.argument.find(' ', start), directive.argument.size());
+					if (stop > start) {
+						std::string warn, err;
+						if (materialReader(directive.argument.substr(start, stop - start), &geometry.materials, &materialMap, &warn, &err)) {
+							break;
+						}
+					}
+					start = stop + 1;
+				}
+				break;
+			}
+			case ObjChunk::DirectiveType::USEMTL: {
+				auto it = materialMap.find(directive.argument);
+				material = it != materialMap.end() ? it->second : -1;
+				break;
+			}
+			case ObjChunk::DirectiveType::GROUP:
+				// shapes without faces are dropped
+				if (face > geometry.shape_starts.back()) {
+					geometry.shape_starts.push_back(face);
+				}
+				break;
+			}
+		}
+	}
+	std::fill(geometry.face_materials.begin() + assigned, geometry.face_materials.end(), material);
+	if (faceCount > geometry.shape_starts.back()) {
+		geometry.shape_starts.push_back(faceCount);
+	}
+	return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+class JobSystem;
+
+// Triangles of an OBJ file as read, before they are grouped by material and their
+// vertices deduplicated. Filled from tinyobj's output or by parse_obj().
+struct ObjGeometry {
+	// xyz per position, uv per texture coordinate
+	std::vector<float> positions;
+	std::vector<float> texcoords;
+	// three corners per triangle, 0 based; the texture coordinate is -1 when a corner has none
+	std::vector<int32_t> position_indices;
+	std::vector<int32_t> texcoord_indices;
+	// per triangle, -1 for none
+	std::vector<int32_t> face_materials;
+	// first triangle of each shape, plus the end
+	std::vector<size_t> shape_starts;
+	std::vector<tinyobj::material_t> materials;
+};
+
+// Reads the OBJ text the way tinyobj does, in chunks split at line boundaries that
+// are parsed in parallel on the job system's workers, then merged in file order.
+// Only triangles are read: false when a face has another number of corners, which
+// tinyobj would triangulate or drop, so the caller can leave those files to it.
+// Throws where tinyobj fails, e.g. on a zero face index.
+bool parse_obj(std::span<const char> obj, const std::string& material_dir, JobSystem& jobs, ObjGeometry& geometry);
@@ -0,0 +1,76 @@
+#include <stdexcept>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "pipeline_compiler.h"
+
+void PipelineCompiler::init(VkDevice device, const std::string& cache_path, size_t thread_count) {
+	_device = device;
+	_cache_path = cache_path;
+
+	// a missing or stale file is fine, the driver checks the header and ignores data it can't use
+	std::vector<char> data;
+	std::ifstream file(cache_path, std::ios::ate | std::ios::binary);
+	if (file.is_open()) {
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(data.data(), data.size());
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(_device, &cacheInfo, nullptr, &_cache) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline cache!");
+	}
+
+	_pool = std::make_unique<ThreadPool>(thread_count);
+}
+
+void PipelineCompiler::destroy() {
+	// joins the workers, so nothing uses the cache past this point
+	_pool.reset();
+
+	if (_cache != VK_NULL_HANDLE) {
+		save_cache();
+		vkDestroyPipelineCache(_device, _cache, nullptr);
+		_cache = VK_NULL_HANDLE;
+	}
+}
+
+std::shared_future<VkPipeline> PipelineCompiler::compile(BuildFunction build) {
+	auto cache = _cache;
+	return _pool->submit([build = std::move(build), cache]() {
+		return build(cache);
+	}).share();
+}
+
+VkPipeline PipelineCompiler::compile_now(const BuildFunction& build) {
+	return build(_cache);
+}
+
+void PipelineCompiler::wait_idle() {
+	_pool->wait_idle();
+}
+
+void PipelineCompiler::save_cache() {
+	size_t size = 0;
+	if (vkGetPipelineCacheData(_device, _cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+		return;
+	}
+
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(_device, _cache, &size, data.data()) != VK_SUCCESS) {
+		return;
+	}
+
+	std::ofstream file(_cache_path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "pipeline compiler: cannot write " << _cache_path << std::endl;
+		return;
+	}
+	file.write(data.data(), size);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <future>
+#include <functional>
+#include <memory>
+
+#include "thread_pool.h"
+
+// Compiles pipelines on a pool of worker threads. All of them go through one
+// VkPipelineCache, which the driver synchronizes internally, and the cache is
+// kept on disk so later runs skip most of the backend compilation.
+class PipelineCompiler {
+public:
+	using BuildFunction = std::function<VkPipeline(VkPipelineCache)>;
+
+	// thread_count 0 picks one per hardware core
+	void init(VkDevice device, const std::string& cache_path, size_t thread_count = 0);
+	// waits for outstanding compiles, then writes the cache back to disk
+	void destroy();
+
+	// build runs on a worker; errors it throws come out of the future's get()
+	std::shared_future<VkPipeline> compile(BuildFunction build);
+
+	// compiles on the calling thread, for the few pipelines nothing can draw without
+	VkPipeline compile_now(const BuildFunction& build);
+
+	void wait_idle();
+
+	VkPipelineCache cache() const { return _cache; }
+
+private:
+	void save_cache();
+
+private:
+	VkDevice _device = VK_NULL_HANDLE;
+	VkPipelineCache _cache = VK_NULL_HANDLE;
+	std::string _cache_path;
+	std::unique_ptr<ThreadPool> _pool;
+};
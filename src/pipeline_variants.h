@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <unordered_map>
+
+// Features a graphics pipeline variant can compile in or out. A variant is keyed by
+// the OR of its features, so each draw can bind the cheapest pipeline that fits it.
+enum PipelineFeature : uint32_t {
+	PIPELINE_FEATURE_VERTEX_COLOR   = 1 << 0,
+	PIPELINE_FEATURE_TEXTURE        = 1 << 1,
+	PIPELINE_FEATURE_ALPHA_TEST     = 1 << 2,
+	PIPELINE_FEATURE_SAMPLE_SHADING = 1 << 3,
+	// pipeline state rather than shader features, see the depth pre-pass
+	PIPELINE_FEATURE_DEPTH_ONLY     = 1 << 4,
+	PIPELINE_FEATURE_DEPTH_EQUAL    = 1 << 5,
+};
+
+using PipelineKey = uint32_t;
+
+// specialization constants of default.frag, must match its constant_id declarations
+struct FragmentSpecialization {
+	VkBool32 use_vertex_color;
+	VkBool32 use_texture;
+	VkBool32 use_alpha_test;
+	float alpha_cutoff;
+
+	static FragmentSpecialization from_key(PipelineKey key) {
+		FragmentSpecialization constants{};
+		constants.use_vertex_color = (key & PIPELINE_FEATURE_VERTEX_COLOR) ? VK_TRUE : VK_FALSE;
+		constants.use_texture = (key & PIPELINE_FEATURE_TEXTURE) ? VK_TRUE : VK_FALSE;
+		constants.use_alpha_test = (key & PIPELINE_FEATURE_ALPHA_TEST) ? VK_TRUE : VK_FALSE;
+		constants.alpha_cutoff = 0.5f;
+		return constants;
+	}
+
+	static std::array<VkSpecializationMapEntry, 4> map_entries() {
+		return {{
+			{0, offsetof(FragmentSpecialization, use_vertex_color), sizeof(VkBool32)},
+			{1, offsetof(FragmentSpecialization, use_texture), sizeof(VkBool32)},
+			{2, offsetof(FragmentSpecialization, use_alpha_test), sizeof(VkBool32)},
+			{3, offsetof(FragmentSpecialization, alpha_cutoff), sizeof(float)},
+		}};
+	}
+};
+
+// Owns a block of specialization constants together with its map entries, so the
+// VkSpecializationInfo it hands out stays valid for as long as the object lives.
+// Constants must provide a static map_entries().
+template <class Constants>
+class Specialization {
+public:
+	explicit Specialization(const Constants& constants)
+		: _constants(constants), _entries(Constants::map_entries()) {
+		_info.mapEntryCount = static_cast<uint32_t>(_entries.size());
+		_info.pMapEntries = _entries.data();
+		_info.dataSize = sizeof(Constants);
+		_info.pData = &_constants;
+	}
+
+	Specialization(const Specialization&) = delete;
+	Specialization& operator=(const Specialization&) = delete;
+
+	const VkSpecializationInfo* info() const { return &_info; }
+
+private:
+	Constants _constants;
+	decltype(Constants::map_entries()) _entries;
+	VkSpecializationInfo _info{};
+};
+
+// Compiled variants of one graphics pipeline, keyed by their feature set.
+class PipelineVariantCache {
+public:
+	VkPipeline find(PipelineKey key) const {
+		auto it = _pipelines.find(key);
+		return it != _pipelines.end() ? it->second : VK_NULL_HANDLE;
+	}
+
+	// returns the pipeline previously stored under key, if any
+	VkPipeline insert(PipelineKey key, VkPipeline pipeline) {
+		auto& slot = _pipelines[key];
+		auto previous = slot;
+		slot = pipeline;
+		return previous;
+	}
+
+	std::vector<PipelineKey> keys() const {
+		std::vector<PipelineKey> keys;
+		for (const auto& [key, pipeline] : _pipelines) {
+			keys.push_back(key);
+		}
+		return keys;
+	}
+
+	void clear(VkDevice device) {
+		for (const auto& [key, pipeline] : _pipelines) {
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+		_pipelines.clear();
+	}
+
+private:
+	std::unordered_map<PipelineKey, VkPipeline> _pipelines;
+};
@@ -0,0 +1,813 @@
+#include <stdexcept>
+#include <algorithm>
+#include <unordered_map>
+
+#include "render_graph.h"
+
+namespace {
+
+struct UsageInfo {
+	VkImageLayout layout;
+	VkPipelineStageFlags stages;
+	VkAccessFlags read_access;
+	VkAccessFlags write_access;
+	VkImageUsageFlags image_usage;
+};
+
+UsageInfo usage_info(RenderGraphUsage usage) {
+	switch (usage) {
+	case RenderGraphUsage::COLOR_ATTACHMENT:
+	case RenderGraphUsage::RESOLVE_ATTACHMENT:
+		return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+	case RenderGraphUsage::DEPTH_ATTACHMENT:
+		return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+	case RenderGraphUsage::DEPTH_READ_ONLY:
+		return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, 0, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+	case RenderGraphUsage::SAMPLED_FRAGMENT:
+		return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_USAGE_SAMPLED_BIT};
+	case RenderGraphUsage::SAMPLED_COMPUTE:
+		return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_USAGE_SAMPLED_BIT};
+	case RenderGraphUsage::STORAGE_COMPUTE:
+		return {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_USAGE_STORAGE_BIT};
+	case RenderGraphUsage::TRANSFER_SRC:
+		return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT, 0, VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+	case RenderGraphUsage::TRANSFER_DST:
+		return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+	}
+
+	throw std::runtime_error("unknown render graph usage!");
+}
+
+bool is_depth_format(VkFormat format) {
+	return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_D32_SFLOAT
+		|| format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+bool is_stencil_format(VkFormat format) {
+	return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+RenderGraph::Pass& RenderGraph::Pass::color(RenderGraphImage image, VkAttachmentLoadOp load, VkClearColorValue clear) {
+	Attachment attachment{image, load, {}};
+	attachment.clear.color = clear;
+	_colors.push_back(attachment);
+	_accesses.push_back({image, RenderGraphUsage::COLOR_ATTACHMENT, load == VK_ATTACHMENT_LOAD_OP_LOAD, true});
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::depth(RenderGraphImage image, VkAttachmentLoadOp load, bool write) {
+	_depth = {image, load, {}};
+	_depth.clear.depthStencil = {1.0f, 0};
+	_depth_write = write;
+	if (write) {
+		_accesses.push_back({image, RenderGraphUsage::DEPTH_ATTACHMENT, load == VK_ATTACHMENT_LOAD_OP_LOAD, true});
+	} else {
+		_accesses.push_back({image, RenderGraphUsage::DEPTH_READ_ONLY, true, false});
+	}
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::resolve(RenderGraphImage image) {
+	_resolves.push_back(image);
+	_accesses.push_back({image, RenderGraphUsage::RESOLVE_ATTACHMENT, false, true});
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::read(RenderGraphImage image, RenderGraphUsage usage) {
+	_accesses.push_back({image, usage, true, false});
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::write(RenderGraphImage image, RenderGraphUsage usage) {
+	_accesses.push_back({image, usage, false, true});
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::side_effect() {
+	_side_effect = true;
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::execute(ExecuteFunction function) {
+	_execute = std::move(function);
+	return *this;
+}
+
+void RenderGraph::init(VkPhysicalDevice physical_device, VkDevice device) {
+	_physical_device = physical_device;
+	_device = device;
+}
+
+void RenderGraph::set_dynamic_rendering(PFN_vkCmdBeginRendering begin, PFN_vkCmdEndRendering end) {
+	_begin_rendering = begin;
+	_end_rendering = end;
+}
+
+void RenderGraph::reset() {
+	for (auto& [key, framebuffer] : _framebuffers) {
+		vkDestroyFramebuffer(_device, framebuffer, nullptr);
+	}
+	_framebuffers.clear();
+
+	for (auto& pass : _passes) {
+		if (pass._render_pass != VK_NULL_HANDLE) {
+			vkDestroyRenderPass(_device, pass._render_pass, nullptr);
+		}
+	}
+	_passes.clear();
+
+	for (auto& resource : _resources) {
+		if (!resource.imported) {
+			vkDestroyImageView(_device, resource.view, nullptr);
+			vkDestroyImage(_device, resource.image, nullptr);
+		}
+	}
+	_resources.clear();
+
+	for (auto memory : _memory) {
+		vkFreeMemory(_device, memory, nullptr);
+	}
+	_memory.clear();
+
+	_final_barriers.clear();
+	_final_src_stages = 0;
+	_final_dst_stages = 0;
+	_aliased_bytes = 0;
+}
+
+RenderGraphImage RenderGraph::create_image(const std::string& name, VkFormat format, VkSampleCountFlagBits samples) {
+	Resource resource{};
+	resource.name = name;
+	resource.format = format;
+	resource.samples = samples;
+	resource.imported = false;
+	resource.final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	_resources.push_back(std::move(resource));
+	return static_cast<RenderGraphImage>(_resources.size() - 1);
+}
+
+RenderGraphImage RenderGraph::import_image(const std::string& name, VkFormat format, VkSampleCountFlagBits samples, VkImageLayout final_layout) {
+	Resource resource{};
+	resource.name = name;
+	resource.format = format;
+	resource.samples = samples;
+	resource.imported = true;
+	resource.final_layout = final_layout;
+	_resources.push_back(std::move(resource));
+	return static_cast<RenderGraphImage>(_resources.size() - 1);
+}
+
+RenderGraph::Pass& RenderGraph::add_pass(const std::string& name) {
+	_passes.emplace_back();
+	_passes.back()._name = name;
+	return _passes.back();
+}
+
+RenderGraphPassId RenderGraph::find_pass(const std::string& name) const {
+	for (size_t i = 0; i < _passes.size(); ++i) {
+		if (_passes[i]._name == name) {
+			return static_cast<RenderGraphPassId>(i);
+		}
+	}
+	return RENDER_GRAPH_NONE;
+}
+
+void RenderGraph::compile(VkExtent2D extent) {
+	_extent = extent;
+
+	cull_passes();
+	derive_usages();
+	allocate_transients();
+	derive_barriers();
+	derive_store_ops();
+	if (!dynamic_rendering()) {
+		create_render_passes();
+	}
+}
+
+void RenderGraph::cull_passes() {
+	// walk backwards from the outputs, keeping every pass that writes something still needed
+	std::vector<bool> needed(_resources.size(), false);
+	for (size_t i = 0; i < _resources.size(); ++i) {
+		needed[i] = _resources[i].imported && _resources[i].final_layout != VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+
+	for (size_t i = _passes.size(); i-- > 0; ) {
+		auto& pass = _passes[i];
+		bool keep = pass._side_effect || std::any_of(pass._accesses.begin(), pass._accesses.end(), [&needed](const Pass::Access& access) {
+			return access.write && needed[access.image];
+		});
+		pass._culled = !keep;
+
+		if (keep) {
+			for (const auto& access : pass._accesses) {
+				if (access.read) {
+					needed[access.image] = true;
+				}
+			}
+		}
+	}
+}
+
+void RenderGraph::derive_usages() {
+	for (uint32_t i = 0; i < _passes.size(); ++i) {
+		if (_passes[i]._culled) {
+			continue;
+		}
+		for (const auto& access : _passes[i]._accesses) {
+			auto& resource = _resources[access.image];
+			resource.usage |= usage_info(access.usage).image_usage;
+			if (resource.first_use == RENDER_GRAPH_NONE) {
+				resource.first_use = i;
+			}
+			if (resource.first_use == i) {
+				resource.first_stages |= usage_info(access.usage).stages;
+			}
+			resource.last_use = i;
+		}
+	}
+
+	// attachments that never leave the tile don't need backing memory on tilers
+	const VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	for (auto& resource : _resources) {
+		if (!resource.imported && resource.usage != 0 && (resource.usage & ~attachment_usage) == 0) {
+			resource.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+	}
+}
+
+void RenderGraph::allocate_transients() {
+	struct Placement {
+		RenderGraphImage image;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	// images can only share memory of a type all of them accept
+	std::unordered_map<uint32_t, std::vector<std::pair<RenderGraphImage, VkMemoryRequirements>>> groups;
+
+	for (uint32_t i = 0; i < _resources.size(); ++i) {
+		auto& resource = _resources[i];
+		if (resource.imported || resource.first_use == RENDER_GRAPH_NONE) {
+			continue;
+		}
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = _extent.width;
+		imageInfo.extent.height = _extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = resource.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = resource.usage;
+		imageInfo.samples = resource.samples;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(_device, &imageInfo, nullptr, &resource.image) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render graph image!");
+		}
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(_device, resource.image, &requirements);
+		groups[requirements.memoryTypeBits].push_back({i, requirements});
+	}
+
+	for (auto& [type_bits, images] : groups) {
+		// big images first leaves fewer holes for the small ones to fill
+		std::sort(images.begin(), images.end(), [](const auto& a, const auto& b) {
+			return a.second.size > b.second.size;
+		});
+
+		std::vector<Placement> placed;
+		VkDeviceSize total = 0;
+		VkDeviceSize requested = 0;
+
+		for (const auto& [image, requirements] : images) {
+			const auto& resource = _resources[image];
+			VkDeviceSize offset = 0;
+
+			// move past every placed image that is alive at the same time and overlaps the range
+			bool moved = true;
+			while (moved) {
+				moved = false;
+				for (const auto& other : placed) {
+					const auto& other_resource = _resources[other.image];
+					bool lifetimes_overlap = !(other_resource.last_use < resource.first_use || resource.last_use < other_resource.first_use);
+					bool ranges_overlap = offset < other.offset + other.size && other.offset < offset + requirements.size;
+					if (lifetimes_overlap && ranges_overlap) {
+						offset = align_up(other.offset + other.size, requirements.alignment);
+						moved = true;
+					}
+				}
+			}
+
+			placed.push_back({image, offset, requirements.size});
+			total = std::max(total, offset + requirements.size);
+			requested += requirements.size;
+		}
+
+		// an image taking over memory must wait for the previous owners to finish with it
+		for (const auto& a : placed) {
+			for (const auto& b : placed) {
+				bool ranges_overlap = a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+				if (a.image == b.image || !ranges_overlap) {
+					continue;
+				}
+				_resources[a.image].shared_memory.push_back(b.image);
+				if (_resources[b.image].last_use < _resources[a.image].first_use) {
+					_resources[a.image].aliases.push_back(b.image);
+				}
+			}
+		}
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = total;
+		allocInfo.memoryTypeIndex = find_memory_type(type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		VkDeviceMemory memory;
+		if (vkAllocateMemory(_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate render graph memory!");
+		}
+		_memory.push_back(memory);
+		_aliased_bytes += requested - total;
+
+		for (const auto& placement : placed) {
+			auto& resource = _resources[placement.image];
+			vkBindImageMemory(_device, resource.image, memory, placement.offset);
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = resource.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = resource.format;
+			viewInfo.subresourceRange.aspectMask = is_depth_format(resource.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+			viewInfo.subresourceRange.baseMipLevel = 0;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = 1;
+
+			if (vkCreateImageView(_device, &viewInfo, nullptr, &resource.view) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create render graph image view!");
+			}
+		}
+	}
+}
+
+std::vector<RenderGraph::State> RenderGraph::record_barriers(std::vector<State> states) {
+	for (uint32_t i = 0; i < _passes.size(); ++i) {
+		auto& pass = _passes[i];
+		pass._barriers.clear();
+		pass._src_stages = 0;
+		pass._dst_stages = 0;
+		if (pass._culled) {
+			continue;
+		}
+
+		for (const auto& access : pass._accesses) {
+			auto& resource = _resources[access.image];
+			auto& state = states[access.image];
+
+			// an image taking over memory within the frame waits for the images that had it
+			if (resource.first_use == i) {
+				for (auto alias : resource.aliases) {
+					state.stages |= states[alias].stages;
+					state.write_access |= states[alias].write_access;
+					state.written = state.written || states[alias].written;
+				}
+			}
+
+			auto info = usage_info(access.usage);
+			VkAccessFlags mask = (access.read ? info.read_access : 0) | (access.write ? info.write_access : 0);
+			add_barrier(pass, access.image, state, info.layout, info.stages, mask, access.write);
+		}
+	}
+	return states;
+}
+
+void RenderGraph::derive_barriers() {
+	// Transient images are shared by all frames in flight. A frame's first use of one must
+	// wait for the previous frame's last use of it, and of every image sharing its memory:
+	// a first walk over the frame finds those end states, the second starts from them.
+	auto ends = record_barriers(std::vector<State>(_resources.size()));
+
+	std::vector<State> starts(_resources.size());
+	for (uint32_t i = 0; i < _resources.size(); ++i) {
+		const auto& resource = _resources[i];
+		if (resource.imported || resource.first_use == RENDER_GRAPH_NONE) {
+			continue;
+		}
+		// the layout stays undefined, the contents are not kept from frame to frame
+		auto& start = starts[i];
+		start.stages = ends[i].stages;
+		start.write_access = ends[i].write_access;
+		for (auto other : resource.shared_memory) {
+			start.stages |= ends[other].stages;
+			start.write_access |= ends[other].write_access;
+		}
+		start.written = start.write_access != 0;
+	}
+
+	auto states = record_barriers(std::move(starts));
+
+	_final_barriers.clear();
+	_final_src_stages = 0;
+	_final_dst_stages = 0;
+	for (uint32_t i = 0; i < _resources.size(); ++i) {
+		const auto& resource = _resources[i];
+		const auto& state = states[i];
+		if (!resource.imported || resource.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || state.stages == 0 || state.layout == resource.final_layout) {
+			continue;
+		}
+		_final_barriers.push_back({i, state.layout, resource.final_layout, state.write_access, 0});
+		_final_src_stages |= state.stages;
+		_final_dst_stages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	}
+}
+
+void RenderGraph::add_barrier(Pass& pass, RenderGraphImage image, State& state, VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags access, bool write) {
+	bool layout_change = state.layout != layout;
+
+	// reads of an image that nobody wrote since the last barrier can run side by side
+	if (!layout_change && !write && !state.written) {
+		state.stages |= stages;
+		return;
+	}
+
+	// only imported images start without stages: their first use is ordered by the
+	// semaphore that hands them over, which must wait on first_stages() of the image
+	VkPipelineStageFlags src_stages = state.stages != 0 ? state.stages : stages;
+
+	if (layout_change || state.written) {
+		pass._barriers.push_back({image, state.layout, layout, state.write_access, access});
+	}
+	pass._src_stages |= src_stages;
+	pass._dst_stages |= stages;
+
+	state.layout = layout;
+	state.stages = stages;
+	state.written = write;
+	state.write_access = write ? access : 0;
+}
+
+void RenderGraph::derive_store_ops() {
+	// attachments only need storing if a later pass or the outside world looks at them
+	std::vector<uint32_t> last_read(_resources.size(), 0);
+	std::vector<bool> read_at_all(_resources.size(), false);
+	for (uint32_t i = 0; i < _passes.size(); ++i) {
+		if (_passes[i]._culled) {
+			continue;
+		}
+		for (const auto& access : _passes[i]._accesses) {
+			if (access.read) {
+				last_read[access.image] = i;
+				read_at_all[access.image] = true;
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < _passes.size(); ++i) {
+		auto& pass = _passes[i];
+		auto store_op = [&](RenderGraphImage image) {
+			bool needed = _resources[image].imported || (read_at_all[image] && last_read[image] > i);
+			return needed ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		};
+
+		pass._color_stores.clear();
+		for (const auto& color : pass._colors) {
+			pass._color_stores.push_back(store_op(color.image));
+		}
+		// nothing is written through a read-only attachment, STORE just keeps the contents
+		if (pass._depth.image != RENDER_GRAPH_NONE) {
+			pass._depth_store = pass._depth_write ? store_op(pass._depth.image) : VK_ATTACHMENT_STORE_OP_STORE;
+		}
+	}
+}
+
+void RenderGraph::create_render_passes() {
+	for (uint32_t i = 0; i < _passes.size(); ++i) {
+		auto& pass = _passes[i];
+		if (pass._culled || !pass.has_attachments()) {
+			continue;
+		}
+
+		// the graph does every layout transition with its own barriers, so attachments
+		// stay in one layout for the whole render pass
+		std::vector<VkAttachmentDescription> attachments;
+		std::vector<VkAttachmentReference> colorRefs;
+		std::vector<VkAttachmentReference> resolveRefs;
+		VkAttachmentReference depthRef{};
+
+		for (size_t c = 0; c < pass._colors.size(); ++c) {
+			const auto& color = pass._colors[c];
+			VkAttachmentDescription attachment{};
+			attachment.format = _resources[color.image].format;
+			attachment.samples = _resources[color.image].samples;
+			attachment.loadOp = color.load;
+			attachment.storeOp = pass._color_stores[c];
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorRefs.push_back({static_cast<uint32_t>(attachments.size()), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+			attachments.push_back(attachment);
+		}
+
+		if (pass._depth.image != RENDER_GRAPH_NONE) {
+			auto layout = pass._depth_write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			VkAttachmentDescription attachment{};
+			attachment.format = _resources[pass._depth.image].format;
+			attachment.samples = _resources[pass._depth.image].samples;
+			attachment.loadOp = pass._depth_write ? pass._depth.load : VK_ATTACHMENT_LOAD_OP_LOAD;
+			attachment.storeOp = pass._depth_store;
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = layout;
+			attachment.finalLayout = layout;
+			depthRef = {static_cast<uint32_t>(attachments.size()), layout};
+			attachments.push_back(attachment);
+		}
+
+		for (auto image : pass._resolves) {
+			VkAttachmentDescription attachment{};
+			attachment.format = _resources[image].format;
+			attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			resolveRefs.push_back({static_cast<uint32_t>(attachments.size()), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+			attachments.push_back(attachment);
+		}
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colorRefs.size());
+		subpass.pColorAttachments = colorRefs.data();
+		subpass.pDepthStencilAttachment = pass._depth.image != RENDER_GRAPH_NONE ? &depthRef : nullptr;
+		subpass.pResolveAttachments = resolveRefs.empty() ? nullptr : resolveRefs.data();
+
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+
+		if (vkCreateRenderPass(_device, &renderPassInfo, nullptr, &pass._render_pass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create render pass!");
+		}
+	}
+}
+
+void RenderGraph::bind_image(RenderGraphImage image, VkImage vk_image, VkImageView view) {
+	_resources[image].image = vk_image;
+	_resources[image].view = view;
+}
+
+void RenderGraph::execute(VkCommandBuffer command_buffer) {
+	for (uint32_t i = 0; i < _passes.size(); ++i) {
+		const auto& pass = _passes[i];
+		if (pass._culled) {
+			continue;
+		}
+
+		emit_barriers(command_buffer, pass._barriers, pass._src_stages, pass._dst_stages);
+
+		if (!pass.has_attachments()) {
+			// compute and transfer passes record straight into the command buffer
+		} else if (dynamic_rendering()) {
+			begin_rendering(command_buffer, i);
+		} else {
+			begin_render_pass(command_buffer, i);
+		}
+
+		if (pass._execute) {
+			pass._execute(command_buffer);
+		}
+
+		if (pass.has_attachments()) {
+			if (dynamic_rendering()) {
+				_end_rendering(command_buffer);
+			} else {
+				vkCmdEndRenderPass(command_buffer);
+			}
+		}
+	}
+
+	emit_barriers(command_buffer, _final_barriers, _final_src_stages, _final_dst_stages);
+}
+
+void RenderGraph::begin_render_pass(VkCommandBuffer command_buffer, RenderGraphPassId id) {
+	const auto& pass = _passes[id];
+
+	std::vector<VkClearValue> clearValues;
+	for (const auto& color : pass._colors) {
+		clearValues.push_back(color.clear);
+	}
+	if (pass._depth.image != RENDER_GRAPH_NONE) {
+		clearValues.push_back(pass._depth.clear);
+	}
+
+	VkRenderPassBeginInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = pass._render_pass;
+	renderPassInfo.framebuffer = get_framebuffer(id);
+	renderPassInfo.renderArea.offset = {0, 0};
+	renderPassInfo.renderArea.extent = _extent;
+	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassInfo.pClearValues = clearValues.data();
+
+	vkCmdBeginRenderPass(command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void RenderGraph::begin_rendering(VkCommandBuffer command_buffer, RenderGraphPassId id) {
+	const auto& pass = _passes[id];
+
+	// layouts match what the barriers before the pass left the images in
+	std::vector<VkRenderingAttachmentInfo> colorAttachments(pass._colors.size());
+	for (size_t c = 0; c < pass._colors.size(); ++c) {
+		auto& attachment = colorAttachments[c];
+		attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		attachment.imageView = _resources[pass._colors[c].image].view;
+		attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachment.loadOp = pass._colors[c].load;
+		attachment.storeOp = pass._color_stores[c];
+		attachment.clearValue = pass._colors[c].clear;
+
+		if (c < pass._resolves.size()) {
+			attachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+			attachment.resolveImageView = _resources[pass._resolves[c]].view;
+			attachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		}
+	}
+
+	VkRenderingAttachmentInfo depthAttachment{};
+	if (pass._depth.image != RENDER_GRAPH_NONE) {
+		depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		depthAttachment.imageView = _resources[pass._depth.image].view;
+		depthAttachment.imageLayout = pass._depth_write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depthAttachment.loadOp = pass._depth_write ? pass._depth.load : VK_ATTACHMENT_LOAD_OP_LOAD;
+		depthAttachment.storeOp = pass._depth_store;
+		depthAttachment.clearValue = pass._depth.clear;
+	}
+
+	VkRenderingInfo renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+	renderingInfo.renderArea.offset = {0, 0};
+	renderingInfo.renderArea.extent = _extent;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+	renderingInfo.pColorAttachments = colorAttachments.data();
+	renderingInfo.pDepthAttachment = pass._depth.image != RENDER_GRAPH_NONE ? &depthAttachment : nullptr;
+
+	_begin_rendering(command_buffer, &renderingInfo);
+}
+
+void RenderGraph::emit_barriers(VkCommandBuffer command_buffer, const std::vector<Pass::Barrier>& barriers, VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages) {
+	if (src_stages == 0) {
+		return;
+	}
+
+	// one call per pass, however many images change state
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	imageBarriers.reserve(barriers.size());
+	for (const auto& b : barriers) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = b.old_layout;
+		barrier.newLayout = b.new_layout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = _resources[b.image].image;
+		barrier.subresourceRange.aspectMask = aspect_of(b.image);
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = b.src_access;
+		barrier.dstAccessMask = b.dst_access;
+		imageBarriers.push_back(barrier);
+	}
+
+	vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0,
+		0, nullptr,
+		0, nullptr,
+		static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+VkFramebuffer RenderGraph::get_framebuffer(RenderGraphPassId id) {
+	const auto& pass = _passes[id];
+
+	std::vector<VkImageView> views;
+	for (const auto& color : pass._colors) {
+		views.push_back(_resources[color.image].view);
+	}
+	if (pass._depth.image != RENDER_GRAPH_NONE) {
+		views.push_back(_resources[pass._depth.image].view);
+	}
+	for (auto image : pass._resolves) {
+		views.push_back(_resources[image].view);
+	}
+
+	auto key = std::make_pair(id, views);
+	auto it = _framebuffers.find(key);
+	if (it != _framebuffers.end()) {
+		return it->second;
+	}
+
+	VkFramebufferCreateInfo framebufferInfo{};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = pass._render_pass;
+	framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+	framebufferInfo.pAttachments = views.data();
+	framebufferInfo.width = _extent.width;
+	framebufferInfo.height = _extent.height;
+	framebufferInfo.layers = 1;
+
+	VkFramebuffer framebuffer;
+	if (vkCreateFramebuffer(_device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create framebuffer!");
+	}
+
+	_framebuffers.emplace(std::move(key), framebuffer);
+	return framebuffer;
+}
+
+VkRenderPass RenderGraph::render_pass(RenderGraphPassId pass) const {
+	return pass < _passes.size() ? _passes[pass]._render_pass : VK_NULL_HANDLE;
+}
+
+RenderGraph::Target RenderGraph::target(RenderGraphPassId id) const {
+	Target target;
+	if (id >= _passes.size()) {
+		return target;
+	}
+
+	const auto& pass = _passes[id];
+	target.render_pass = pass._render_pass;
+	for (const auto& color : pass._colors) {
+		target.color_formats.push_back(_resources[color.image].format);
+	}
+	if (pass._depth.image != RENDER_GRAPH_NONE) {
+		target.depth_format = _resources[pass._depth.image].format;
+	}
+	return target;
+}
+
+bool RenderGraph::is_culled(RenderGraphPassId pass) const {
+	return pass >= _passes.size() || _passes[pass]._culled;
+}
+
+VkImage RenderGraph::image(RenderGraphImage image) const {
+	return _resources[image].image;
+}
+
+VkPipelineStageFlags RenderGraph::first_stages(RenderGraphImage image) const {
+	return _resources[image].first_stages;
+}
+
+VkImageView RenderGraph::image_view(RenderGraphImage image) const {
+	return _resources[image].view;
+}
+
+VkImageAspectFlags RenderGraph::aspect_of(RenderGraphImage image) const {
+	auto format = _resources[image].format;
+	if (!is_depth_format(format)) {
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+	return is_stencil_format(format) ? (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT) : VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+
+uint32_t RenderGraph::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) const {
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(_physical_device, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((type_filter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <functional>
+
+using RenderGraphImage = uint32_t;
+using RenderGraphPassId = uint32_t;
+
+static const uint32_t RENDER_GRAPH_NONE = UINT32_MAX;
+
+// How a pass touches an image. Each usage maps to one layout, stage and access
+// mask, which is all the graph needs to derive the barriers between passes.
+enum class RenderGraphUsage {
+	COLOR_ATTACHMENT,
+	DEPTH_ATTACHMENT,
+	DEPTH_READ_ONLY,
+	RESOLVE_ATTACHMENT,
+	SAMPLED_FRAGMENT,
+	SAMPLED_COMPUTE,
+	STORAGE_COMPUTE,
+	TRANSFER_SRC,
+	TRANSFER_DST,
+};
+
+// Frame graph of the passes that render one frame. Passes declare which images
+// they read and write; compile() then
+//  - culls passes whose results never reach an output,
+//  - turns the declarations into one batched vkCmdPipelineBarrier per pass,
+//  - creates the transient images and lets those with disjoint lifetimes share memory,
+//  - creates a render pass for every pass with attachments, or with dynamic rendering
+//    begins rendering straight on the image views, without render pass or framebuffer.
+// Passes run in the order they were added, so a pass must be added after the passes
+// producing what it reads.
+class RenderGraph {
+public:
+	using ExecuteFunction = std::function<void(VkCommandBuffer)>;
+
+	// what a pipeline drawing in a pass must be compatible with: the render pass, or
+	// with dynamic rendering (render_pass is VK_NULL_HANDLE) the attachment formats
+	struct Target {
+		VkRenderPass render_pass = VK_NULL_HANDLE;
+		std::vector<VkFormat> color_formats;
+		VkFormat depth_format = VK_FORMAT_UNDEFINED;
+	};
+
+	class Pass {
+	public:
+		Pass& color(RenderGraphImage image, VkAttachmentLoadOp load = VK_ATTACHMENT_LOAD_OP_CLEAR, VkClearColorValue clear = {});
+		// write = false binds the depth buffer read-only, e.g. for an EQUAL test after a pre-pass
+		Pass& depth(RenderGraphImage image, VkAttachmentLoadOp load = VK_ATTACHMENT_LOAD_OP_CLEAR, bool write = true);
+		Pass& resolve(RenderGraphImage image);
+		Pass& read(RenderGraphImage image, RenderGraphUsage usage);
+		Pass& write(RenderGraphImage image, RenderGraphUsage usage);
+		// keeps the pass even if nothing reads what it writes
+		Pass& side_effect();
+		Pass& execute(ExecuteFunction function);
+
+	private:
+		friend class RenderGraph;
+
+		struct Attachment {
+			RenderGraphImage image;
+			VkAttachmentLoadOp load;
+			VkClearValue clear;
+		};
+
+		struct Access {
+			RenderGraphImage image;
+			RenderGraphUsage usage;
+			bool read;
+			bool write;
+		};
+
+		bool has_attachments() const { return !_colors.empty() || _depth.image != RENDER_GRAPH_NONE; }
+
+		std::string _name;
+		std::vector<Attachment> _colors;
+		std::vector<RenderGraphImage> _resolves;
+		Attachment _depth{RENDER_GRAPH_NONE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, {}};
+		bool _depth_write = true;
+		std::vector<Access> _accesses;
+		bool _side_effect = false;
+		ExecuteFunction _execute;
+
+		// filled in by compile()
+		struct Barrier {
+			RenderGraphImage image;
+			VkImageLayout old_layout;
+			VkImageLayout new_layout;
+			VkAccessFlags src_access;
+			VkAccessFlags dst_access;
+		};
+
+		bool _culled = false;
+		std::vector<VkAttachmentStoreOp> _color_stores;
+		VkAttachmentStoreOp _depth_store = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		std::vector<Barrier> _barriers;
+		VkPipelineStageFlags _src_stages = 0;
+		VkPipelineStageFlags _dst_stages = 0;
+		VkRenderPass _render_pass = VK_NULL_HANDLE;
+	};
+
+	void init(VkPhysicalDevice physical_device, VkDevice device);
+	// switches to dynamic rendering; the functions are the core or the KHR entry points.
+	// Must be called before passes are compiled.
+	void set_dynamic_rendering(PFN_vkCmdBeginRendering begin, PFN_vkCmdEndRendering end);
+	bool dynamic_rendering() const { return _begin_rendering != nullptr; }
+	// drops every pass and image together with the Vulkan objects compile() made
+	void reset();
+
+	// images owned by the graph, sized to the graph extent; usage flags are derived from the passes
+	RenderGraphImage create_image(const std::string& name, VkFormat format, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+	// images owned elsewhere (e.g. swap chain images), bound every frame with bind_image();
+	// an import with a final layout is an output of the graph and keeps its producers alive
+	RenderGraphImage import_image(const std::string& name, VkFormat format, VkSampleCountFlagBits samples, VkImageLayout final_layout);
+
+	Pass& add_pass(const std::string& name);
+	RenderGraphPassId find_pass(const std::string& name) const;
+
+	void compile(VkExtent2D extent);
+
+	void bind_image(RenderGraphImage image, VkImage vk_image, VkImageView view);
+	void execute(VkCommandBuffer command_buffer);
+
+	// VK_NULL_HANDLE for culled passes, passes without attachments and with dynamic rendering
+	VkRenderPass render_pass(RenderGraphPassId pass) const;
+	Target target(RenderGraphPassId pass) const;
+	bool is_culled(RenderGraphPassId pass) const;
+	VkImage image(RenderGraphImage image) const;
+	VkImageView image_view(RenderGraphImage image) const;
+	// stages of the image's first use in the frame, what a semaphore handing over an
+	// imported image must wait on
+	VkPipelineStageFlags first_stages(RenderGraphImage image) const;
+	VkExtent2D extent() const { return _extent; }
+
+	// bytes of transient memory saved by aliasing, for logging
+	VkDeviceSize aliased_bytes() const { return _aliased_bytes; }
+
+private:
+	struct Resource {
+		std::string name;
+		VkFormat format;
+		VkSampleCountFlagBits samples;
+		bool imported;
+		VkImageLayout final_layout;
+		VkImageUsageFlags usage = 0;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+
+		// pass indices of the first and last use, only meaningful for transient images
+		uint32_t first_use = RENDER_GRAPH_NONE;
+		uint32_t last_use = 0;
+		VkPipelineStageFlags first_stages = 0;
+		// transient images whose memory this one reuses
+		std::vector<RenderGraphImage> aliases;
+		// transient images overlapping this one's memory, alive before or after it
+		std::vector<RenderGraphImage> shared_memory;
+	};
+
+	struct State {
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags stages = 0;
+		VkAccessFlags write_access = 0;
+		bool written = false;
+	};
+
+	void cull_passes();
+	void derive_usages();
+	void allocate_transients();
+	void derive_barriers();
+	// the barriers of every pass for a frame starting in states, returns the end states
+	std::vector<State> record_barriers(std::vector<State> states);
+	void derive_store_ops();
+	void create_render_passes();
+	void begin_render_pass(VkCommandBuffer command_buffer, RenderGraphPassId pass);
+	void begin_rendering(VkCommandBuffer command_buffer, RenderGraphPassId pass);
+	void add_barrier(Pass& pass, RenderGraphImage image, State& state, VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags access, bool write);
+	void emit_barriers(VkCommandBuffer command_buffer, const std::vector<Pass::Barrier>& barriers, VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages);
+	VkFramebuffer get_framebuffer(RenderGraphPassId pass);
+	VkImageAspectFlags aspect_of(RenderGraphImage image) const;
+	uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) const;
+
+private:
+	VkPhysicalDevice _physical_device = VK_NULL_HANDLE;
+	VkDevice _device = VK_NULL_HANDLE;
+	VkExtent2D _extent{};
+
+	PFN_vkCmdBeginRendering _begin_rendering = nullptr;
+	PFN_vkCmdEndRendering _end_rendering = nullptr;
+
+	std::vector<Resource> _resources;
+	// a deque, so the Pass& returned by add_pass() stays valid while more passes are added
+	std::deque<Pass> _passes;
+
+	std::vector<VkDeviceMemory> _memory;
+	VkDeviceSize _aliased_bytes = 0;
+
+	// transitions of imported images into their final layout after the last pass
+	std::vector<Pass::Barrier> _final_barriers;
+	VkPipelineStageFlags _final_src_stages = 0;
+	VkPipelineStageFlags _final_dst_stages = 0;
+
+	// imported views change every frame, so framebuffers are made on first use and kept
+	std::map<std::pair<RenderGraphPassId, std::vector<VkImageView>>, VkFramebuffer> _framebuffers;
+};
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <numeric>
+#include <atomic>
+
+#include "scene_graph.h"
+#include "job_system.h"
+
+// nodes per job of a parallel level update
+static const size_t PARALLEL_GRAIN = 4096;
+
+SceneNode SceneGraph::add_node(SceneNode parent, const glm::mat4& local) {
+	auto handle = static_cast<SceneNode>(_index_of.size());
+	auto index = static_cast<uint32_t>(_parents.size());
+
+	uint32_t parentIndex = parent == SCENE_NODE_NONE ? SCENE_NODE_NONE : _index_of[parent];
+	uint32_t depth = parent == SCENE_NODE_NONE ? 0 : _depths[parentIndex] + 1;
+	if (!_depths.empty() && depth < _depths.back()) {
+		_unsorted = true;
+	}
+
+	_parents.push_back(parentIndex);
+	_depths.push_back(depth);
+	_locals.push_back(local);
+	_worlds.push_back(local);
+	_dirty.push_back(1);
+	_node_at.push_back(handle);
+	_index_of.push_back(index);
+
+	_levels_changed = true;
+	_any_dirty = true;
+	return handle;
+}
+
+void SceneGraph::clear() {
+	_parents.clear();
+	_depths.clear();
+	_locals.clear();
+	_worlds.clear();
+	_dirty.clear();
+	_node_at.clear();
+	_index_of.clear();
+	_level_starts.clear();
+	_unsorted = false;
+	_levels_changed = false;
+	_any_dirty = false;
+	_updated_count = 0;
+}
+
+void SceneGraph::set_local(SceneNode node, const glm::mat4& local) {
+	auto index = _index_of[node];
+	_locals[index] = local;
+	_dirty[index] = 1;
+	_any_dirty = true;
+}
+
+void SceneGraph::update(JobSystem* jobs) {
+	if (_unsorted) {
+		sort_by_depth();
+	}
+	if (_levels_changed) {
+		build_levels();
+	}
+
+	_updated_count = 0;
+	if (!_any_dirty) {
+		return;
+	}
+
+	// a level only reads the dirty flags and world matrices of the one before
+	for (size_t level = 0; level + 1 < _level_starts.size(); ++level) {
+		size_t begin = _level_starts[level];
+		size_t end = _level_starts[level + 1];
+
+		if (jobs == nullptr || end - begin < PARALLEL_MIN_NODES) {
+			_updated_count += update_range(begin, end);
+			continue;
+		}
+
+		std::atomic<size_t> updated{0};
+		jobs->parallel_for(end - begin, PARALLEL_GRAIN, [this, begin, &updated](size_t first, size_t last) {
+			updated.fetch_add(update_range(begin + first, begin + last), std::memory_order_relaxed);
+		});
+		_updated_count += updated.load(std::memory_order_relaxed);
+	}
+
+	std::fill(_dirty.begin(), _dirty.end(), 0);
+	_any_dirty = false;
+}
+
+size_t SceneGraph::update_range(size_t begin, size_t end) {
+	size_t updated = 0;
+	for (size_t i = begin; i < end; ++i) {
+		uint32_t parent = _parents[i];
+		if (parent != SCENE_NODE_NONE && _dirty[parent]) {
+			_dirty[i] = 1;
+		}
+		if (!_dirty[i]) {
+			continue;
+		}
+		_worlds[i] = parent == SCENE_NODE_NONE ? _locals[i] : _worlds[parent] * _locals[i];
+		++updated;
+	}
+	return updated;
+}
+
+void SceneGraph::sort_by_depth() {
+	std::vector<uint32_t> order(_parents.size());
+	std::iota(order.begin(), order.end(), 0);
+	// stable, so siblings keep the order they were added in
+	std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+		return _depths[a] < _depths[b];
+	});
+
+	std::vector<uint32_t> newIndex(order.size());
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		newIndex[order[i]] = i;
+	}
+
+	auto permute = [&order](auto& values) {
+		std::remove_reference_t<decltype(values)> sorted;
+		sorted.reserve(values.size());
+		for (uint32_t old : order) {
+			sorted.push_back(values[old]);
+		}
+		values.swap(sorted);
+	};
+	permute(_parents);
+	permute(_depths);
+	permute(_locals);
+	permute(_worlds);
+	permute(_dirty);
+	permute(_node_at);
+
+	for (auto& parent : _parents) {
+		if (parent != SCENE_NODE_NONE) {
+			parent = newIndex[parent];
+		}
+	}
+	for (uint32_t i = 0; i < _node_at.size(); ++i) {
+		_index_of[_node_at[i]] = i;
+	}
+
+	_unsorted = false;
+	_levels_changed = true;
+}
+
+void SceneGraph::build_levels() {
+	_level_starts.clear();
+	for (uint32_t i = 0; i < _depths.size(); ++i) {
+		while (_level_starts.size() <= _depths[i]) {
+			_level_starts.push_back(i);
+		}
+	}
+	_level_starts.push_back(static_cast<uint32_t>(_depths.size()));
+	_levels_changed = false;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <span>
+
+class JobSystem;
+
+using SceneNode = uint32_t;
+static const SceneNode SCENE_NODE_NONE = UINT32_MAX;
+
+// Transform hierarchy in flat arrays. Parent indices, local and world matrices are
+// stored contiguously and sorted by depth, so every parent comes before its children
+// and update() is one forward pass over the arrays. Nodes whose local transform changed
+// are flagged dirty; the flag spreads to their descendants during that pass and only
+// flagged nodes get a new world matrix.
+//
+// The nodes of one depth are independent of each other, so with a job system large
+// levels are updated in parallel, one level after the other.
+//
+// SceneNode handles are stable. Where a node sits in the arrays is not: adding a node
+// shallower than the last one reorders them on the next update().
+class SceneGraph {
+public:
+	SceneNode add_node(SceneNode parent = SCENE_NODE_NONE, const glm::mat4& local = glm::mat4(1.0f));
+	void clear();
+
+	void set_local(SceneNode node, const glm::mat4& local);
+	const glm::mat4& local(SceneNode node) const { return _locals[_index_of[node]]; }
+	// as of the last update()
+	const glm::mat4& world(SceneNode node) const { return _worlds[_index_of[node]]; }
+
+	// jobs is optional, levels of at least PARALLEL_MIN_NODES nodes are spread over it
+	void update(JobSystem* jobs = nullptr);
+
+	// every world matrix in array order, for uploading in one copy; valid after update()
+	std::span<const glm::mat4> world_matrices() const { return _worlds; }
+	// position of node in world_matrices(), valid after update()
+	uint32_t index(SceneNode node) const { return _index_of[node]; }
+
+	size_t size() const { return _parents.size(); }
+	// world matrices the last update() computed
+	size_t updated_count() const { return _updated_count; }
+
+	static constexpr size_t PARALLEL_MIN_NODES = 16384;
+
+private:
+	void sort_by_depth();
+	void build_levels();
+	// world matrices of [begin, end) within one level, returns how many were dirty
+	size_t update_range(size_t begin, size_t end);
+
+private:
+	// by array index
+	std::vector<uint32_t> _parents;
+	std::vector<uint32_t> _depths;
+	std::vector<glm::mat4> _locals;
+	std::vector<glm::mat4> _worlds;
+	std::vector<uint8_t> _dirty;
+	std::vector<SceneNode> _node_at;
+
+	// by handle
+	std::vector<uint32_t> _index_of;
+
+	// first array index of each depth, plus the end
+	std::vector<uint32_t> _level_starts;
+	bool _unsorted = false;
+	bool _levels_changed = false;
+	bool _any_dirty = false;
+	size_t _updated_count = 0;
+};
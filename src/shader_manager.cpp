@@ -0,0 +1,148 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <chrono>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "shader_manager.h"
+
+// editors write a file in several steps, wait for them to settle before compiling
+static const auto SETTLE_TIME = std::chrono::milliseconds(50);
+
+static bool is_shader_source(const std::string& name) {
+	static const char* stages[] = {".vert", ".frag", ".comp", ".geom", ".tesc", ".tese"};
+	for (auto stage : stages) {
+		auto len = strlen(stage);
+		if (name.size() > len && name.compare(name.size() - len, len, stage) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+ShaderManager::ShaderManager(const std::string& source_dir, const std::string& output_dir, const std::string& compiler)
+	: _source_dir(source_dir), _output_dir(output_dir), _compiler(compiler) {
+}
+
+ShaderManager::~ShaderManager() {
+	stop();
+}
+
+void ShaderManager::start() {
+#ifdef __linux__
+	if (_running) {
+		return;
+	}
+
+	_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_inotify_fd < 0) {
+		std::cerr << "shader manager: inotify unavailable, hot reload disabled" << std::endl;
+		return;
+	}
+
+	// editors that save through a temporary file show up as IN_MOVED_TO
+	if (inotify_add_watch(_inotify_fd, _source_dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		std::cerr << "shader manager: cannot watch " << _source_dir << ", hot reload disabled" << std::endl;
+		close(_inotify_fd);
+		_inotify_fd = -1;
+		return;
+	}
+
+	_running = true;
+	_thread = std::thread(&ShaderManager::watch_loop, this);
+#endif
+}
+
+void ShaderManager::stop() {
+	_running = false;
+	if (_thread.joinable()) {
+		_thread.join();
+	}
+
+#ifdef __linux__
+	if (_inotify_fd >= 0) {
+		close(_inotify_fd);
+		_inotify_fd = -1;
+	}
+#endif
+}
+
+std::vector<std::string> ShaderManager::take_recompiled() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<std::string> names;
+	names.swap(_recompiled);
+	return names;
+}
+
+void ShaderManager::watch_loop() {
+#ifdef __linux__
+	alignas(inotify_event) char buffer[4096];
+	std::set<std::string> pending;
+
+	while (_running) {
+		pollfd fd{_inotify_fd, POLLIN, 0};
+		// the timeout bounds how long stop() waits for the thread
+		int ready = poll(&fd, 1, pending.empty() ? 200 : static_cast<int>(SETTLE_TIME.count()));
+
+		if (ready > 0) {
+			ssize_t length;
+			while ((length = read(_inotify_fd, buffer, sizeof(buffer))) > 0) {
+				for (char* p = buffer; p < buffer + length; ) {
+					auto event = reinterpret_cast<inotify_event*>(p);
+					if (event->len > 0 && is_shader_source(event->name)) {
+						pending.insert(event->name);
+					}
+					p += sizeof(inotify_event) + event->len;
+				}
+			}
+			continue;
+		}
+
+		// quiet for a whole settle period, compile everything that changed
+		bool recompiled = false;
+		for (const auto& name : pending) {
+			if (compile(name)) {
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (std::find(_recompiled.begin(), _recompiled.end(), name) == _recompiled.end()) {
+					_recompiled.push_back(name);
+				}
+				recompiled = true;
+			}
+		}
+		pending.clear();
+		if (recompiled && _recompiled_callback) {
+			_recompiled_callback();
+		}
+	}
+#endif
+}
+
+bool ShaderManager::compile(const std::string& name) {
+	auto input = _source_dir + "/" + name;
+	auto output = _output_dir + "/" + name + ".spv";
+	auto temp = output + ".tmp";
+
+	// compile next to the target and rename, so a reader never sees a half written file
+	auto command = _compiler + " \"" + input + "\" -o \"" + temp + "\"";
+	if (std::system(command.c_str()) != 0) {
+		std::cerr << "shader manager: failed to compile " << name << ", keeping the old version" << std::endl;
+		std::remove(temp.c_str());
+		return false;
+	}
+
+	if (std::rename(temp.c_str(), output.c_str()) != 0) {
+		std::cerr << "shader manager: failed to replace " << output << std::endl;
+		return false;
+	}
+
+	std::cout << "shader manager: recompiled " << name << std::endl;
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+// Watches the GLSL sources and recompiles changed files to SPIR-V on a background
+// thread. The render loop only ever asks which shaders were rebuilt, so a slow
+// compile never stalls a frame.
+class ShaderManager {
+public:
+	ShaderManager(const std::string& source_dir, const std::string& output_dir, const std::string& compiler = "glslc");
+	~ShaderManager();
+
+	ShaderManager(const ShaderManager&) = delete;
+	ShaderManager& operator=(const ShaderManager&) = delete;
+
+	void start();
+	void stop();
+
+	// called on the watcher thread after shaders were recompiled; set it before start()
+	void set_recompiled_callback(std::function<void()> callback) {_recompiled_callback = std::move(callback);}
+
+	// file names (e.g. "default.frag") whose .spv was rewritten since the last call
+	std::vector<std::string> take_recompiled();
+
+private:
+	void watch_loop();
+	bool compile(const std::string& name);
+
+private:
+	std::string _source_dir;
+	std::string _output_dir;
+	std::string _compiler;
+
+	std::thread _thread;
+	std::atomic<bool> _running{false};
+	int _inotify_fd = -1;
+
+	std::mutex _mutex;
+	std::vector<std::string> _recompiled;
+	std::function<void()> _recompiled_callback;
+};
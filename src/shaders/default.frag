@@ -1,7 +1,19 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(binding = 1) uniform sampler2D texSampler;
+// set per pipeline variant, branches on them are removed when the pipeline is compiled
+layout(constant_id = 0) const bool USE_VERTEX_COLOR = false;
+layout(constant_id = 1) const bool USE_TEXTURE = true;
+layout(constant_id = 2) const bool USE_ALPHA_TEST = false;
+layout(constant_id = 3) const float ALPHA_CUTOFF = 0.5;
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(push_constant) uniform DrawPushConstants {
+	mat4 model;
+	uint material_id;
+} draw;
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -9,5 +21,15 @@ layout(location = 1) in vec2 fragTexCoord;
 layout(location = 0) out vec4 outColor;
 
 void main() {
-	outColor = texture(texSampler, fragTexCoord);
+	vec4 color = vec4(1.0);
+	if (USE_TEXTURE) {
+		color = texture(textures[nonuniformEXT(draw.material_id)], fragTexCoord);
+	}
+	if (USE_VERTEX_COLOR) {
+		color.rgb *= fragColor;
+	}
+	if (USE_ALPHA_TEST && color.a < ALPHA_CUTOFF) {
+		discard;
+	}
+	outColor = color;
 }
\ No newline at end of file
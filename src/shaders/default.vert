@@ -8,14 +8,22 @@ layout(location = 2) in vec2 inTexCoord;
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
-layout(binding = 0) uniform UniformBufferObject {
-	mat4 model;
+layout(set = 0, binding = 0) uniform UniformBufferObject {
 	mat4 view;
 	mat4 proj;
+	mat4 view_proj;
 } ubo;
 
+layout(push_constant) uniform DrawPushConstants {
+	mat4 model;
+	uint material_id;
+} draw;
+
+// the depth pre-pass in depth_only.vert has to produce exactly the same positions
+invariant gl_Position;
+
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = ubo.view_proj * (draw.model * vec4(inPosition, 1.0));
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
\ No newline at end of file
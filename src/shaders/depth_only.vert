@@ -0,0 +1,22 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 inPosition;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+	mat4 view;
+	mat4 proj;
+	mat4 view_proj;
+} ubo;
+
+layout(push_constant) uniform DrawPushConstants {
+	mat4 model;
+	uint material_id;
+} draw;
+
+// must compute bit for bit the same depth as default.vert, or the EQUAL test of the main pass fails
+invariant gl_Position;
+
+void main() {
+    gl_Position = ubo.view_proj * (draw.model * vec4(inPosition, 1.0));
+}
\ No newline at end of file
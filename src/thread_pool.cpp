@@ -0,0 +1,62 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t thread_count) {
+	if (thread_count == 0) {
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (size_t i = 0; i < thread_count; ++i) {
+		_threads.emplace_back(&ThreadPool::worker_loop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_job_ready.notify_all();
+
+	// queued jobs still run, their futures would otherwise never become ready
+	for (auto& thread : _threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::wait_idle() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this]() { return _jobs.empty() && _busy == 0; });
+}
+
+void ThreadPool::push(std::function<void()>&& job) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_jobs.push_back(std::move(job));
+	}
+	_job_ready.notify_one();
+}
+
+void ThreadPool::worker_loop() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_job_ready.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+		if (_jobs.empty()) {
+			return;
+		}
+
+		auto job = std::move(_jobs.front());
+		_jobs.pop_front();
+		++_busy;
+
+		lock.unlock();
+		job();
+		lock.lock();
+
+		--_busy;
+		if (_jobs.empty() && _busy == 0) {
+			_idle.notify_all();
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+// Fixed set of worker threads draining one FIFO queue. submit() hands back a
+// future, so callers decide themselves whether to block on a result.
+class ThreadPool {
+public:
+	// 0 picks one thread per hardware core
+	explicit ThreadPool(size_t thread_count = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	template <class Function>
+	auto submit(Function&& function) -> std::future<std::invoke_result_t<Function>> {
+		using Result = std::invoke_result_t<Function>;
+		// std::function needs a copyable target, packaged_task is move only
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+		auto future = task->get_future();
+		push([task]() { (*task)(); });
+		return future;
+	}
+
+	// blocks until the queue is empty and no worker is busy
+	void wait_idle();
+
+	size_t size() const { return _threads.size(); }
+
+private:
+	void push(std::function<void()>&& job);
+	void worker_loop();
+
+private:
+	std::vector<std::thread> _threads;
+	std::deque<std::function<void()>> _jobs;
+	std::mutex _mutex;
+	std::condition_variable _job_ready;
+	std::condition_variable _idle;
+	size_t _busy = 0;
+	bool _stopping = false;
+};
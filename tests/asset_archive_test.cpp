@@ -0,0 +1,72 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include "asset_archive.h"
+#include "job_system.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+	if (!condition) {
+		std::cout << "FAIL " << what << std::endl;
+		++failures;
+	}
+}
+
+// text that compresses, so small chunks are offered to the codec as well
+static std::string make_content(size_t size) {
+	static const std::string pattern = "abababXcdefghij";
+	std::string content;
+	for (size_t i = 0; i < size; ++i) {
+		content += pattern[i % pattern.size()];
+	}
+	return content;
+}
+
+// files of 1 to 16 bytes, and files whose last chunk is 1 to 16 bytes
+static void test_round_trip(const std::filesystem::path& directory) {
+	static const uint32_t CHUNK_SIZE = 64;
+
+	std::vector<std::string> files;
+	std::vector<std::string> contents;
+	for (size_t size = 1; size <= 16; ++size) {
+		for (size_t chunks : {0, 2}) {
+			auto path = (directory / ("file_" + std::to_string(chunks) + "_" + std::to_string(size))).generic_string();
+			contents.push_back(make_content(chunks * CHUNK_SIZE + size));
+			std::ofstream(path, std::ios::binary) << contents.back();
+			files.push_back(path);
+		}
+	}
+
+	auto archivePath = (directory / "test.pak").generic_string();
+	write_asset_archive(archivePath, files, CHUNK_SIZE);
+
+	JobSystem jobs(2);
+	for (JobSystem* system : {static_cast<JobSystem*>(nullptr), &jobs}) {
+		auto archive = AssetArchive::open(archivePath, system);
+		check(archive->size() == files.size(), "round trip: entry count");
+		for (size_t i = 0; i < files.size(); ++i) {
+			auto blob = archive->load(files[i]);
+			check(std::string(blob->data(), blob->size()) == contents[i], "round trip: content of " + files[i]);
+		}
+	}
+}
+
+int main() {
+	auto directory = std::filesystem::temp_directory_path() / "asset_archive_test";
+	std::filesystem::create_directories(directory);
+
+	test_round_trip(directory);
+
+	std::filesystem::remove_all(directory);
+	if (failures > 0) {
+		std::cout << failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+
+#include "golden_compare.h"
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+	if (!condition) {
+		std::cout << "FAIL " << what << std::endl;
+		++failures;
+	}
+}
+
+// a width x height image of one opaque gray
+static std::vector<uint8_t> make_image(uint32_t width, uint32_t height, uint8_t gray) {
+	std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4, gray);
+	for (size_t i = 3; i < pixels.size(); i += 4) {
+		pixels[i] = 255;
+	}
+	return pixels;
+}
+
+static void test_identical() {
+	auto image = make_image(4, 4, 128);
+	auto result = compare_images(image, image, 4, 4, 8, nullptr);
+	check(result.compared, "identical: compared");
+	check(std::isinf(result.psnr), "identical: psnr is infinite");
+	check(result.max_difference == 0, "identical: no difference");
+	check(result.differing_pixels == 0, "identical: no differing pixels");
+	check(result.pixel_count == 16, "identical: pixel count");
+}
+
+static void test_psnr() {
+	auto golden = make_image(2, 2, 100);
+	auto image = golden;
+	// one channel of one pixel off by 10: mean squared error 100 / 12 over the RGB channels
+	image[0] = 110;
+	auto result = compare_images(image, golden, 2, 2, 8, nullptr);
+	double expected = 10.0 * std::log10(255.0 * 255.0 / (100.0 / 12.0));
+	check(result.compared, "psnr: compared");
+	check(std::abs(result.psnr - expected) < 1e-9, "psnr: value");
+	check(result.max_difference == 10, "psnr: max difference");
+}
+
+static void test_tolerance() {
+	auto golden = make_image(2, 2, 100);
+	auto image = golden;
+	image[1] = 108;
+	image[4 + 2] = 91;
+	// alpha is not compared
+	image[8 + 3] = 0;
+	std::vector<uint8_t> diff;
+	auto result = compare_images(image, golden, 2, 2, 8, &diff);
+	check(result.differing_pixels == 1, "tolerance: only the pixel above it differs");
+	check(result.max_difference == 9, "tolerance: max difference");
+	check(diff.size() == golden.size(), "tolerance: diff size");
+	check(diff[0] == 8 * 4 && diff[1] == 8 * 4 && diff[2] == 8 * 4, "tolerance: amplified difference within it");
+	check(diff[4] == 255 && diff[5] == 0 && diff[6] == 0, "tolerance: red above it");
+	check(diff[8] == 0 && diff[11] == 255, "tolerance: alpha ignored");
+}
+
+static void test_size_mismatch() {
+	auto image = make_image(4, 4, 0);
+	auto golden = make_image(4, 2, 0);
+	auto result = compare_images(image, golden, 4, 4, 8, nullptr);
+	check(!result.compared, "size mismatch: not compared");
+	check(result.error == "size mismatch", "size mismatch: error");
+}
+
+int main() {
+	test_identical();
+	test_psnr();
+	test_tolerance();
+	test_size_mismatch();
+
+	if (failures > 0) {
+		std::cout << failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
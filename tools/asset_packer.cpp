@@ -0,0 +1,47 @@
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include "asset_archive.h"
+
+// Packs the given files into an asset archive; entry names are the paths as given,
+// so run it from the directory the application loads its assets relative to.
+//   vulkan_pack [--chunk-size bytes] <output> <file>...
+int main(int argc, char** argv) {
+	uint32_t chunkSize = ARCHIVE_DEFAULT_CHUNK_SIZE;
+	std::string output;
+	std::vector<std::string> files;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--chunk-size" && i + 1 < argc) {
+			chunkSize = static_cast<uint32_t>(std::stoul(argv[++i]));
+		} else if (output.empty()) {
+			output = arg;
+		} else {
+			files.push_back(arg);
+		}
+	}
+
+	if (output.empty() || chunkSize == 0) {
+		std::cout << "usage: vulkan_pack [--chunk-size bytes] <output> <file>..." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try {
+		write_asset_archive(output, files, chunkSize);
+
+		uintmax_t rawSize = 0;
+		for (const auto& file : files) {
+			rawSize += std::filesystem::file_size(file);
+		}
+		std::cout << "packed " << files.size() << " files, " << rawSize << " bytes into "
+			<< output << ", " << std::filesystem::file_size(output) << " bytes" << std::endl;
+	} catch (std::exception& e) {
+		std::cout << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}